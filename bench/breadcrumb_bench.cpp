@@ -0,0 +1,71 @@
+// Measures the cost of leaving breadcrumbs from many threads at once in each breadcrumb mode, along with the cost of the
+// clock read that timestamps each breadcrumb.
+//
+// usage: breadcrumb_bench [thread_count] [breadcrumbs_per_thread]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+#include "clock.h"
+#include "forensics.h"
+
+static void run_clock(int read_count) {
+  uint64_t sum = 0;
+  const auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < read_count; ++index) {
+    sum += forensics_private_clock_ns();
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  const double total_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  printf("%-12s %10.1f ns/read (checksum %llu)\n", "clock", total_ns / read_count, (unsigned long long)(sum & 0xff));
+}
+
+static void run(const char* mode_name, forensics_breadcrumb_mode_t mode, int thread_count, int crumb_count) {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.breadcrumb_mode = mode;
+  config.register_signal_handlers = false;
+  config.max_breadcrumb_loop_length = 0;
+  forensics_lib_init(&config);
+
+  const auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (int thread_index = 0; thread_index < thread_count; ++thread_index) {
+    threads.emplace_back([=]() {
+      const char* meta_keys[] = {"index"};
+      const char* meta_values[] = {"42"};
+      for (int index = 0; index < crumb_count; ++index) {
+        // alternate names so the crumbs aren't collapsed as repeats (block detection is off above)
+        forensics_add_breadcrumb((index & 1) ? "odd" : "even", meta_keys, meta_values, 1);
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  forensics_lib_shutdown();
+
+  const double total_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  const double total_crumbs = (double)thread_count * crumb_count;
+  printf("%-12s threads=%-4d %10.1f ns/crumb/thread %10.2f Mcrumbs/s\n",
+         mode_name,
+         thread_count,
+         total_ns * thread_count / total_crumbs,
+         total_crumbs * 1000.0 / total_ns);
+}
+
+int main(int argc, char** argv) {
+  const int thread_count = argc > 1 ? atoi(argv[1]) : (int)std::thread::hardware_concurrency();
+  const int crumb_count = argc > 2 ? atoi(argv[2]) : 1000000;
+
+  run_clock(crumb_count);
+  run("global", FORENSICS_BREADCRUMB_MODE_GLOBAL, thread_count, crumb_count);
+  run("per-thread", FORENSICS_BREADCRUMB_MODE_PER_THREAD, thread_count, crumb_count);
+  run("lock-free", FORENSICS_BREADCRUMB_MODE_LOCK_FREE, thread_count, crumb_count);
+  run("per-cpu", FORENSICS_BREADCRUMB_MODE_PER_CPU, thread_count, crumb_count);
+  return 0;
+}
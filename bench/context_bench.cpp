@@ -0,0 +1,83 @@
+// Measures the cost of a `FORENSICS_CONTEXT` scope next to a call to an empty function that can't be inlined, which is
+// about the least an out of line begin/end pair could cost. Scopes are nested a few deep like they would be across a
+// public API and the code it calls.
+//
+// usage: context_bench [scope_count]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "forensics.h"
+
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+static volatile int s_sink;
+
+NOINLINE static void empty_function(const char* name) {
+  // keep the call from being optimized away
+  s_sink = name != nullptr;
+}
+
+static double elapsed_ns(std::chrono::steady_clock::time_point start) {
+  const auto end = std::chrono::steady_clock::now();
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void run_empty_function(int scope_count) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < scope_count; ++index) {
+    empty_function("api");
+    empty_function(nullptr);
+  }
+  printf("%-24s %6.2f ns/scope\n", "empty function x2", elapsed_ns(start) / scope_count);
+}
+
+static void run_context(int scope_count) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < scope_count; ++index) {
+    FORENSICS_CONTEXT("api");
+    s_sink = index;
+  }
+  printf("%-24s %6.2f ns/scope\n", "FORENSICS_CONTEXT", elapsed_ns(start) / scope_count);
+}
+
+static void run_nested_context(int scope_count) {
+  const auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < scope_count; index += 4) {
+    FORENSICS_CONTEXT("api");
+    {
+      FORENSICS_CONTEXT("service");
+      {
+        FORENSICS_CONTEXT("storage");
+        {
+          FORENSICS_CONTEXT("codec");
+          s_sink = index;
+        }
+      }
+    }
+  }
+  printf("%-24s %6.2f ns/scope\n", "FORENSICS_CONTEXT x4", elapsed_ns(start) / scope_count);
+}
+
+int main(int argc, char** argv) {
+  const int scope_count = argc > 1 ? atoi(argv[1]) : 100000000;
+
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.register_signal_handlers = false;
+  forensics_lib_init(&config);
+
+  // the first scope on a thread allocates its stack, so get that out of the way
+  forensics_context_begin("warm up");
+  forensics_context_end();
+
+  run_empty_function(scope_count);
+  run_context(scope_count);
+  run_nested_context(scope_count);
+
+  forensics_lib_shutdown();
+  return 0;
+}
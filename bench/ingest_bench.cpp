@@ -0,0 +1,60 @@
+// Measures the single-threaded cost of copying a breadcrumb's strings into the ring for crumbs with different numbers of
+// metadata pairs. No other threads are writing so this is dominated by scanning, hashing and copying the strings. Each
+// size is run again with the compressed archive on, which packs every crumb pushed out of the ring.
+//
+// usage: ingest_bench [breadcrumb_count]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "forensics.h"
+
+#define MAX_META_COUNT 16
+
+static void run(int meta_count, bool archive, int crumb_count) {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.register_signal_handlers = false;
+  config.max_breadcrumb_loop_length = 0;
+  config.breadcrumb_buf_size_bytes = 64 * 1024;
+  config.breadcrumb_archive_size_bytes = archive ? 256 * 1024 : 0;
+  forensics_lib_init(&config);
+
+  // realistic lengths: short keys, values of a few words, and names about as long as a function name
+  static const char* meta_keys[MAX_META_COUNT] = {
+      "user_id", "session", "request_path", "method", "status", "elapsed_ms", "retry", "region",
+      "shard", "build", "locale", "device", "network_type", "battery", "screen", "memory_mb",
+  };
+  static const char* meta_values[MAX_META_COUNT] = {
+      "8f14e45fceea167a",      "c9f0f895fb98ab91", "/api/v2/inventory/items", "GET",
+      "200",                   "17",               "0",                       "us-west-2",
+      "shard-0042",            "2024.11.3-rc1",    "en_US.UTF-8",             "Pixel 7 Pro (GP4BC)",
+      "wifi",                  "87%",              "1440x3120@120Hz",         "12288",
+  };
+
+  const auto start = std::chrono::steady_clock::now();
+  for (int index = 0; index < crumb_count; ++index) {
+    // alternate names so the crumbs aren't collapsed as repeats
+    forensics_add_breadcrumb((index & 1) ? "InventoryController::refresh_items"
+                                         : "InventoryController::apply_filters",
+                             meta_keys,
+                             meta_values,
+                             meta_count);
+  }
+  const auto end = std::chrono::steady_clock::now();
+
+  forensics_lib_shutdown();
+
+  const double total_ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+  printf("meta=%-4d %-8s %10.1f ns/crumb\n", meta_count, archive ? "archive" : "", total_ns / crumb_count);
+}
+
+int main(int argc, char** argv) {
+  const int crumb_count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+  const int meta_counts[] = {0, 4, 16};
+  for (int meta_count : meta_counts) {
+    run(meta_count, false, crumb_count);
+    run(meta_count, true, crumb_count);
+  }
+  return 0;
+}
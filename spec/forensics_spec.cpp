@@ -1,5 +1,20 @@
 #include <signal.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 #include "catch.hpp"
+
+// compile out the most verbose breadcrumbs to check that they disappear
+#define FORENSICS_BREADCRUMB_COMPILED_LEVEL FORENSICS_BREADCRUMB_LEVEL_DEBUG
 #include "forensics.h"
 
 static std::function<void(const forensics_report_t*)> s_report_handler;
@@ -10,6 +25,14 @@ static void test_report_handler(const forensics_report_t* report) {
   }
 }
 
+static std::function<void(const forensics_report_t*)> s_previous_run_handler;
+
+static void test_previous_run_handler(const forensics_report_t* report) {
+  if (s_previous_run_handler) {
+    s_previous_run_handler(report);
+  }
+}
+
 // init/shutdown helper if an exception gets thrown
 struct init_t {
   init_t(const forensics_config_t* config) {
@@ -158,243 +181,2401 @@ TEST_CASE("attributes") {
     };
     with_handler(handler, []() { FORENSICS_ASSERT(false); });
   }
-}
 
-TEST_CASE("context") {
-  init_t init(nullptr);
+  SECTION("an attribute is replaced with a longer value") {
+    forensics_set_attribute("user", "gus");
+    forensics_set_attribute("version", "1.0.0");
+    forensics_set_attribute("user", "burton guster, also known as magic head");
+    forensics_set_attribute("user", "gus");
 
-  SECTION("there is no context") {
     auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->context_count == 0);
-      CHECK(report->context_stack == nullptr);
-      CHECK(!strcmp(report->id, REPORT_ID("<none>", "forensics_spec.cpp", "")));
+      CHECK(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "version", "1.0.0"));
+      CHECK(has_attribute_value(report, "user", "gus"));
     };
     with_handler(handler, []() { FORENSICS_ASSERT(false); });
   }
 
-  SECTION("there is a single context") {
+  SECTION("attributes set while a report is handled don't change it") {
+    forensics_set_attribute("user", "shawn spencer");
+    forensics_set_attribute("version", "1.0.0");
+
     auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->context_count == 1);
-      CHECK(!strcmp(report->context_stack[0], "global"));
-      CHECK(!strcmp(report->id, REPORT_ID("global", "forensics_spec.cpp", "")));
+      // this would deadlock if setting attributes waited on the report
+      forensics_set_attribute("user", "carlton lassiter");
+      forensics_set_attribute("version", nullptr);
+      forensics_set_attribute("office", "santa barbara");
+      CHECK(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "user", "shawn spencer"));
+      CHECK(has_attribute_value(report, "version", "1.0.0"));
     };
-    with_handler(handler, []() {
-      FORENSICS_CONTEXT("global");
-      FORENSICS_ASSERT(false);
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+
+    auto later_handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "user", "carlton lassiter"));
+      CHECK(has_attribute_value(report, "office", "santa barbara"));
+    };
+    with_handler(later_handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("reports see whole attributes while another thread changes them") {
+    // each value is a single repeated letter, so a block reused while a report still points at it would show up as a
+    // mixed or missing value
+    std::atomic<bool> stop(false);
+    std::thread writer([&]() {
+      char key[16];
+      for (int round = 0; !stop.load(); ++round) {
+        snprintf(key, sizeof(key), "key%d", round % 8);
+        const std::string value(1 + round % 40, (char)('a' + round % 26));
+        forensics_set_attribute(key, (round / 8) % 3 == 2 ? nullptr : value.c_str());
+      }
     });
+
+    int torn_count = 0;
+    s_report_handler = [&](const forensics_report_t* report) {
+      for (int index = 0; index < report->attribute_count; ++index) {
+        const char* value = report->attribute_values[index];
+        const size_t size = strlen(value);
+        if (size == 0 || strspn(value, value + size - 1) != size || strncmp(report->attribute_keys[index], "key", 3)) {
+          ++torn_count;
+        }
+      }
+    };
+    for (int report_index = 0; report_index < 2000; ++report_index) {
+      FORENSICS_VERIFY(false);
+    }
+    s_report_handler = nullptr;
+    stop.store(true);
+    writer.join();
+    CHECK(torn_count == 0);
   }
 
-  SECTION("there are many contexts") {
-    auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->context_count == 3);
-      CHECK(!strcmp(report->context_stack[0], "global"));
-      CHECK(!strcmp(report->context_stack[1], "local"));
-      CHECK(!strcmp(report->context_stack[2], "personal"));
-      CHECK(!strcmp(report->id, REPORT_ID("personal", "forensics_spec.cpp", "")));
+  SECTION("many attributes are set and cleared over and over") {
+    // clearing has to give the space back or the buffer fills up long before this is done
+    char key[32];
+    char value[32];
+    for (int round = 0; round < 100; ++round) {
+      for (int index = 0; index < 100; ++index) {
+        snprintf(key, sizeof(key), "key%d", index);
+        snprintf(value, sizeof(value), "%d", (round * 7 + index) % (1 + index));
+        forensics_set_attribute(key, value);
+      }
+      for (int index = round % 2; index < 100; index += 2) {
+        snprintf(key, sizeof(key), "key%d", index);
+        forensics_set_attribute(key, nullptr);
+      }
+    }
+
+    auto handler = [&](const forensics_report_t* report) {
+      REQUIRE(report->attribute_count == 50);
+      for (int index = 0; index < 100; ++index) {
+        snprintf(key, sizeof(key), "key%d", index);
+        snprintf(value, sizeof(value), "%d", (99 * 7 + index) % (1 + index));
+        if (index % 2 == 0) {
+          CHECK(has_attribute_value(report, key, value));
+        }
+        else {
+          CHECK(!has_attribute(report, key));
+        }
+      }
     };
-    with_handler(handler, []() {
-      FORENSICS_CONTEXT("global");
-      FORENSICS_CONTEXT("local");
-      FORENSICS_CONTEXT("personal");
-      FORENSICS_ASSERT(false);
-    });
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
   }
-}
 
-TEST_CASE("breadcrumbs") {
-  init_t init(nullptr);
+  SECTION("several attributes set at once") {
+    forensics_set_attribute("user", "shawn spencer");
+    const char* keys[] = {"tenant", "region", "user", "tenant"};
+    const char* values[] = {"acme", "us-west-2", nullptr, "initech"};
+    forensics_set_attributes(keys, values, 4);
 
-  SECTION("there are no breadcrumbs") {
     auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 0);
-      CHECK(report->breadcrumbs == nullptr);
+      CHECK(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "tenant", "initech"));
+      CHECK(has_attribute_value(report, "region", "us-west-2"));
+      CHECK(!has_attribute(report, "user"));
     };
     with_handler(handler, []() { FORENSICS_ASSERT(false); });
   }
 
-  SECTION("there is a single breadcrumb with no meta") {
+  SECTION("a batch doesn't run out of room when it replaces a value many times") {
+    const char* keys[1000];
+    const char* values[1000];
+    for (int index = 0; index < 1000; ++index) {
+      keys[index] = "tenant";
+      values[index] = (index & 1) ? "a tenant with a fairly long name" : "short";
+    }
+    forensics_set_attributes(keys, values, 1000);
+
     auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 1);
-      CHECK(report->breadcrumbs != nullptr);
-      CHECK(!strcmp(report->breadcrumbs[0].name, "test"));
-      CHECK(report->breadcrumbs[0].meta_keys == nullptr);
-      CHECK(report->breadcrumbs[0].meta_values == nullptr);
-      CHECK(report->breadcrumbs[0].meta_count == 0);
-      CHECK(report->breadcrumbs[0].count == 1);
+      CHECK(report->attribute_count == 1);
+      CHECK(has_attribute_value(report, "tenant", "a tenant with a fairly long name"));
     };
-    with_handler(handler, []() {
-      forensics_add_breadcrumb("test", nullptr, nullptr, 0);
-      FORENSICS_ASSERT(false);
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("reports see all of a batch or none of it") {
+    std::atomic<bool> stop(false);
+    std::thread writer([&]() {
+      const char* keys[] = {"tenant", "region", "shard", "plan"};
+      const char* tenant_a[] = {"a", "a", "a", "a"};
+      const char* tenant_b[] = {"b", "b", "b", "b"};
+      for (int round = 0; !stop.load(); ++round) {
+        forensics_set_attributes(keys, (round & 1) ? tenant_b : tenant_a, 4);
+      }
     });
+
+    int mixed_count = 0;
+    s_report_handler = [&](const forensics_report_t* report) {
+      for (int index = 1; index < report->attribute_count; ++index) {
+        if (strcmp(report->attribute_values[index], report->attribute_values[0])) {
+          ++mixed_count;
+        }
+      }
+    };
+    for (int report_index = 0; report_index < 2000; ++report_index) {
+      FORENSICS_VERIFY(false);
+    }
+    s_report_handler = nullptr;
+    stop.store(true);
+    writer.join();
+    CHECK(mixed_count == 0);
   }
+}
 
-  SECTION("there is a single breadcrumb with 1 meta") {
-    auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 1);
-      CHECK(report->breadcrumbs != nullptr);
-      CHECK(!strcmp(report->breadcrumbs[0].name, "test"));
-      CHECK(report->breadcrumbs[0].meta_keys != nullptr);
-      CHECK(report->breadcrumbs[0].meta_values != nullptr);
-      CHECK(report->breadcrumbs[0].meta_count == 1);
-      CHECK(report->breadcrumbs[0].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+TEST_CASE("attribute buffer reuse") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.attribute_buf_size_bytes = 1024;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  // each of these takes 32 bytes with its block header, so 32 of them fill the buffer
+  char key[8];
+  const char* small_value = "a nineteen byte val";
+
+  SECTION("freed neighbors are merged to fit a large value") {
+    for (int index = 0; index < 32; ++index) {
+      snprintf(key, sizeof(key), "k%02d", index);
+      forensics_set_attribute(key, small_value);
+    }
+    for (int index = 0; index < 24; ++index) {
+      snprintf(key, sizeof(key), "k%02d", index);
+      forensics_set_attribute(key, nullptr);
+    }
+    const std::string large_value(600, 'x');
+    int report_count = 0;
+    auto handler = [&](const forensics_report_t* report) {
+      ++report_count;
+      CHECK(report->attribute_count == 9);
+      CHECK(has_attribute_value(report, "large", large_value.c_str()));
+      CHECK(has_attribute_value(report, "k31", small_value));
     };
-    with_handler(handler, []() {
-      const char* meta_keys[] = {
-          "env",
-      };
-      const char* meta_values[] = {
-          "production",
-      };
-      forensics_add_breadcrumb("test", meta_keys, meta_values, 1);
+    with_handler(handler, [&]() {
+      forensics_set_attribute("large", large_value.c_str());
       FORENSICS_ASSERT(false);
     });
+    CHECK(report_count == 1);
   }
 
-  SECTION("there is a single breadcrumb with several meta") {
-    auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 1);
-      CHECK(report->breadcrumbs != nullptr);
-      CHECK(!strcmp(report->breadcrumbs[0].name, "test"));
-      CHECK(report->breadcrumbs[0].meta_keys != nullptr);
-      CHECK(report->breadcrumbs[0].meta_values != nullptr);
-      CHECK(report->breadcrumbs[0].meta_count == 3);
-      CHECK(report->breadcrumbs[0].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[1], "build_id"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[1], "1.0.7"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[2], "debug"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[2], "false"));
+  SECTION("a freed large block is split for small values") {
+    const std::string large_value(1000, 'x');
+    forensics_set_attribute("large", large_value.c_str());
+    forensics_set_attribute("large", nullptr);
+    for (int index = 0; index < 32; ++index) {
+      snprintf(key, sizeof(key), "k%02d", index);
+      forensics_set_attribute(key, small_value);
+    }
+    int report_count = 0;
+    auto handler = [&](const forensics_report_t* report) {
+      ++report_count;
+      CHECK(report->attribute_count == 32);
+      CHECK(has_attribute_value(report, "k00", small_value));
+      CHECK(has_attribute_value(report, "k31", small_value));
     };
-    with_handler(handler, []() {
-      const char* meta_keys[] = {
-          "env",
-          "build_id",
-          "debug",
-      };
-      const char* meta_values[] = {
-          "production",
-          "1.0.7",
-          "false",
-      };
-      forensics_add_breadcrumb("test", meta_keys, meta_values, 3);
-      FORENSICS_ASSERT(false);
-    });
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    CHECK(report_count == 1);
   }
+}
+
+TEST_CASE("registered attributes") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_registered_attribute_count = 2;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+
+  SECTION("a registered attribute is only reported once it has a value") {
+    init_t init(&config);
+    const forensics_attribute_t request = forensics_attribute_register("request", 16);
+    CHECK(request != FORENSICS_ATTRIBUTE_INVALID);
+    CHECK(forensics_attribute_register("request", 64) == request);
+    forensics_set_attribute("build", "1234");
 
-  SECTION("there are multiple breadcrumbs") {
     auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 3);
-      CHECK(report->breadcrumbs != nullptr);
-      CHECK(!strcmp(report->breadcrumbs[0].name, "click"));
-      CHECK(report->breadcrumbs[0].meta_count == 1);
-      CHECK(report->breadcrumbs[0].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "pos"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "37, 100"));
+      CHECK(report->attribute_count == 1);
+      CHECK(has_attribute_value(report, "build", "1234"));
+      CHECK(!has_attribute(report, "request"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
 
-      CHECK(!strcmp(report->breadcrumbs[1].name, "connect"));
-      CHECK(report->breadcrumbs[1].meta_count == 1);
-      CHECK(report->breadcrumbs[1].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "endpoint"));
-      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "127.0.0.1:8080"));
+  SECTION("registered attributes are set, cut short and cleared") {
+    init_t init(&config);
+    const forensics_attribute_t request = forensics_attribute_register("request", 8);
+    const forensics_attribute_t depth = forensics_attribute_register("depth", 4);
+    forensics_set_attribute("build", "1234");
+    forensics_attribute_set_by_handle(request, "r-1");
+    forensics_attribute_set_by_handle(request, "r-123456789");
+    forensics_attribute_set_by_handle(depth, "12");
 
-      CHECK(!strcmp(report->breadcrumbs[2].name, "connect"));
-      CHECK(report->breadcrumbs[2].meta_count == 1);
-      CHECK(report->breadcrumbs[2].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[2].meta_keys[0], "endpoint"));
-      CHECK(!strcmp(report->breadcrumbs[2].meta_values[0], "10.0.0.1:9000"));
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 3);
+      CHECK(has_attribute_value(report, "build", "1234"));
+      CHECK(has_attribute_value(report, "request", "r-12345"));
+      CHECK(has_attribute_value(report, "depth", "12"));
     };
-    with_handler(handler, []() {
-      const char* b1_keys[] = {
-          "pos",
-      };
-      const char* b1_values[] = {
-          "37, 100",
-      };
-      const char* b2_keys[] = {
-          "endpoint",
-      };
-      const char* b2_values[] = {
-          "127.0.0.1:8080",
-      };
-      const char* b3_keys[] = {
-          "endpoint",
-      };
-      const char* b3_values[] = {
-          "10.0.0.1:9000",
-      };
-      forensics_add_breadcrumb("click", b1_keys, b1_values, 1);
-      forensics_add_breadcrumb("connect", b2_keys, b2_values, 1);
-      forensics_add_breadcrumb("connect", b3_keys, b3_values, 1);
-      FORENSICS_ASSERT(false);
-    });
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+
+    forensics_attribute_set_by_handle(depth, nullptr);
+    auto cleared_handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 2);
+      CHECK(!has_attribute(report, "depth"));
+    };
+    with_handler(cleared_handler, []() { FORENSICS_ASSERT(false); });
   }
 
-  SECTION("repeated breadcrumbs are collapsed") {
+  SECTION("registered attributes overflow, don't crash") {
+    init_t init(&config);
     auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 1);
-      CHECK(report->breadcrumbs != nullptr);
-      CHECK(!strcmp(report->breadcrumbs[0].name, "boot"));
-      CHECK(report->breadcrumbs[0].meta_count == 1);
-      CHECK(report->breadcrumbs[0].count == 2);
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+      CHECK(!strcmp(report->format, "Cannot register attribute because the registered attribute array is full. Try "
+                                    "increasing the size of max_registered_attribute_count. key=%s"));
     };
     with_handler(handler, []() {
-      const char* b1_keys[] = {
-          "env",
-      };
-      const char* b1_values[] = {
-          "production",
-      };
-      const char* b2_keys[] = {
-          "env",
-      };
-      const char* b2_values[] = {
-          "production",
-      };
-      forensics_add_breadcrumb("boot", b1_keys, b1_values, 1);
-      forensics_add_breadcrumb("boot", b2_keys, b2_values, 1);
-      FORENSICS_ASSERT(false);
+      CHECK(forensics_attribute_register("one", 8) != FORENSICS_ATTRIBUTE_INVALID);
+      CHECK(forensics_attribute_register("two", 8) != FORENSICS_ATTRIBUTE_INVALID);
+      CHECK(forensics_attribute_register("three", 8) == FORENSICS_ATTRIBUTE_INVALID);
     });
   }
 
-  SECTION("repeated breadcrumbs are not collapsed if meta differs") {
-    auto handler = [=](const forensics_report_t* report) {
-      CHECK(report->breadcrumb_count == 2);
-      CHECK(report->breadcrumbs != nullptr);
-      CHECK(!strcmp(report->breadcrumbs[0].name, "boot"));
-      CHECK(report->breadcrumbs[0].meta_count == 1);
-      CHECK(report->breadcrumbs[0].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
-      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+  SECTION("relaxed registered attributes are never reported half written") {
+    config.relaxed_attribute_handles = true;
+    init_t init(&config);
+    const forensics_attribute_t attribute = forensics_attribute_register("stripe", 64);
 
-      CHECK(!strcmp(report->breadcrumbs[1].name, "boot"));
-      CHECK(report->breadcrumbs[1].meta_count == 1);
-      CHECK(report->breadcrumbs[1].count == 1);
-      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "env"));
-      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "dev"));
+    // each writer fills the value with a single letter, so a torn read would mix letters
+    std::atomic<bool> stop(false);
+    std::atomic<int> write_count(0);
+    std::vector<std::thread> writers;
+    for (int thread_index = 0; thread_index < 4; ++thread_index) {
+      writers.emplace_back([&, thread_index]() {
+        const std::string value(thread_index % 2 == 0 ? 63 : 31, (char)('a' + thread_index));
+        while (!stop.load()) {
+          forensics_attribute_set_by_handle(attribute, value.c_str());
+          write_count.fetch_add(1, std::memory_order_relaxed);
+        }
+      });
+    }
+    while (write_count.load() == 0) {
+      std::this_thread::yield();
+    }
+
+    int torn_count = 0;
+    int seen_count = 0;
+    s_report_handler = [&](const forensics_report_t* report) {
+      for (int index = 0; index < report->attribute_count; ++index) {
+        const char* value = report->attribute_values[index];
+        const size_t size = strlen(value);
+        ++seen_count;
+        if ((size != 63 && size != 31) || value[size - 1] != value[0] || strspn(value, value + size - 1) != size) {
+          ++torn_count;
+        }
+      }
     };
-    with_handler(handler, []() {
-      const char* b1_keys[] = {
-          "env",
-      };
-      const char* b1_values[] = {
-          "production",
+    // a report can miss the value when the writers keep it busy, so keep going until enough have been seen
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (seen_count < 1000 && std::chrono::steady_clock::now() < deadline) {
+      FORENSICS_VERIFY(false);
+    }
+    s_report_handler = nullptr;
+    stop.store(true);
+    for (std::thread& writer : writers) {
+      writer.join();
+    }
+    CHECK(seen_count > 0);
+    CHECK(torn_count == 0);
+  }
+}
+
+TEST_CASE("thread attributes") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_thread_attribute_count = 3;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+  forensics_set_attribute("user", "shawn spencer");
+  forensics_set_attribute("version", "1.0.0");
+
+  SECTION("thread attributes take the place of process-wide ones while they are in scope") {
+    {
+      FORENSICS_THREAD_ATTRIBUTE("user", "gus");
+      FORENSICS_THREAD_ATTRIBUTE("request", "r-1");
+      auto handler = [=](const forensics_report_t* report) {
+        CHECK(report->attribute_count == 3);
+        CHECK(has_attribute_value(report, "user", "gus"));
+        CHECK(has_attribute_value(report, "version", "1.0.0"));
+        CHECK(has_attribute_value(report, "request", "r-1"));
       };
-      const char* b2_keys[] = {
-          "env",
+      with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    }
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "user", "shawn spencer"));
+      CHECK(!has_attribute(report, "request"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("the newest thread attribute with a key wins") {
+    FORENSICS_THREAD_ATTRIBUTE("request", "outer");
+    {
+      FORENSICS_THREAD_ATTRIBUTE("request", "inner");
+      auto handler = [=](const forensics_report_t* report) {
+        CHECK(report->attribute_count == 3);
+        CHECK(has_attribute_value(report, "request", "inner"));
       };
-      const char* b2_values[] = {
-          "dev",
+      with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    }
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 3);
+      CHECK(has_attribute_value(report, "request", "outer"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("thread attributes only show up in reports from their own thread") {
+    FORENSICS_THREAD_ATTRIBUTE("shard", "main");
+    std::thread thread([]() {
+      FORENSICS_THREAD_ATTRIBUTE("user", "juliet");
+      auto handler = [=](const forensics_report_t* report) {
+        CHECK(report->attribute_count == 2);
+        CHECK(has_attribute_value(report, "user", "juliet"));
+        CHECK(!has_attribute(report, "shard"));
       };
-      forensics_add_breadcrumb("boot", b1_keys, b1_values, 1);
-      forensics_add_breadcrumb("boot", b2_keys, b2_values, 1);
+      with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    });
+    thread.join();
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 3);
+      CHECK(has_attribute_value(report, "user", "shawn spencer"));
+      CHECK(has_attribute_value(report, "shard", "main"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("thread attribute overflow, don't crash") {
+    forensics_thread_attribute_begin("a", "1");
+    forensics_thread_attribute_begin("b", "2");
+    forensics_thread_attribute_begin("c", "3");
+    forensics_thread_attribute_begin("d", "4");
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 5);
+      CHECK(has_attribute_value(report, "c", "3"));
+      CHECK(!has_attribute(report, "d"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    forensics_thread_attribute_end();
+    forensics_thread_attribute_end();
+
+    auto after_handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 4);
+      CHECK(has_attribute_value(report, "a", "1"));
+      CHECK(has_attribute_value(report, "b", "2"));
+    };
+    with_handler(after_handler, []() { FORENSICS_ASSERT(false); });
+    forensics_thread_attribute_end();
+    forensics_thread_attribute_end();
+  }
+}
+
+static bool test_counting_provider(char* buf, unsigned int buf_size_bytes, void* user_data) {
+  int* call_count = (int*)user_data;
+  ++*call_count;
+  snprintf(buf, buf_size_bytes, "call %d", *call_count);
+  return true;
+}
+
+static bool test_empty_provider(char* buf, unsigned int buf_size_bytes, void* user_data) {
+  return false;
+}
+
+TEST_CASE("attribute providers") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_attribute_provider_count = 2;
+  config.attribute_provider_value_size_bytes = 8;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+  forensics_set_attribute("user", "shawn spencer");
+
+  SECTION("providers are only called when a report is built") {
+    int call_count = 0;
+    CHECK(forensics_register_attribute_provider("calls", &test_counting_provider, &call_count));
+    CHECK(forensics_register_attribute_provider("nothing", &test_empty_provider, nullptr));
+    CHECK(call_count == 0);
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "user", "shawn spencer"));
+      CHECK(has_attribute_value(report, "calls", "call 1"));
+      CHECK(!has_attribute(report, "nothing"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    CHECK(call_count == 1);
+  }
+
+  SECTION("provider values are cut short to fit") {
+    int call_count = 99999;
+    CHECK(forensics_register_attribute_provider("calls", &test_counting_provider, &call_count));
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(has_attribute_value(report, "calls", "call 10"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("registering a key again replaces its provider") {
+    int call_count = 0;
+    CHECK(forensics_register_attribute_provider("calls", &test_counting_provider, &call_count));
+    CHECK(forensics_register_attribute_provider("calls", &test_empty_provider, nullptr));
+    CHECK(forensics_register_attribute_provider("more calls", &test_counting_provider, &call_count));
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 2);
+      CHECK(!has_attribute(report, "calls"));
+      CHECK(has_attribute_value(report, "more calls", "call 1"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("attribute provider overflow, don't crash") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(!strcmp(report->format, "Cannot register attribute provider because the attribute provider array is full. "
+                                    "Try increasing the size of max_attribute_provider_count. key=%s"));
+    };
+    with_handler(handler, []() {
+      CHECK(forensics_register_attribute_provider("one", &test_empty_provider, nullptr));
+      CHECK(forensics_register_attribute_provider("two", &test_empty_provider, nullptr));
+      CHECK(!forensics_register_attribute_provider("three", &test_empty_provider, nullptr));
+    });
+  }
+}
+
+TEST_CASE("numeric attributes") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_numeric_attribute_count = 2;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+  forensics_set_attribute("user", "shawn spencer");
+
+  SECTION("numeric attributes are formatted in the report and typed in attribute_typed_values") {
+    forensics_numeric_attribute_t bytes =
+        forensics_numeric_attribute_register("bytes_in_flight", FORENSICS_VALUE_INT64);
+    forensics_numeric_attribute_t load = forensics_numeric_attribute_register("load", FORENSICS_VALUE_DOUBLE);
+    CHECK(bytes != FORENSICS_NUMERIC_ATTRIBUTE_INVALID);
+    CHECK(load != FORENSICS_NUMERIC_ATTRIBUTE_INVALID);
+    CHECK(forensics_numeric_attribute_register("bytes_in_flight", FORENSICS_VALUE_INT64) == bytes);
+
+    forensics_numeric_attribute_set_i64(bytes, 4096);
+    forensics_numeric_attribute_add_i64(bytes, -96);
+    forensics_numeric_attribute_set_f64(load, 0.75);
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->attribute_count == 3);
+      CHECK(has_attribute_value(report, "user", "shawn spencer"));
+      CHECK(has_attribute_value(report, "bytes_in_flight", "4000"));
+      CHECK(has_attribute_value(report, "load", "0.75"));
+      REQUIRE(report->attribute_typed_values != nullptr);
+      for (int index = 0; index < report->attribute_count; ++index) {
+        const forensics_value_t* value = &report->attribute_typed_values[index];
+        if (0 == strcmp(report->attribute_keys[index], "bytes_in_flight")) {
+          CHECK(value->type == FORENSICS_VALUE_INT64);
+          CHECK(value->as.i64 == 4000);
+        }
+        else if (0 == strcmp(report->attribute_keys[index], "load")) {
+          CHECK(value->type == FORENSICS_VALUE_DOUBLE);
+          CHECK(value->as.f64 == 0.75);
+        }
+        else {
+          CHECK(value->type == FORENSICS_VALUE_STRING);
+          CHECK(!strcmp(value->as.str, report->attribute_values[index]));
+        }
+      }
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("numeric attributes can be changed from many threads") {
+    forensics_numeric_attribute_t count = forensics_numeric_attribute_register("count", FORENSICS_VALUE_INT64);
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < 4; ++thread_index) {
+      threads.emplace_back([=]() {
+        for (int index = 0; index < 1000; ++index) {
+          forensics_numeric_attribute_add_i64(count, 1);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(has_attribute_value(report, "count", "4000"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("setting a numeric attribute with the wrong type, don't crash") {
+    forensics_numeric_attribute_t load = forensics_numeric_attribute_register("load", FORENSICS_VALUE_DOUBLE);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(!strcmp(report->format, "Numeric attribute set with the wrong type. key=%s type=%d expected=%d"));
+    };
+    with_handler(handler, [=]() { forensics_numeric_attribute_set_i64(load, 1); });
+  }
+
+  SECTION("numeric attribute overflow, don't crash") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(!strcmp(report->format, "Cannot register numeric attribute because the numeric attribute array is full. "
+                                    "Try increasing the size of max_numeric_attribute_count. key=%s"));
+    };
+    with_handler(handler, []() {
+      CHECK(forensics_numeric_attribute_register("one", FORENSICS_VALUE_INT64) != FORENSICS_NUMERIC_ATTRIBUTE_INVALID);
+      CHECK(forensics_numeric_attribute_register("two", FORENSICS_VALUE_INT64) != FORENSICS_NUMERIC_ATTRIBUTE_INVALID);
+      CHECK(forensics_numeric_attribute_register("three", FORENSICS_VALUE_DOUBLE) ==
+            FORENSICS_NUMERIC_ATTRIBUTE_INVALID);
+    });
+  }
+}
+
+TEST_CASE("context") {
+  init_t init(nullptr);
+
+  SECTION("there is no context") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->context_count == 0);
+      CHECK(report->context_stack == nullptr);
+      CHECK(report->context_hashes == nullptr);
+      CHECK(!strcmp(report->id, REPORT_ID("<none>", "forensics_spec.cpp", "")));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("there is a single context") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->context_count == 1);
+      CHECK(!strcmp(report->context_stack[0], "global"));
+      CHECK(!strcmp(report->id, REPORT_ID("global", "forensics_spec.cpp", "")));
+    };
+    with_handler(handler, []() {
+      FORENSICS_CONTEXT("global");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("there are many contexts") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->context_count == 3);
+      CHECK(!strcmp(report->context_stack[0], "global"));
+      CHECK(!strcmp(report->context_stack[1], "local"));
+      CHECK(!strcmp(report->context_stack[2], "personal"));
+      CHECK(!strcmp(report->id, REPORT_ID("personal", "forensics_spec.cpp", "")));
+    };
+    with_handler(handler, []() {
+      FORENSICS_CONTEXT("global");
+      FORENSICS_CONTEXT("local");
+      FORENSICS_CONTEXT("personal");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("every context name has a hash, literals have theirs at compile time") {
+    static_assert(forensics_context_name_hash("global") != forensics_context_name_hash("local"), "");
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->context_count == 3);
+      REQUIRE(report->context_hashes != nullptr);
+      CHECK(report->context_hashes[0] == forensics_context_name_hash("global"));
+      CHECK(report->context_hashes[1] == forensics_context_name_hash("local"));
+      CHECK(report->context_hashes[2] == forensics_context_name_hash("named"));
+    };
+    with_handler(handler, []() {
+      // only the literal is pushed with its hash, the others are hashed when the report needs them
+      FORENSICS_CONTEXT("global");
+      CHECK(forensics_private_context_stack.hashes[0] == forensics_context_name_hash("global"));
+      forensics_context_begin("local");
+      CHECK(forensics_private_context_stack.hashes[1] == 0);
+      const char named[] = "named";
+      FORENSICS_CONTEXT(named);
+      CHECK(forensics_private_context_stack.hashes[2] == 0);
+      FORENSICS_ASSERT(false);
+      forensics_context_end();
+    });
+  }
+
+  SECTION("names that aren't literals are kept by pointer") {
+    const std::string name = "request 42";
+    auto handler = [&](const forensics_report_t* report) {
+      REQUIRE(report->context_count == 1);
+      CHECK(report->context_stack[0] == name.c_str());
+      CHECK(report->context_hashes[0] == forensics_context_name_hash("request 42"));
+    };
+    with_handler(handler, [&]() {
+      FORENSICS_CONTEXT(name.c_str());
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+#ifndef NDEBUG
+  SECTION("names that change while they are on the stack are reported in debug builds") {
+    int report_count = 0;
+    auto handler = [&](const forensics_report_t* report) {
+      ++report_count;
+      CHECK(report->context_count == 0);
+      CHECK(strstr(report->formatted, "FORENSICS_CONTEXT_COPY") != nullptr);
+    };
+    with_handler(handler, []() {
+      char name[32] = "request 42";
+      {
+        FORENSICS_CONTEXT(name);
+        name[8] = '7';
+      }
+      // the same name unchanged is fine
+      FORENSICS_CONTEXT(name);
+    });
+    CHECK(report_count == 1);
+  }
+#endif
+
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+  SECTION("long literals are hashed at compile time") {
+#define NAME_10(s) s s s s s s s s s s
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->context_count == 1);
+      CHECK(strlen(report->context_stack[0]) == 1000);
+      CHECK(report->context_hashes[0] == forensics_context_name_hash(std::string(1000, 'x').c_str()));
+    };
+    with_handler(handler, []() {
+      FORENSICS_CONTEXT(NAME_10(NAME_10(NAME_10("x"))));
+      CHECK(forensics_private_context_stack.hashes[0] != 0);
+      FORENSICS_ASSERT(false);
+    });
+#undef NAME_10
+  }
+#endif
+
+  SECTION("names built at runtime can be copied once") {
+    const char* first_copy = nullptr;
+    auto handler = [&](const forensics_report_t* report) {
+      REQUIRE(report->context_count == 1);
+      CHECK(!strcmp(report->context_stack[0], "request 42"));
+      CHECK(report->context_hashes[0] == forensics_context_name_hash("request 42"));
+      if (first_copy == nullptr) {
+        first_copy = report->context_stack[0];
+      }
+      CHECK(report->context_stack[0] == first_copy);
+    };
+    for (int round = 0; round < 2; ++round) {
+      with_handler(handler, []() {
+        char name[32];
+        snprintf(name, sizeof(name), "request %d", 42);
+        FORENSICS_CONTEXT_COPY(name);
+        strcpy(name, "overwritten");
+        FORENSICS_ASSERT(false);
+      });
+    }
+    with_handler(handler, []() {
+      const std::string name = std::string("request ") + "42";
+      FORENSICS_CONTEXT_COPY(name.c_str());
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("copied names that don't fit in the interned string table are unknown, don't crash") {
+    int report_count = 0;
+    auto handler = [&](const forensics_report_t* report) {
+      ++report_count;
+    };
+    with_handler(handler, []() {
+      char name[32];
+      for (int index = 0; index < 300; ++index) {
+        snprintf(name, sizeof(name), "request %d", index);
+        forensics_context_begin_copy(name);
+        forensics_context_end();
+      }
+    });
+    CHECK(report_count == 0);
+
+    auto full_handler = [&](const forensics_report_t* report) {
+      REQUIRE(report->context_count == 1);
+      CHECK(!strcmp(report->context_stack[0], "<unknown>"));
+    };
+    with_handler(full_handler, []() {
+      FORENSICS_CONTEXT_COPY(std::string("one more").c_str());
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("an interned name") {
+    const forensics_string_t name = forensics_intern_string("storage");
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->context_count == 1);
+      CHECK(report->context_stack[0] == forensics_interned_string(name));
+    };
+    with_handler(handler, [=]() {
+      FORENSICS_CONTEXT(name);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("contexts that don't fit are left out and popped first, don't crash") {
+    for (int index = 0; index < 130; ++index) {
+      forensics_context_begin(index < 128 ? "fits" : "overflow");
+    }
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->context_count == 128);
+      CHECK(!strcmp(report->context_stack[127], "fits"));
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+    for (int index = 0; index < 130; ++index) {
+      forensics_context_end();
+    }
+
+    auto after_handler = [=](const forensics_report_t* report) {
+      CHECK(report->context_count == 0);
+    };
+    with_handler(after_handler, []() { FORENSICS_ASSERT(false); });
+  }
+}
+
+TEST_CASE("breadcrumbs") {
+  init_t init(nullptr);
+
+  SECTION("there are no breadcrumbs") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 0);
+      CHECK(report->breadcrumbs == nullptr);
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("there is a single breadcrumb with no meta") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs != nullptr);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "test"));
+      CHECK(report->breadcrumbs[0].meta_keys == nullptr);
+      CHECK(report->breadcrumbs[0].meta_values == nullptr);
+      CHECK(report->breadcrumbs[0].meta_count == 0);
+      CHECK(report->breadcrumbs[0].count == 1);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("test", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("there is a single breadcrumb with 1 meta") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs != nullptr);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "test"));
+      CHECK(report->breadcrumbs[0].meta_keys != nullptr);
+      CHECK(report->breadcrumbs[0].meta_values != nullptr);
+      CHECK(report->breadcrumbs[0].meta_count == 1);
+      CHECK(report->breadcrumbs[0].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {
+          "env",
+      };
+      const char* meta_values[] = {
+          "production",
+      };
+      forensics_add_breadcrumb("test", meta_keys, meta_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("there is a single breadcrumb with several meta") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs != nullptr);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "test"));
+      CHECK(report->breadcrumbs[0].meta_keys != nullptr);
+      CHECK(report->breadcrumbs[0].meta_values != nullptr);
+      CHECK(report->breadcrumbs[0].meta_count == 3);
+      CHECK(report->breadcrumbs[0].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[1], "build_id"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[1], "1.0.7"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[2], "debug"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[2], "false"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {
+          "env",
+          "build_id",
+          "debug",
+      };
+      const char* meta_values[] = {
+          "production",
+          "1.0.7",
+          "false",
+      };
+      forensics_add_breadcrumb("test", meta_keys, meta_values, 3);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("there are multiple breadcrumbs") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(report->breadcrumbs != nullptr);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "click"));
+      CHECK(report->breadcrumbs[0].meta_count == 1);
+      CHECK(report->breadcrumbs[0].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "pos"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "37, 100"));
+
+      CHECK(!strcmp(report->breadcrumbs[1].name, "connect"));
+      CHECK(report->breadcrumbs[1].meta_count == 1);
+      CHECK(report->breadcrumbs[1].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "endpoint"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "127.0.0.1:8080"));
+
+      CHECK(!strcmp(report->breadcrumbs[2].name, "connect"));
+      CHECK(report->breadcrumbs[2].meta_count == 1);
+      CHECK(report->breadcrumbs[2].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[2].meta_keys[0], "endpoint"));
+      CHECK(!strcmp(report->breadcrumbs[2].meta_values[0], "10.0.0.1:9000"));
+    };
+    with_handler(handler, []() {
+      const char* b1_keys[] = {
+          "pos",
+      };
+      const char* b1_values[] = {
+          "37, 100",
+      };
+      const char* b2_keys[] = {
+          "endpoint",
+      };
+      const char* b2_values[] = {
+          "127.0.0.1:8080",
+      };
+      const char* b3_keys[] = {
+          "endpoint",
+      };
+      const char* b3_values[] = {
+          "10.0.0.1:9000",
+      };
+      forensics_add_breadcrumb("click", b1_keys, b1_values, 1);
+      forensics_add_breadcrumb("connect", b2_keys, b2_values, 1);
+      forensics_add_breadcrumb("connect", b3_keys, b3_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated breadcrumbs are collapsed") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs != nullptr);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "boot"));
+      CHECK(report->breadcrumbs[0].meta_count == 1);
+      CHECK(report->breadcrumbs[0].count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+    };
+    with_handler(handler, []() {
+      const char* b1_keys[] = {
+          "env",
+      };
+      const char* b1_values[] = {
+          "production",
+      };
+      const char* b2_keys[] = {
+          "env",
+      };
+      const char* b2_values[] = {
+          "production",
+      };
+      forensics_add_breadcrumb("boot", b1_keys, b1_values, 1);
+      forensics_add_breadcrumb("boot", b2_keys, b2_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated breadcrumbs are not collapsed if meta differs") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(report->breadcrumbs != nullptr);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "boot"));
+      CHECK(report->breadcrumbs[0].meta_count == 1);
+      CHECK(report->breadcrumbs[0].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "env"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "production"));
+
+      CHECK(!strcmp(report->breadcrumbs[1].name, "boot"));
+      CHECK(report->breadcrumbs[1].meta_count == 1);
+      CHECK(report->breadcrumbs[1].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "env"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "dev"));
+    };
+    with_handler(handler, []() {
+      const char* b1_keys[] = {
+          "env",
+      };
+      const char* b1_values[] = {
+          "production",
+      };
+      const char* b2_keys[] = {
+          "env",
+      };
+      const char* b2_values[] = {
+          "dev",
+      };
+      forensics_add_breadcrumb("boot", b1_keys, b1_values, 1);
+      forensics_add_breadcrumb("boot", b2_keys, b2_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated breadcrumbs are not collapsed if text moves between name, keys and values") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "ab"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[0], "c"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "a"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "bc"));
+      CHECK(!strcmp(report->breadcrumbs[2].meta_keys[0], "b"));
+      CHECK(!strcmp(report->breadcrumbs[2].meta_values[0], "c"));
+    };
+    with_handler(handler, []() {
+      const char* c_keys[] = {"c"};
+      const char* bc_keys[] = {"bc"};
+      const char* b_keys[] = {"b"};
+      const char* empty_values[] = {""};
+      const char* c_values[] = {"c"};
+      forensics_add_breadcrumb("ab", c_keys, empty_values, 1);
+      forensics_add_breadcrumb("a", bc_keys, empty_values, 1);
+      forensics_add_breadcrumb("a", b_keys, c_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("strings of every length are copied intact") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 40);
+      for (int index = 0; index < report->breadcrumb_count && index < 40; ++index) {
+        const std::string name(index + 1, 'n');
+        const std::string value(index, 'v');
+        CHECK(report->breadcrumbs[index].name == name);
+        CHECK(!strcmp(report->breadcrumbs[index].meta_keys[0], "key"));
+        CHECK(report->breadcrumbs[index].meta_values[0] == value);
+      }
+    };
+    with_handler(handler, []() {
+      for (int index = 0; index < 40; ++index) {
+        const std::string name(index + 1, 'n');
+        const std::string value(index, 'v');
+        const char* meta_keys[] = {"key"};
+        const char* meta_values[] = {value.c_str()};
+        forensics_add_breadcrumb(name.c_str(), meta_keys, meta_values, 1);
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated breadcrumbs are collapsed wherever their strings are in memory") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "a name long enough to span a chunk or two"));
+      CHECK(report->breadcrumbs[0].count == 3 + 16);
+    };
+    with_handler(handler, []() {
+      // one copy straddles a page boundary, the others start at every offset within an aligned block
+      static const char name[] = "a name long enough to span a chunk or two";
+      static char buf[3 * 4096];
+      char* page_end = (char*)(((uintptr_t)buf + 2 * 4096) & ~(uintptr_t)4095);
+      char* straddling = page_end - 5;
+      char* unaligned = buf + 1;
+      memcpy(straddling, name, sizeof(name));
+      memcpy(unaligned, name, sizeof(name));
+      forensics_add_breadcrumb(name, nullptr, nullptr, 0);
+      forensics_add_breadcrumb(straddling, nullptr, nullptr, 0);
+      forensics_add_breadcrumb(unaligned, nullptr, nullptr, 0);
+      alignas(16) static char block_buf[16 + 2 * sizeof(name)];
+      for (int offset = 0; offset < 16; ++offset) {
+        memset(block_buf, 'x', sizeof(block_buf));
+        memcpy(block_buf + offset, name, sizeof(name));
+        forensics_add_breadcrumb(block_buf + offset, nullptr, nullptr, 0);
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs with lots of meta") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs[0].meta_count == 24);
+      for (int index = 0; index < report->breadcrumbs[0].meta_count; ++index) {
+        CHECK(report->breadcrumbs[0].meta_keys[index] == "key" + std::to_string(index));
+        CHECK(report->breadcrumbs[0].meta_values[index] == "value" + std::to_string(index));
+      }
+    };
+    with_handler(handler, []() {
+      std::string keys[24];
+      std::string values[24];
+      const char* meta_keys[24];
+      const char* meta_values[24];
+      for (int index = 0; index < 24; ++index) {
+        keys[index] = "key" + std::to_string(index);
+        values[index] = "value" + std::to_string(index);
+        meta_keys[index] = keys[index].c_str();
+        meta_values[index] = values[index].c_str();
+      }
+      forensics_add_breadcrumb("test", meta_keys, meta_values, 24);
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+TEST_CASE("interned breadcrumbs") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_interned_string_count = 4;
+  config.breadcrumb_buf_size_bytes = 72;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("interning the same string returns the same handle") {
+    char name[] = "connect";
+    const forensics_string_t handle = forensics_intern_string(name);
+    CHECK(handle != FORENSICS_STRING_INVALID);
+    name[0] = 'x';
+    CHECK(forensics_intern_string("connect") == handle);
+    CHECK(forensics_intern_string("disconnect") != handle);
+    CHECK(!strcmp(forensics_interned_string(handle), "connect"));
+    CHECK(forensics_interned_string(FORENSICS_STRING_INVALID) == nullptr);
+  }
+
+  SECTION("threads interning the same strings get the same handles") {
+    static const char* names[] = {"open", "read", "write", "close"};
+    forensics_string_t handles[4][4];
+    std::vector<std::thread> threads;
+    for (int thread_index = 0; thread_index < 4; ++thread_index) {
+      threads.emplace_back([&handles, thread_index]() {
+        for (int round = 0; round < 1000; ++round) {
+          for (int index = 0; index < 4; ++index) {
+            handles[thread_index][index] = forensics_intern_string(names[(index + thread_index) % 4]);
+          }
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+    for (int thread_index = 0; thread_index < 4; ++thread_index) {
+      for (int index = 0; index < 4; ++index) {
+        const forensics_string_t handle = handles[thread_index][index];
+        CHECK(!strcmp(forensics_interned_string(handle), names[(index + thread_index) % 4]));
+        CHECK(handle == handles[0][(index + thread_index) % 4]);
+      }
+    }
+  }
+
+  SECTION("interned names and keys are reported") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "boot"));
+      CHECK(report->breadcrumbs[0].meta_count == 0);
+      CHECK(report->breadcrumbs[0].meta_keys == nullptr);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "connect"));
+      CHECK(report->breadcrumbs[1].count == 2);
+      CHECK(report->breadcrumbs[1].meta_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "endpoint"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "127.0.0.1:8080"));
+    };
+    with_handler(handler, []() {
+      const forensics_string_t boot = forensics_intern_string("boot");
+      const forensics_string_t connect = forensics_intern_string("connect");
+      const forensics_string_t meta_keys[] = {forensics_intern_string("endpoint")};
+      const char* meta_values[] = {"127.0.0.1:8080"};
+      const char* plain_meta_keys[] = {"endpoint"};
+      forensics_add_breadcrumb_interned(boot, nullptr, nullptr, 0);
+      forensics_add_breadcrumb_interned(connect, meta_keys, meta_values, 1);
+      forensics_add_breadcrumb("connect", plain_meta_keys, meta_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("interned crumbs only take space for their values") {
+    auto handler = [=](const forensics_report_t* report) {
+      // each crumb needs 16 bytes of pointers and 2 bytes of value (rounded up to 24), so three fit in 72 bytes where
+      // a single plain crumb carrying the long name and key would not
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "1"));
+      CHECK(!strcmp(report->breadcrumbs[2].meta_values[0], "3"));
+    };
+    with_handler(handler, []() {
+      const forensics_string_t name = forensics_intern_string("a rather long breadcrumb name");
+      const forensics_string_t meta_keys[] = {forensics_intern_string("a rather long metadata key")};
+      const char* meta_values[] = {"1", "2", "3"};
+      for (int index = 0; index < 3; ++index) {
+        forensics_add_breadcrumb_interned(name, meta_keys, meta_values + index, 1);
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("interned string storage overflow, don't crash") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(!strcmp(report->format, "Cannot intern string because the interned string array is full. Try increasing "
+                                    "the size of max_interned_string_count. string=%s"));
+      CHECK(report->fatal == true);
+    };
+    with_handler(handler, []() {
+      CHECK(forensics_intern_string("one") != FORENSICS_STRING_INVALID);
+      CHECK(forensics_intern_string("two") != FORENSICS_STRING_INVALID);
+      CHECK(forensics_intern_string("three") != FORENSICS_STRING_INVALID);
+      CHECK(forensics_intern_string("four") != FORENSICS_STRING_INVALID);
+      CHECK(forensics_intern_string("five") == FORENSICS_STRING_INVALID);
+    });
+  }
+}
+
+TEST_CASE("typed breadcrumbs") {
+  init_t init(nullptr);
+
+  SECTION("typed values are formatted in the report") {
+    static int s_target;
+    auto handler = [=](const forensics_report_t* report) {
+      char expected_ptr[32];
+      snprintf(expected_ptr, sizeof(expected_ptr), "%p", (void*)&s_target);
+
+      CHECK(report->breadcrumb_count == 1);
+      const forensics_breadcrumb_t* crumb = &report->breadcrumbs[0];
+      CHECK(!strcmp(crumb->name, "request"));
+      CHECK(crumb->meta_count == 6);
+      CHECK(crumb->meta_typed_values != nullptr);
+      CHECK(!strcmp(crumb->meta_keys[0], "delta"));
+      CHECK(!strcmp(crumb->meta_values[0], "-42"));
+      CHECK(crumb->meta_typed_values[0].type == FORENSICS_VALUE_INT64);
+      CHECK(crumb->meta_typed_values[0].as.i64 == -42);
+      CHECK(!strcmp(crumb->meta_values[1], "18446744073709551615"));
+      CHECK(!strcmp(crumb->meta_values[2], "0.25"));
+      CHECK(!strcmp(crumb->meta_values[3], expected_ptr));
+      CHECK(!strcmp(crumb->meta_values[4], "true"));
+      CHECK(!strcmp(crumb->meta_values[5], "GET"));
+      CHECK(crumb->meta_typed_values[5].type == FORENSICS_VALUE_STRING);
+      CHECK(!strcmp(crumb->meta_typed_values[5].as.str, "GET"));
+    };
+    with_handler(handler, []() {
+      char method[] = "GET";
+      const char* meta_keys[] = {"delta", "bytes", "ratio", "target", "cached", "method"};
+      const forensics_value_t meta_values[] = {
+          forensics_value_i64(-42),
+          forensics_value_u64(UINT64_MAX),
+          forensics_value_f64(0.25),
+          forensics_value_ptr(&s_target),
+          forensics_value_bool(true),
+          forensics_value_str(method),
+      };
+      forensics_add_breadcrumb_typed("request", meta_keys, meta_values, 6);
+      method[0] = 'x';
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated typed breadcrumbs are collapsed if the values match") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(report->breadcrumbs[0].count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "1"));
+      CHECK(report->breadcrumbs[1].count == 1);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "2"));
+      CHECK(report->breadcrumbs[2].meta_typed_values == nullptr);
+      CHECK(!strcmp(report->breadcrumbs[2].meta_values[0], "2"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"depth"};
+      const forensics_value_t one = forensics_value_i64(1);
+      const forensics_value_t two = forensics_value_i64(2);
+      const char* two_str[] = {"2"};
+      forensics_add_breadcrumb_typed("poll", meta_keys, &one, 1);
+      forensics_add_breadcrumb_typed("poll", meta_keys, &one, 1);
+      forensics_add_breadcrumb_typed("poll", meta_keys, &two, 1);
+      forensics_add_breadcrumb("poll", meta_keys, two_str, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("values can be formatted on demand") {
+    char buf[8];
+    const forensics_value_t value = forensics_value_i64(1234567890);
+    CHECK(forensics_value_format(&value, buf, sizeof(buf)) == 10);
+    CHECK(!strcmp(buf, "1234567"));
+  }
+}
+
+TEST_CASE("breadcrumb loops") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 4;
+  config.max_breadcrumb_loop_length = 3;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+
+  auto add_names = [](const char* names) {
+    for (const char* ptr = names; *ptr != 0; ++ptr) {
+      const char name[] = {*ptr, 0};
+      forensics_add_breadcrumb(name, nullptr, nullptr, 0);
+    }
+  };
+
+  SECTION("a repeated block is stored once, followed by the partial pass") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 5);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "a"));
+      CHECK(report->breadcrumbs[0].loop_length == 0);
+      CHECK(!strcmp(report->breadcrumbs[2].name, "c"));
+      CHECK(report->breadcrumbs[2].count == 1);
+      CHECK(report->breadcrumbs[2].loop_length == 3);
+      CHECK(report->breadcrumbs[2].loop_count == 10);
+      CHECK(!strcmp(report->breadcrumbs[3].name, "a"));
+      CHECK(!strcmp(report->breadcrumbs[4].name, "b"));
+      CHECK(report->breadcrumbs[4].loop_length == 0);
+    };
+    with_handler(handler, [=]() {
+      for (int pass = 0; pass < 10; ++pass) {
+        add_names("abc");
+      }
+      add_names("ab");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("a repeated block doesn't push out older breadcrumbs") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "x"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "c"));
+      CHECK(report->breadcrumbs[3].loop_count == 100);
+    };
+    with_handler(handler, [=]() {
+      add_names("x");
+      for (int pass = 0; pass < 100; ++pass) {
+        add_names("abc");
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("a block that breaks off part way through is stored as it was left") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "b"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "c"));
+      CHECK(!strcmp(report->breadcrumbs[2].name, "a"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "d"));
+      for (int index = 0; index < report->breadcrumb_count; ++index) {
+        CHECK(report->breadcrumbs[index].loop_length == 0);
+      }
+    };
+    with_handler(handler, [=]() {
+      add_names("abcad");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated breadcrumbs within a block are matched by count") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "a"));
+      CHECK(report->breadcrumbs[0].count == 2);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "b"));
+      CHECK(report->breadcrumbs[1].loop_length == 2);
+      CHECK(report->breadcrumbs[1].loop_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[2].name, "a"));
+      CHECK(report->breadcrumbs[2].count == 3);
+      CHECK(!strcmp(report->breadcrumbs[3].name, "c"));
+    };
+    with_handler(handler, [=]() {
+      add_names("aabaabaaac");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("blocks longer than the limit aren't recognized") {
+    config.max_breadcrumb_loop_length = 1;
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "a"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "b"));
+      CHECK(report->breadcrumbs[3].loop_length == 0);
+    };
+    with_handler(handler, [=]() {
+      add_names("abab");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("blocks are found within each thread's ring") {
+    config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_PER_THREAD;
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "b"));
+      CHECK(report->breadcrumbs[1].loop_count == 5);
+      CHECK(!strcmp(report->breadcrumbs[2].name, "a"));
+      CHECK(report->breadcrumbs[2].loop_length == 0);
+    };
+    with_handler(handler, [=]() {
+      for (int pass = 0; pass < 5; ++pass) {
+        add_names("ab");
+      }
+      add_names("a");
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+TEST_CASE("breadcrumb timestamps") {
+  init_t init(nullptr);
+
+  SECTION("breadcrumbs are stamped in order, before the report") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      const forensics_breadcrumb_t* first = &report->breadcrumbs[0];
+      const forensics_breadcrumb_t* second = &report->breadcrumbs[1];
+      CHECK(first->first_timestamp > 0);
+      CHECK(first->first_timestamp == first->last_timestamp);
+      CHECK(second->first_timestamp >= first->last_timestamp);
+      CHECK(report->timestamp >= second->last_timestamp);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("two", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("coalesced runs keep the first and last timestamps") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs[0].count == 2);
+      CHECK(report->breadcrumbs[0].last_timestamp - report->breadcrumbs[0].first_timestamp >= 1000000);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("poll", nullptr, nullptr, 0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      forensics_add_breadcrumb("poll", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeated blocks keep the first and last timestamps") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(report->breadcrumbs[1].loop_count == 2);
+      CHECK(report->breadcrumbs[0].last_timestamp - report->breadcrumbs[0].first_timestamp >= 1000000);
+      CHECK(report->breadcrumbs[1].last_timestamp - report->breadcrumbs[1].first_timestamp >= 1000000);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("read", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("write", nullptr, nullptr, 0);
+      std::this_thread::sleep_for(std::chrono::milliseconds(2));
+      forensics_add_breadcrumb("read", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("write", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("a block that breaks off part way through keeps the timestamps of each pass") {
+    auto add_spaced = [](const char* names) {
+      for (const char* ptr = names; *ptr != 0; ++ptr) {
+        const char name[] = {*ptr, 0};
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        forensics_add_breadcrumb(name, nullptr, nullptr, 0);
+      }
+    };
+    auto check_in_order = [](const forensics_report_t* report) {
+      for (int index = 0; index < report->breadcrumb_count; ++index) {
+        const forensics_breadcrumb_t* crumb = &report->breadcrumbs[index];
+        CHECK(crumb->count == 1);
+        CHECK(crumb->first_timestamp == crumb->last_timestamp);
+        if (index > 0) {
+          CHECK(crumb->first_timestamp > report->breadcrumbs[index - 1].last_timestamp);
+        }
+      }
+    };
+
+    // "a" starts a second pass through "ab", which is still under way when the first report is made
+    auto partial_handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[2].name, "a"));
+      check_in_order(report);
+    };
+    with_handler(partial_handler, [=]() {
+      add_spaced("aba");
+      FORENSICS_ASSERT(false);
+    });
+
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "a"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "b"));
+      CHECK(!strcmp(report->breadcrumbs[2].name, "a"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "c"));
+      check_in_order(report);
+    };
+    with_handler(handler, [=]() {
+      add_spaced("c");
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+TEST_CASE("breadcrumb channels") {
+  forensics_breadcrumb_channel_config_t channels[2];
+  channels[0].name = "net";
+  channels[0].max_breadcrumb_count = 2;
+  channels[0].breadcrumb_buf_size_bytes = 256;
+  channels[1].name = "config";
+  channels[1].max_breadcrumb_count = 4;
+  channels[1].breadcrumb_buf_size_bytes = 256;
+
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 2;
+  config.breadcrumb_channels = channels;
+  config.breadcrumb_channel_count = 2;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("channels are looked up by name") {
+    CHECK(forensics_breadcrumb_channel("net") == 1);
+    CHECK(forensics_breadcrumb_channel("config") == 2);
+    CHECK(forensics_breadcrumb_channel("disk") == FORENSICS_CHANNEL_DEFAULT);
+  }
+
+  SECTION("breadcrumbs from every channel are merged in order") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "boot"));
+      CHECK(report->breadcrumbs[0].channel == nullptr);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "connect"));
+      CHECK(!strcmp(report->breadcrumbs[1].channel, "net"));
+      CHECK(!strcmp(report->breadcrumbs[2].name, "reload"));
+      CHECK(!strcmp(report->breadcrumbs[2].channel, "config"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "ready"));
+      CHECK(report->breadcrumbs[3].channel == nullptr);
+    };
+    with_handler(handler, []() {
+      const forensics_channel_t net = forensics_breadcrumb_channel("net");
+      const forensics_channel_t config = forensics_breadcrumb_channel("config");
+      forensics_add_breadcrumb("boot", nullptr, nullptr, 0);
+      forensics_add_channel_breadcrumb(net, "connect", nullptr, nullptr, 0);
+      forensics_add_channel_breadcrumb(config, "reload", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("ready", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("a busy channel doesn't push out the breadcrumbs of another one") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "failover"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "replica"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "8"));
+      CHECK(!strcmp(report->breadcrumbs[2].meta_values[0], "9"));
+    };
+    with_handler(handler, []() {
+      const forensics_channel_t net = forensics_breadcrumb_channel("net");
+      const forensics_channel_t config = forensics_breadcrumb_channel("config");
+      const char* meta_keys[] = {"target"};
+      const char* failover_values[] = {"replica"};
+      forensics_add_channel_breadcrumb(config, "failover", meta_keys, failover_values, 1);
+
+      const char* poll_values[] = {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
+      for (int index = 0; index < 10; ++index) {
+        forensics_add_channel_breadcrumb(net, "poll", meta_keys, poll_values + index, 1);
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("typed and interned breadcrumbs can go to a channel") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].channel, "net"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "42"));
+      CHECK(!strcmp(report->breadcrumbs[1].channel, "config"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "reload"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"bytes"};
+      const forensics_value_t meta_values[] = {forensics_value_i64(42)};
+      forensics_add_channel_breadcrumb_typed(forensics_breadcrumb_channel("net"), "read", meta_keys, meta_values, 1);
+      forensics_add_channel_breadcrumb_interned(
+          forensics_breadcrumb_channel("config"), forensics_intern_string("reload"), nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the report handler can leave breadcrumbs in a channel") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      forensics_add_channel_breadcrumb(forensics_breadcrumb_channel("net"), "reported", nullptr, nullptr, 0);
+    };
+    with_handler(handler, []() {
+      forensics_add_channel_breadcrumb(forensics_breadcrumb_channel("net"), "connect", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("invalid channel handle") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(!strcmp(report->format, "Invalid breadcrumb channel handle: %u"));
+      CHECK(report->breadcrumb_count == 0);
+    };
+    with_handler(handler, []() {
+      forensics_add_channel_breadcrumb(3, "lost", nullptr, nullptr, 0);
+    });
+  }
+}
+
+TEST_CASE("breadcrumb levels") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.breadcrumb_level = FORENSICS_BREADCRUMB_LEVEL_INFO;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("breadcrumbs below the level are skipped without evaluating their arguments") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "connect"));
+      CHECK(report->breadcrumbs[0].meta_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_keys[1], "port"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[1], "8080"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "retry"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "3"));
+      CHECK(!strcmp(report->breadcrumbs[2].name, "failover"));
+    };
+    with_handler(handler, []() {
+      int evaluated = 0;
+      auto value = [&](const char* str) {
+        ++evaluated;
+        return str;
+      };
+      FORENSICS_BREADCRUMB_TRACE("poll", ("fd"), (value("3")));
+      FORENSICS_BREADCRUMB_DEBUG("read", ("bytes"), (value("512")));
+      FORENSICS_BREADCRUMB_TYPED_DEBUG("write", ("bytes"), (forensics_value_i64(evaluated++)));
+      FORENSICS_BREADCRUMB_INFO("connect", ("host", "port"), (value("localhost"), value("8080")));
+      FORENSICS_BREADCRUMB_TYPED_WARN("retry", ("attempt"), (forensics_value_i64(3)));
+      FORENSICS_BREADCRUMB_ERROR("failover");
+      CHECK(evaluated == 2);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the level can be changed at runtime") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "read"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "close"));
+    };
+    with_handler(handler, []() {
+      CHECK(forensics_get_breadcrumb_level() == FORENSICS_BREADCRUMB_LEVEL_INFO);
+      CHECK(!FORENSICS_BREADCRUMB_ENABLED(FORENSICS_BREADCRUMB_LEVEL_DEBUG));
+      forensics_set_breadcrumb_level(FORENSICS_BREADCRUMB_LEVEL_TRACE);
+      CHECK(FORENSICS_BREADCRUMB_ENABLED(FORENSICS_BREADCRUMB_LEVEL_DEBUG));
+
+      // trace breadcrumbs are compiled out of this file
+      FORENSICS_BREADCRUMB_TRACE("poll");
+      FORENSICS_BREADCRUMB_DEBUG("read");
+      forensics_set_breadcrumb_level(FORENSICS_BREADCRUMB_LEVEL_OFF);
+      FORENSICS_BREADCRUMB_ERROR("write");
+      forensics_add_breadcrumb("close", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+TEST_CASE("batch breadcrumbs") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 4;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("breadcrumbs are added in order and repeats are collapsed") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "accept"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "10.0.0.1"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "read"));
+      CHECK(report->breadcrumbs[1].count == 2);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "512"));
+      CHECK(report->breadcrumbs[1].meta_typed_values[0].as.i64 == 512);
+      CHECK(!strcmp(report->breadcrumbs[2].name, "close"));
+      CHECK(report->breadcrumbs[2].meta_count == 0);
+    };
+    with_handler(handler, []() {
+      const char* accept_keys[] = {"peer"};
+      const char* accept_values[] = {"10.0.0.1"};
+      const char* read_keys[] = {"bytes"};
+      const forensics_value_t read_values[] = {forensics_value_i64(512)};
+      const forensics_breadcrumb_entry_t breadcrumbs[] = {
+          {"accept", accept_keys, accept_values, nullptr, 1},
+          {"read", read_keys, nullptr, read_values, 1},
+          {"read", read_keys, nullptr, read_values, 1},
+          {"close", nullptr, nullptr, nullptr, 0},
+      };
+      forensics_add_breadcrumbs(breadcrumbs, 4);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs that would be pushed out by the rest of the batch are skipped") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "6"));
+      CHECK(!strcmp(report->breadcrumbs[3].meta_values[0], "9"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"index"};
+      const char* meta_values[] = {"0", "1", "2", "3", "4", "5", "6", "7", "8", "9"};
+      forensics_breadcrumb_entry_t breadcrumbs[10];
+      for (int index = 0; index < 10; ++index) {
+        breadcrumbs[index] = {"step", meta_keys, meta_values + index, nullptr, 1};
+      }
+      forensics_add_breadcrumbs(breadcrumbs, 10);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("repeats in a large batch are still counted") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "poll"));
+      CHECK(report->breadcrumbs[0].count == 10);
+      CHECK(!strcmp(report->breadcrumbs[2].name, "b"));
+      CHECK(report->breadcrumbs[2].loop_count == 5);
+    };
+    with_handler(handler, []() {
+      forensics_breadcrumb_entry_t breadcrumbs[20];
+      for (int index = 0; index < 10; ++index) {
+        breadcrumbs[index] = {"poll", nullptr, nullptr, nullptr, 0};
+        breadcrumbs[10 + index] = {(index & 1) ? "b" : "a", nullptr, nullptr, nullptr, 0};
+      }
+      forensics_add_breadcrumbs(breadcrumbs, 20);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("batches can go to a channel") {
+    forensics_lib_shutdown();
+    forensics_breadcrumb_channel_config_t channel;
+    channel.name = "net";
+    channel.max_breadcrumb_count = 64;
+    channel.breadcrumb_buf_size_bytes = 4096;
+    config.breadcrumb_channels = &channel;
+    config.breadcrumb_channel_count = 1;
+    forensics_lib_init(&config);
+
+    auto handler = [=](const forensics_report_t* report) {
+      // more than fit in a single lock
+      CHECK(report->breadcrumb_count == 40);
+      CHECK(!strcmp(report->breadcrumbs[0].channel, "net"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "0"));
+      CHECK(!strcmp(report->breadcrumbs[39].meta_values[0], "39"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"index"};
+      char meta_value_strs[40][4];
+      const char* meta_values[40];
+      forensics_breadcrumb_entry_t breadcrumbs[40];
+      for (int index = 0; index < 40; ++index) {
+        snprintf(meta_value_strs[index], sizeof(meta_value_strs[index]), "%d", index);
+        meta_values[index] = meta_value_strs[index];
+        breadcrumbs[index] = {"recv", meta_keys, meta_values + index, nullptr, 1};
+      }
+      forensics_add_channel_breadcrumbs(forensics_breadcrumb_channel("net"), breadcrumbs, 40);
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+// Collects the names of the breadcrumbs in a report's spans, in order.
+static std::string span_names(const forensics_report_t* report) {
+  std::string names;
+  for (int span_index = 0; span_index < report->breadcrumb_span_count; ++span_index) {
+    const forensics_breadcrumb_span_t* span = &report->breadcrumb_spans[span_index];
+    for (int index = 0; index < span->count; ++index) {
+      names += forensics_breadcrumb_span_at(span, index)->name;
+    }
+  }
+  return names;
+}
+
+TEST_CASE("breadcrumb spans") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 4;
+  config.max_breadcrumb_loop_length = 2;
+  config.flatten_report_breadcrumbs = false;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+
+  auto add_names = [](const char* names) {
+    for (const char* ptr = names; *ptr != 0; ++ptr) {
+      const char name[] = {*ptr, 0};
+      forensics_add_breadcrumb(name, nullptr, nullptr, 0);
+    }
+  };
+
+  SECTION("there are no breadcrumbs") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 0);
+      CHECK(report->breadcrumb_span_count == 0);
+      CHECK(report->breadcrumbs == nullptr);
+      CHECK(forensics_report_breadcrumbs(report) == nullptr);
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("a ring that hasn't wrapped is a single span") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(report->breadcrumbs == nullptr);
+      CHECK(report->breadcrumb_span_count == 1);
+      CHECK(span_names(report) == "abc");
+    };
+    with_handler(handler, [=]() {
+      add_names("abc");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("a ring that has wrapped is split in two and can still be flattened") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(report->breadcrumbs == nullptr);
+      CHECK(report->breadcrumb_span_count == 2);
+      CHECK(report->breadcrumb_spans[0].count == 2);
+      CHECK(report->breadcrumb_spans[1].count == 2);
+      CHECK(span_names(report) == "cdef");
+
+      const forensics_breadcrumb_t* breadcrumbs = forensics_report_breadcrumbs(report);
+      REQUIRE(breadcrumbs != nullptr);
+      CHECK(!strcmp(breadcrumbs[0].name, "c"));
+      CHECK(!strcmp(breadcrumbs[1].name, "d"));
+      CHECK(!strcmp(breadcrumbs[2].name, "e"));
+      CHECK(!strcmp(breadcrumbs[3].name, "f"));
+      CHECK(forensics_report_breadcrumbs(report) == breadcrumbs);
+    };
+    with_handler(handler, [=]() {
+      add_names("abcdef");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("a partial pass through a repeated block gets a span of its own") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(report->breadcrumb_span_count == 2);
+      CHECK(span_names(report) == "xaba");
+      const forensics_breadcrumb_t* end = forensics_breadcrumb_span_at(&report->breadcrumb_spans[0], 2);
+      CHECK(end->loop_length == 2);
+      CHECK(end->loop_count == 3);
+
+      const forensics_breadcrumb_t* breadcrumbs = forensics_report_breadcrumbs(report);
+      CHECK(!strcmp(breadcrumbs[2].name, "b"));
+      CHECK(breadcrumbs[2].loop_count == 3);
+      CHECK(!strcmp(breadcrumbs[3].name, "a"));
+      CHECK(breadcrumbs[3].loop_length == 0);
+    };
+    with_handler(handler, [=]() {
+      add_names("xababab");
+      add_names("a");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the oldest crumbs are clamped in a copy when their repeated block was pushed out") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      // the copy of "b", then the ring on either side of where it wraps
+      REQUIRE(report->breadcrumb_span_count == 3);
+      CHECK(report->breadcrumb_spans[0].count == 1);
+      CHECK(report->breadcrumb_spans[0].first->loop_length == 1);
+      CHECK(report->breadcrumb_spans[0].first->loop_count == 2);
+      CHECK(span_names(report) == "bcde");
+
+      const forensics_breadcrumb_t* breadcrumbs = forensics_report_breadcrumbs(report);
+      CHECK(!strcmp(breadcrumbs[0].name, "b"));
+      CHECK(breadcrumbs[0].loop_length == 1);
+      CHECK(!strcmp(breadcrumbs[3].name, "e"));
+    };
+    with_handler(handler, [=]() {
+      add_names("abab");
+      add_names("cde");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("typed values are formatted in a copy of the crumbs") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumb_span_count == 1);
+      CHECK(report->breadcrumb_spans[0].first == report->breadcrumbs);
+      CHECK(span_names(report) == "cdef");
+      CHECK(!strcmp(report->breadcrumbs[3].name, "f"));
+      CHECK(!strcmp(report->breadcrumbs[3].meta_values[0], "42"));
+    };
+    with_handler(handler, [=]() {
+      add_names("abcde");
+      const char* meta_keys[] = {"answer"};
+      const forensics_value_t meta_values[] = {forensics_value_i64(42)};
+      forensics_add_breadcrumb_typed("f", meta_keys, meta_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the array is built for every report if asked") {
+    config.flatten_report_breadcrumbs = true;
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumbs != nullptr);
+      CHECK(report->breadcrumb_span_count == 2);
+      CHECK(span_names(report) == "cdef");
+      CHECK(!strcmp(report->breadcrumbs[0].name, "c"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "f"));
+      CHECK(forensics_report_breadcrumbs(report) == report->breadcrumbs);
+    };
+    with_handler(handler, [=]() {
+      add_names("abcdef");
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs merged from several rings are a single span") {
+    config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_PER_THREAD;
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_span_count == 1);
+      CHECK(span_names(report) == "abc");
+      REQUIRE(report->breadcrumbs != nullptr);
+      CHECK(report->breadcrumb_spans[0].first == report->breadcrumbs);
+    };
+    with_handler(handler, [=]() {
+      add_names("abc");
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+TEST_CASE("breadcrumb archive") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 4;
+  config.breadcrumb_archive_size_bytes = 16 * 1024;
+  config.breadcrumb_archive_block_size_bytes = 256;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+
+  auto add_numbered = [](int first, int count) {
+    for (int index = first; index < first + count; ++index) {
+      const std::string name = "crumb-" + std::to_string(index);
+      const std::string value = std::to_string(index * 7);
+      const char* meta_keys[] = {"value"};
+      const char* meta_values[] = {value.c_str()};
+      forensics_add_breadcrumb(name.c_str(), meta_keys, meta_values, 1);
+    }
+  };
+
+  auto archived_names = [](const forensics_report_t* report) {
+    std::vector<std::string> names;
+    forensics_report_archived_breadcrumbs(
+        report,
+        [](const forensics_breadcrumb_t* breadcrumb, void* user_data) {
+          ((std::vector<std::string>*)user_data)->push_back(breadcrumb->name);
+        },
+        &names);
+    return names;
+  };
+
+  SECTION("there is no archive by default") {
+    config.breadcrumb_archive_size_bytes = 0;
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(report->archived_breadcrumb_count == 0);
+      CHECK(archived_names(report).empty());
+    };
+    with_handler(handler, [=]() {
+      add_numbered(0, 10);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs pushed out of the ring are archived in order") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "crumb-96"));
+      CHECK(report->archived_breadcrumb_count == 96);
+
+      struct visit_t {
+        int count;
+        uint64_t last_timestamp;
+      } visit = {0, 0};
+      const int visited = forensics_report_archived_breadcrumbs(
+          report,
+          [](const forensics_breadcrumb_t* breadcrumb, void* user_data) {
+            visit_t* visit = (visit_t*)user_data;
+            CHECK(breadcrumb->name == "crumb-" + std::to_string(visit->count));
+            REQUIRE(breadcrumb->meta_count == 1);
+            CHECK(!strcmp(breadcrumb->meta_keys[0], "value"));
+            CHECK(breadcrumb->meta_values[0] == std::to_string(visit->count * 7));
+            CHECK(breadcrumb->meta_typed_values == nullptr);
+            CHECK(breadcrumb->count == 1);
+            CHECK(breadcrumb->first_timestamp >= visit->last_timestamp);
+            visit->last_timestamp = breadcrumb->last_timestamp;
+            ++visit->count;
+          },
+          &visit);
+      CHECK(visited == 96);
+      CHECK(visit.count == 96);
+      CHECK(visit.last_timestamp <= report->breadcrumbs[0].first_timestamp);
+    };
+    with_handler(handler, [=]() {
+      add_numbered(0, 100);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the oldest blocks are dropped when the archive is full") {
+    config.breadcrumb_archive_size_bytes = 1024;
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      const std::vector<std::string> names = archived_names(report);
+      CHECK(report->archived_breadcrumb_count > 0);
+      CHECK(report->archived_breadcrumb_count < 996);
+      REQUIRE(names.size() == (size_t)report->archived_breadcrumb_count);
+      const int first = 996 - (int)names.size();
+      for (size_t index = 0; index < names.size(); ++index) {
+        CHECK(names[index] == "crumb-" + std::to_string(first + (int)index));
+      }
+    };
+    with_handler(handler, [=]() {
+      add_numbered(0, 1000);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("typed values, counts and blocks survive") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->archived_breadcrumb_count == 3);
+      struct visit_t {
+        int count;
+      } visit = {0};
+      forensics_report_archived_breadcrumbs(
+          report,
+          [](const forensics_breadcrumb_t* breadcrumb, void* user_data) {
+            visit_t* visit = (visit_t*)user_data;
+            if (visit->count == 0) {
+              CHECK(!strcmp(breadcrumb->name, "typed"));
+              CHECK(breadcrumb->count == 3);
+              REQUIRE(breadcrumb->meta_typed_values != nullptr);
+              CHECK(breadcrumb->meta_typed_values[0].type == FORENSICS_VALUE_INT64);
+              CHECK(breadcrumb->meta_typed_values[0].as.i64 == -42);
+              CHECK(!strcmp(breadcrumb->meta_values[0], "-42"));
+              CHECK(breadcrumb->meta_typed_values[1].type == FORENSICS_VALUE_STRING);
+              CHECK(!strcmp(breadcrumb->meta_typed_values[1].as.str, "text"));
+              CHECK(!strcmp(breadcrumb->meta_values[1], "text"));
+            }
+            else if (visit->count == 2) {
+              CHECK(!strcmp(breadcrumb->name, "b"));
+              CHECK(breadcrumb->loop_length == 2);
+              CHECK(breadcrumb->loop_count == 5);
+            }
+            ++visit->count;
+          },
+          &visit);
+      CHECK(visit.count == 3);
+    };
+    with_handler(handler, [=]() {
+      const char* meta_keys[] = {"number", "string"};
+      const forensics_value_t meta_values[] = {forensics_value_i64(-42), forensics_value_str("text")};
+      for (int index = 0; index < 3; ++index) {
+        forensics_add_breadcrumb_typed("typed", meta_keys, meta_values, 2);
+      }
+      for (int index = 0; index < 5; ++index) {
+        forensics_add_breadcrumb("a", nullptr, nullptr, 0);
+        forensics_add_breadcrumb("b", nullptr, nullptr, 0);
+      }
+      add_numbered(0, 4);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs that don't compress are archived too") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      const std::vector<std::string> names = archived_names(report);
+      REQUIRE(names.size() == 20);
+      for (int index = 0; index < 20; ++index) {
+        std::string expected;
+        for (int offset = 0; offset < 100; ++offset) {
+          expected += (char)('!' + (index * 131 + offset * offset * 7) % 90);
+        }
+        CHECK(names[index] == expected);
+      }
+    };
+    with_handler(handler, [=]() {
+      for (int index = 0; index < 24; ++index) {
+        std::string name;
+        for (int offset = 0; offset < 100; ++offset) {
+          name += (char)('!' + (index * 131 + offset * offset * 7) % 90);
+        }
+        forensics_add_breadcrumb(name.c_str(), nullptr, nullptr, 0);
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
+TEST_CASE("breadcrumb snapshots") {
+  forensics_breadcrumb_channel_config_t channels[1];
+  channels[0].name = "net";
+  channels[0].max_breadcrumb_count = 4;
+  channels[0].breadcrumb_buf_size_bytes = 256;
+
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 8;
+  config.max_breadcrumb_loop_length = 2;
+  config.breadcrumb_channels = channels;
+  config.breadcrumb_channel_count = 1;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+
+  SECTION("a snapshot holds the same breadcrumbs as a report") {
+    init_t init(&config);
+    const forensics_channel_t net = forensics_breadcrumb_channel("net");
+    const char* meta_keys[] = {"bytes"};
+    const forensics_value_t meta_values[] = {forensics_value_i64(42)};
+    forensics_add_breadcrumb("boot", nullptr, nullptr, 0);
+    forensics_add_channel_breadcrumb_typed(net, "read", meta_keys, meta_values, 1);
+    for (int index = 0; index < 3; ++index) {
+      forensics_add_breadcrumb("a", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("b", nullptr, nullptr, 0);
+    }
+    forensics_add_breadcrumb("a", nullptr, nullptr, 0);
+
+    std::vector<char> buf(forensics_breadcrumb_snapshot_size());
+    forensics_breadcrumb_snapshot_t snapshot;
+    REQUIRE(forensics_snapshot_breadcrumbs(buf.data(), buf.size(), &snapshot));
+    CHECK(snapshot.skipped_channel_count == 0);
+    REQUIRE(snapshot.breadcrumb_count == 5);
+    CHECK(!strcmp(snapshot.breadcrumbs[0].name, "boot"));
+    CHECK(!strcmp(snapshot.breadcrumbs[1].name, "read"));
+    CHECK(!strcmp(snapshot.breadcrumbs[1].channel, "net"));
+    CHECK(!strcmp(snapshot.breadcrumbs[1].meta_values[0], "42"));
+    CHECK(!strcmp(snapshot.breadcrumbs[3].name, "b"));
+    CHECK(snapshot.breadcrumbs[3].loop_length == 2);
+    CHECK(snapshot.breadcrumbs[3].loop_count == 3);
+    CHECK(!strcmp(snapshot.breadcrumbs[4].name, "a"));
+
+    auto handler = [&](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumb_count == snapshot.breadcrumb_count);
+      for (int index = 0; index < report->breadcrumb_count; ++index) {
+        CHECK(!strcmp(report->breadcrumbs[index].name, snapshot.breadcrumbs[index].name));
+        CHECK(report->breadcrumbs[index].count == snapshot.breadcrumbs[index].count);
+        CHECK(report->breadcrumbs[index].first_timestamp == snapshot.breadcrumbs[index].first_timestamp);
+      }
+    };
+    with_handler(handler, []() { FORENSICS_ASSERT(false); });
+  }
+
+  SECTION("a snapshot is a copy that later breadcrumbs don't change") {
+    init_t init(&config);
+    forensics_add_breadcrumb("before", nullptr, nullptr, 0);
+
+    std::vector<char> buf(forensics_breadcrumb_snapshot_size());
+    forensics_breadcrumb_snapshot_t snapshot;
+    REQUIRE(forensics_snapshot_breadcrumbs(buf.data(), buf.size(), &snapshot));
+    for (int index = 0; index < 20; ++index) {
+      forensics_add_breadcrumb("after", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("later", nullptr, nullptr, 0);
+    }
+    REQUIRE(snapshot.breadcrumb_count == 1);
+    CHECK(!strcmp(snapshot.breadcrumbs[0].name, "before"));
+  }
+
+  SECTION("snapshots taken while another thread writes are consistent") {
+    init_t init(&config);
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+      const forensics_channel_t net = forensics_breadcrumb_channel("net");
+      const char* meta_keys[] = {"n"};
+      for (int64_t index = 0; !done.load(); ++index) {
+        const forensics_value_t meta_values[] = {forensics_value_i64(index)};
+        forensics_add_breadcrumb_typed(index & 1 ? "odd" : "even", meta_keys, meta_values, 1);
+        forensics_add_channel_breadcrumb_typed(net, "poll", meta_keys, meta_values, 1);
+      }
+    });
+
+    std::vector<char> buf(forensics_breadcrumb_snapshot_size());
+    bool consistent = true;
+    for (int attempt = 0; attempt < 2000; ++attempt) {
+      forensics_breadcrumb_snapshot_t snapshot;
+      REQUIRE(forensics_snapshot_breadcrumbs(buf.data(), buf.size(), &snapshot));
+      long long last_even = -1;
+      for (int index = 0; index < snapshot.breadcrumb_count; ++index) {
+        const forensics_breadcrumb_t* crumb = &snapshot.breadcrumbs[index];
+        const long long value = atoll(crumb->meta_values[0]);
+        if (crumb->channel != nullptr) {
+          consistent = consistent && !strcmp(crumb->name, "poll");
+          continue;
+        }
+        // each crumb's name has to match its value, and the default channel's crumbs have to be in order
+        consistent = consistent && !strcmp(crumb->name, value & 1 ? "odd" : "even") && value > last_even;
+        last_even = value;
+      }
+    }
+    done.store(true);
+    writer.join();
+    CHECK(consistent);
+  }
+
+  SECTION("lock-free breadcrumbs can be snapshotted") {
+    config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_LOCK_FREE;
+    init_t init(&config);
+    forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+    forensics_add_channel_breadcrumb(forensics_breadcrumb_channel("net"), "two", nullptr, nullptr, 0);
+    forensics_add_breadcrumb("three", nullptr, nullptr, 0);
+
+    std::vector<char> buf(forensics_breadcrumb_snapshot_size());
+    forensics_breadcrumb_snapshot_t snapshot;
+    REQUIRE(forensics_snapshot_breadcrumbs(buf.data(), buf.size(), &snapshot));
+    REQUIRE(snapshot.breadcrumb_count == 3);
+    CHECK(!strcmp(snapshot.breadcrumbs[0].name, "one"));
+    CHECK(!strcmp(snapshot.breadcrumbs[1].name, "two"));
+    CHECK(!strcmp(snapshot.breadcrumbs[2].name, "three"));
+  }
+
+  SECTION("the buffer is too small") {
+    init_t init(&config);
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(!strcmp(report->format, "Breadcrumb snapshot buffer is too small: %zu < %zu"));
+    };
+    with_handler(handler, []() {
+      char buf[16];
+      forensics_breadcrumb_snapshot_t snapshot;
+      CHECK(!forensics_snapshot_breadcrumbs(buf, sizeof(buf), &snapshot));
+      CHECK(snapshot.breadcrumb_count == 0);
+    });
+  }
+}
+
+TEST_CASE("persistent store") {
+  const char* path = "forensics_spec_store.bin";
+  const char* killed_path = "forensics_spec_store_killed.bin";
+  remove(path);
+  remove(killed_path);
+
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.max_breadcrumb_count = 4;
+  config.max_breadcrumb_loop_length = 2;
+  config.persistent_store_path = path;
+  config.previous_run_handler = &test_previous_run_handler;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+
+  // copies the store while the library is still running, which is what the file looks like if the process is killed
+  auto read_file = [](const char* file_path) {
+    std::vector<char> data;
+    FILE* file = fopen(file_path, "rb");
+    REQUIRE(file != nullptr);
+    char chunk[4096];
+    for (size_t size; (size = fread(chunk, 1, sizeof(chunk), file)) > 0;) {
+      data.insert(data.end(), chunk, chunk + size);
+    }
+    fclose(file);
+    return data;
+  };
+  auto write_file = [](const char* file_path, const std::vector<char>& data) {
+    FILE* file = fopen(file_path, "wb");
+    REQUIRE(file != nullptr);
+    fwrite(data.data(), 1, data.size(), file);
+    fclose(file);
+  };
+
+  int previous_run_count = 0;
+  s_previous_run_handler = [&](const forensics_report_t*) { ++previous_run_count; };
+
+  SECTION("there is nothing to report on the first run") {
+    init_t init(&config);
+    CHECK(previous_run_count == 0);
+  }
+
+  SECTION("a run that was killed is reported on the next start") {
+    {
+      init_t init(&config);
+      forensics_set_attribute("build", "1234");
+      forensics_set_attribute("stage", "loading");
+      forensics_set_attribute("build", nullptr);
+      forensics_set_attribute("region", "eu-west-1");
+      forensics_add_breadcrumb("dropped", nullptr, nullptr, 0);
+      const char* meta_keys[] = {"bytes", "path"};
+      const forensics_value_t meta_values[] = {forensics_value_i64(42), forensics_value_str("/tmp")};
+      forensics_add_breadcrumb_typed("read", meta_keys, meta_values, 2);
+      forensics_add_breadcrumb_interned(forensics_intern_string("interned"), nullptr, nullptr, 0);
+      for (int pass = 0; pass < 3; ++pass) {
+        forensics_add_breadcrumb("a", nullptr, nullptr, 0);
+        forensics_add_breadcrumb("b", nullptr, nullptr, 0);
+      }
+      forensics_add_breadcrumb("a", nullptr, nullptr, 0);
+      write_file(killed_path, read_file(path));
+    }
+
+    s_previous_run_handler = [&](const forensics_report_t* report) {
+      ++previous_run_count;
+      CHECK(!strcmp(report->id, "previous-run"));
+      CHECK(report->fatal);
+      REQUIRE(report->attribute_count == 2);
+      CHECK(has_attribute_value(report, "stage", "loading"));
+      CHECK(has_attribute_value(report, "region", "eu-west-1"));
+
+      REQUIRE(report->breadcrumb_count == 5);
+      CHECK(report->breadcrumb_span_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "read"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "42"));
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[1], "/tmp"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "<interned>"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "b"));
+      CHECK(report->breadcrumbs[3].loop_length == 2);
+      CHECK(report->breadcrumbs[3].loop_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[4].name, "a"));
+      CHECK(report->timestamp == report->breadcrumbs[4].last_timestamp);
+    };
+    config.persistent_store_path = killed_path;
+    init_t init(&config);
+    CHECK(previous_run_count == 1);
+
+    // the file starts over for this run
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "fresh"));
+      CHECK(report->attribute_count == 0);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("fresh", nullptr, nullptr, 0);
       FORENSICS_ASSERT(false);
     });
   }
+
+  SECTION("a run that shut down isn't reported") {
+    {
+      init_t init(&config);
+      forensics_add_breadcrumb("clean", nullptr, nullptr, 0);
+    }
+    init_t init(&config);
+    CHECK(previous_run_count == 0);
+  }
+
+  SECTION("the file can be read with a different config") {
+    {
+      init_t init(&config);
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("two", nullptr, nullptr, 0);
+      write_file(killed_path, read_file(path));
+    }
+
+    s_previous_run_handler = [&](const forensics_report_t* report) {
+      ++previous_run_count;
+      REQUIRE(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "two"));
+    };
+    config.persistent_store_path = killed_path;
+    config.max_breadcrumb_count = 64;
+    config.breadcrumb_buf_size_bytes = 64 * 1024;
+    config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_PER_THREAD;
+    init_t init(&config);
+    CHECK(previous_run_count == 1);
+  }
+
+  SECTION("damaged breadcrumbs are left out") {
+    {
+      init_t init(&config);
+      forensics_add_breadcrumb("kept", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("damaged", nullptr, nullptr, 0);
+      std::vector<char> data = read_file(path);
+      const char damaged[] = "damaged";
+      auto found = std::search(data.begin(), data.end(), damaged, damaged + sizeof(damaged));
+      REQUIRE(found != data.end());
+      found[sizeof(damaged) - 1] = 'X';
+      write_file(killed_path, data);
+    }
+
+    s_previous_run_handler = [&](const forensics_report_t* report) {
+      ++previous_run_count;
+      REQUIRE(report->breadcrumb_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "kept"));
+    };
+    config.persistent_store_path = killed_path;
+    init_t init(&config);
+    CHECK(previous_run_count == 1);
+  }
+
+  SECTION("a file that isn't a store is ignored") {
+    write_file(path, std::vector<char>(4096, 'x'));
+    init_t init(&config);
+    CHECK(previous_run_count == 0);
+  }
+
+  s_previous_run_handler = nullptr;
+  remove(path);
+  remove(killed_path);
 }
 
 TEST_CASE("breadcrumb count overflow") {
@@ -518,6 +2699,231 @@ TEST_CASE("breadcrumb buf overflow for exact size of ring buffer") {
   }
 }
 
+TEST_CASE("per-thread breadcrumbs") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_PER_THREAD;
+  config.max_breadcrumb_count = 3;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("breadcrumbs from a single thread are kept in order") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "one"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "two"));
+      CHECK(report->breadcrumbs[1].count == 2);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("two", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("two", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs from many threads are merged by time, keeping the newest") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "worker-b"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "worker-a"));
+      CHECK(!strcmp(report->breadcrumbs[2].name, "main"));
+    };
+    with_handler(handler, []() {
+      // keep the workers alive until the report is done since their rings go away when they exit
+      std::mutex mutex;
+      std::condition_variable cond;
+      int step = 0;
+      bool done = false;
+      auto worker = [&](int my_step, const char* first, const char* second) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return step == my_step; });
+        forensics_add_breadcrumb(first, nullptr, nullptr, 0);
+        if (second) {
+          forensics_add_breadcrumb(second, nullptr, nullptr, 0);
+        }
+        ++step;
+        cond.notify_all();
+        cond.wait(lock, [&]() { return done; });
+      };
+      std::thread thread_a(worker, 0, "worker-a-old", nullptr);
+      std::thread thread_b(worker, 1, "worker-a-ignored", "worker-b");
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return step == 2; });
+      }
+      std::thread thread_a2(worker, 2, "worker-a", nullptr);
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&]() { return step == 3; });
+      }
+      forensics_add_breadcrumb("main", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        done = true;
+        cond.notify_all();
+      }
+      thread_a.join();
+      thread_b.join();
+      thread_a2.join();
+    });
+  }
+
+  SECTION("a new thread's breadcrumbs don't wait on the report handler") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      std::thread thread([]() { forensics_add_breadcrumb("during", nullptr, nullptr, 0); });
+      thread.join();
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("before", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the report handler can leave breadcrumbs on a thread without a ring") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 0);
+      forensics_add_breadcrumb("during", nullptr, nullptr, 0);
+    };
+    with_handler(handler, []() {
+      std::thread thread([]() { FORENSICS_ASSERT(false); });
+      thread.join();
+    });
+  }
+}
+
+TEST_CASE("lock-free breadcrumbs") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_LOCK_FREE;
+  config.max_breadcrumb_count = 4;
+  config.breadcrumb_slot_size_bytes = 64;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("breadcrumbs are kept in order and repeats are collapsed") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "one"));
+      CHECK(report->breadcrumbs[0].count == 2);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "two"));
+      CHECK(report->breadcrumbs[1].meta_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_keys[0], "env"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "production"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"env"};
+      const char* meta_values[] = {"production"};
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("two", meta_keys, meta_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("max breadcrumbs is reached, forget oldest crumb") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "two"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "five"));
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("two", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("three", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("four", nullptr, nullptr, 0);
+      forensics_add_breadcrumb("five", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs too big for a slot are truncated") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "big"));
+      CHECK(report->breadcrumbs[0].meta_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "short"));
+      CHECK(strlen(report->breadcrumbs[1].name) == 63);
+      CHECK(report->breadcrumbs[1].meta_count == 0);
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"a", "b"};
+      const char* meta_values[] = {"short", "this value is far too long to fit in a 64 byte slot"};
+      forensics_add_breadcrumb("big", meta_keys, meta_values, 2);
+      forensics_add_breadcrumb("a name that is far too long to fit in a 64 byte slot, even on its own", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the slot size doesn't depend on the breadcrumb buffer size") {
+    forensics_lib_shutdown();
+    config.breadcrumb_slot_size_bytes = 256;
+    config.breadcrumb_buf_size_bytes = 0;
+    forensics_lib_init(&config);
+
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumb_count == 1);
+      CHECK(report->breadcrumbs[0].meta_count == 3);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[2], "this value is far too long to fit in a 64 byte slot"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"a", "b", "c"};
+      const char* meta_values[] = {"short", "short", "this value is far too long to fit in a 64 byte slot"};
+      forensics_add_breadcrumb("big", meta_keys, meta_values, 3);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("typed values survive being copied out of their slot") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].meta_values[0], "7"));
+      CHECK(report->breadcrumbs[1].meta_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "up"));
+      CHECK(!strcmp(report->breadcrumbs[1].meta_typed_values[0].as.str, "up"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"n", "dir"};
+      const forensics_value_t meta_values[] = {forensics_value_i64(7), forensics_value_str("up")};
+      forensics_add_breadcrumb_typed("move", meta_keys, meta_values, 1);
+      forensics_add_breadcrumb_typed("move", meta_keys + 1, meta_values + 1, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("many threads can leave breadcrumbs at once") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 4);
+      for (int index = 0; index < report->breadcrumb_count; ++index) {
+        CHECK(!strcmp(report->breadcrumbs[index].name, "after"));
+      }
+    };
+    with_handler(handler, []() {
+      std::thread threads[4];
+      for (std::thread& thread : threads) {
+        thread = std::thread([]() {
+          for (int index = 0; index < 1000; ++index) {
+            forensics_add_breadcrumb((index & 1) ? "odd" : "even", nullptr, nullptr, 0);
+          }
+        });
+      }
+      for (std::thread& thread : threads) {
+        thread.join();
+      }
+      const char* meta_keys[] = {"n"};
+      const char* meta_values[4] = {"0", "1", "2", "3"};
+      for (int index = 0; index < 4; ++index) {
+        forensics_add_breadcrumb("after", meta_keys, meta_values + index, 1);
+      }
+      FORENSICS_ASSERT(false);
+    });
+  }
+}
+
 void test_signal_handler(int sig, const char* signal_name, std::function<void()> func) {
   char expected_message[64];
   snprintf(expected_message, sizeof(expected_message), "got signal: %s", signal_name);
@@ -534,6 +2940,94 @@ void test_signal_handler(int sig, const char* signal_name, std::function<void()>
   });
 }
 
+TEST_CASE("per-CPU breadcrumbs") {
+  forensics_config_t config;
+  forensics_config_init(&config);
+  config.breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_PER_CPU;
+  config.max_breadcrumb_count = 8;
+  config.report_handler = &test_report_handler;
+  config.fatal_should_halt = false;
+  init_t init(&config);
+
+  SECTION("breadcrumbs from a single thread are kept in order") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 2);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "one"));
+      CHECK(report->breadcrumbs[0].channel == nullptr);
+      CHECK(!strcmp(report->breadcrumbs[1].name, "two"));
+      CHECK(report->breadcrumbs[1].count == 2);
+      CHECK(!strcmp(report->breadcrumbs[1].meta_values[0], "3"));
+    };
+    with_handler(handler, []() {
+      const char* meta_keys[] = {"n"};
+      const forensics_value_t meta_values[] = {forensics_value_i64(3)};
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      forensics_add_breadcrumb_typed("two", meta_keys, meta_values, 1);
+      forensics_add_breadcrumb_typed("two", meta_keys, meta_values, 1);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs from many threads are merged by time") {
+    auto handler = [=](const forensics_report_t* report) {
+      REQUIRE(report->breadcrumb_count == 4);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "worker-0"));
+      CHECK(!strcmp(report->breadcrumbs[1].name, "worker-1"));
+      CHECK(!strcmp(report->breadcrumbs[2].name, "worker-2"));
+      CHECK(!strcmp(report->breadcrumbs[3].name, "main"));
+      for (int index = 1; index < report->breadcrumb_count; ++index) {
+        CHECK(report->breadcrumbs[index].first_timestamp >= report->breadcrumbs[index - 1].first_timestamp);
+      }
+    };
+    with_handler(handler, []() {
+      // the threads run one after the other, but wherever the scheduler puts them
+      const char* names[] = {"worker-0", "worker-1", "worker-2"};
+      for (const char* name : names) {
+        std::thread thread([=]() { forensics_add_breadcrumb(name, nullptr, nullptr, 0); });
+        thread.join();
+      }
+      forensics_add_breadcrumb("main", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("breadcrumbs outlive the threads that left them") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      CHECK(!strcmp(report->breadcrumbs[0].name, "exited"));
+    };
+    with_handler(handler, []() {
+      std::thread thread([]() { forensics_add_breadcrumb("exited", nullptr, nullptr, 0); });
+      thread.join();
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("the report handler can leave breadcrumbs") {
+    auto handler = [=](const forensics_report_t* report) {
+      CHECK(report->breadcrumb_count == 1);
+      forensics_add_breadcrumb("reported", nullptr, nullptr, 0);
+    };
+    with_handler(handler, []() {
+      forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+      FORENSICS_ASSERT(false);
+    });
+  }
+
+  SECTION("per-CPU breadcrumbs can be snapshotted") {
+    forensics_add_breadcrumb("one", nullptr, nullptr, 0);
+    forensics_add_breadcrumb("two", nullptr, nullptr, 0);
+
+    std::vector<char> buf(forensics_breadcrumb_snapshot_size());
+    forensics_breadcrumb_snapshot_t snapshot;
+    REQUIRE(forensics_snapshot_breadcrumbs(buf.data(), buf.size(), &snapshot));
+    CHECK(snapshot.skipped_channel_count == 0);
+    REQUIRE(snapshot.breadcrumb_count == 2);
+    CHECK(!strcmp(snapshot.breadcrumbs[0].name, "one"));
+    CHECK(!strcmp(snapshot.breadcrumbs[1].name, "two"));
+  }
+}
+
 #ifdef __APPLE__
 TEST_CASE("signals") {
   forensics_config_t config;
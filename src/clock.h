@@ -0,0 +1,6 @@
+#pragma once
+#include <stdint.h>
+
+// Reads a monotonic clock in nanoseconds. This is called for every breadcrumb so it must be cheap (i.e. it shouldn't
+// enter the kernel).
+uint64_t forensics_private_clock_ns();
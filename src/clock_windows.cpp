@@ -0,0 +1,18 @@
+#include <windows.h>
+#include "clock.h"
+
+static uint64_t query_frequency() {
+  LARGE_INTEGER frequency;
+  QueryPerformanceFrequency(&frequency);
+  return (uint64_t)frequency.QuadPart;
+}
+
+uint64_t forensics_private_clock_ns() {
+  static const uint64_t s_frequency = query_frequency();
+
+  // split the conversion so the multiply doesn't overflow
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  const uint64_t ticks = (uint64_t)counter.QuadPart;
+  return (ticks / s_frequency) * 1000000000ull + (ticks % s_frequency) * 1000000000ull / s_frequency;
+}
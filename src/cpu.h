@@ -0,0 +1,10 @@
+#pragma once
+
+// Returns the number of CPUs the system has, which bounds what `forensics_private_current_cpu()` returns on most
+// systems. Returns 1 where the current CPU can't be found cheaply.
+unsigned int forensics_private_cpu_count();
+
+// Returns the CPU the calling thread is running on. The thread may be moved to another CPU as soon as this returns, so
+// the result is only a hint. This is called for every breadcrumb in `FORENSICS_BREADCRUMB_MODE_PER_CPU` so it must be
+// cheap (i.e. it shouldn't enter the kernel).
+unsigned int forensics_private_current_cpu();
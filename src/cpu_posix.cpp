@@ -0,0 +1,48 @@
+#include "cpu.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#if defined(__has_include)
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#endif
+#endif
+#endif
+
+// glibc 2.35 and later register a restartable sequences area for every thread, which the kernel keeps up to date with
+// the thread's current CPU
+#if defined(RSEQ_SIG) && defined(__has_builtin)
+#if __has_builtin(__builtin_thread_pointer)
+#define FORENSICS_RSEQ 1
+#endif
+#endif
+
+unsigned int forensics_private_cpu_count() {
+#ifdef __linux__
+  const long count = sysconf(_SC_NPROCESSORS_CONF);
+  return count > 0 ? (unsigned int)count : 1;
+#else
+  // there's no cheap way to find the current CPU on macOS, so everything shares one ring
+  return 1;
+#endif
+}
+
+unsigned int forensics_private_current_cpu() {
+#ifdef FORENSICS_RSEQ
+  if (__rseq_size > 0) {
+    const struct rseq* area = (const struct rseq*)((char*)__builtin_thread_pointer() + __rseq_offset);
+    const int cpu = (int)__atomic_load_n(&area->cpu_id, __ATOMIC_RELAXED);
+    if (cpu >= 0) {
+      return (unsigned int)cpu;
+    }
+  }
+#endif
+#ifdef __linux__
+  // served by the vDSO (or the rseq area) without a syscall
+  const int cpu = sched_getcpu();
+  return cpu >= 0 ? (unsigned int)cpu : 0;
+#else
+  return 0;
+#endif
+}
@@ -0,0 +1,14 @@
+#include <windows.h>
+#include "cpu.h"
+
+unsigned int forensics_private_cpu_count() {
+  const DWORD count = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+  return count > 0 ? (unsigned int)count : 1;
+}
+
+unsigned int forensics_private_current_cpu() {
+  // processor groups hold up to 64 processors each
+  PROCESSOR_NUMBER number;
+  GetCurrentProcessorNumberEx(&number);
+  return (unsigned int)number.Group * 64 + number.Number;
+}
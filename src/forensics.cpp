@@ -1,204 +1,3183 @@
+#include <atomic>
+#include <cfloat>
+#include <cinttypes>
 #include <cstdarg>
+#include <cstdio>
+#include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <mutex>
+#include <new>
 #include <thread>
 #include "forensics.h"
 #include "backtrace.h"
+#include "clock.h"
+#include "cpu.h"
+#include "lz.h"
+#include "mapped_file.h"
 #include "signals.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Strings are scanned 16 bytes at a time with SSE2 where it is available. The scan reads whole aligned blocks, so it
+// can read past the end of a string (never across a page boundary or into another allocation's block), which is fine
+// for the hardware but not for AddressSanitizer or ThreadSanitizer, so the portable scan is used there instead.
+#if defined(__SANITIZE_ADDRESS__) || defined(__SANITIZE_THREAD__)
+#define FORENSICS_SANITIZER 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer) || __has_feature(thread_sanitizer)
+#define FORENSICS_SANITIZER 1
+#endif
+#endif
+#if (defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__)) && !defined(FORENSICS_SANITIZER)
+#define FORENSICS_SSE2_STRINGS 1
+#include <emmintrin.h>
+#endif
+
 #define DEFAULT_MAX_CONTEXT_DEPTH 128
 #define DEFAULT_MAX_FORMATTED_MESSAGE_SIZE_BYTES (1 * 1024)
 #define DEFAULT_MAX_ATTRIBUTE_COUNT 128
 #define DEFAULT_ATTRIBUTE_BUF_SIZE_BYTES (4 * 1024)
+#define DEFAULT_MAX_REGISTERED_ATTRIBUTE_COUNT 32
+#define DEFAULT_MAX_NUMERIC_ATTRIBUTE_COUNT 32
+#define DEFAULT_MAX_ATTRIBUTE_PROVIDER_COUNT 8
+#define DEFAULT_ATTRIBUTE_PROVIDER_VALUE_SIZE_BYTES 64
+#define DEFAULT_MAX_THREAD_ATTRIBUTE_COUNT 16
+#define DEFAULT_THREAD_ATTRIBUTE_BUF_SIZE_BYTES 1024
 #define DEFAULT_MAX_BACKTRACE_COUNT 256
 #define DEFAULT_MAX_ID_SIZE_BYTES 512
 #define DEFAULT_MAX_BREADCRUMB_COUNT 128
 #define DEFAULT_BREADCRUMB_BUF_SIZE_BYTES (4 * 1024)
+#define DEFAULT_BREADCRUMB_SLOT_SIZE_BYTES 256
+#define DEFAULT_MAX_INTERNED_STRING_COUNT 256
+#define DEFAULT_INTERNED_STRING_BUF_SIZE_BYTES (4 * 1024)
+#define DEFAULT_MAX_BREADCRUMB_LOOP_LENGTH 8
+#define DEFAULT_BREADCRUMB_ARCHIVE_BLOCK_SIZE_BYTES (4 * 1024)
+
+// Pushed on the context stack in place of a name that couldn't be copied.
+#define CONTEXT_NAME_UNKNOWN "<unknown>"
+
+// How many times the reporter polls a per-thread ring that is in the middle of a write before giving up on it.
+#define THREAD_RING_WRITE_SPIN_LIMIT 100000
+
+// Breadcrumb data starts with pointer arrays and may hold typed values, so it is kept aligned for both.
+#define BREADCRUMB_ALIGNMENT alignof(forensics_value_t)
+
+// Parameters for hashing breadcrumbs a word at a time.
+#define HASH_SEED 0xcbf29ce484222325ull
+#define HASH_MULTIPLIER 0x9e3779b97f4a7c15ull
+
+// Strings are hashed in chunks of this many bytes, counted from the start of the string. With SSE2 a chunk is put
+// together from the aligned blocks it overlaps.
+#define HASH_CHUNK_SIZE_BYTES 16
+
+// The most space a typed breadcrumb value other than a string needs once it is formatted.
+#define FORMATTED_VALUE_SIZE_BYTES 32
+
+// How many times a lock-free slot is polled while another thread owns it before giving up on it.
+#define BREADCRUMB_SLOT_SPIN_LIMIT 1000
+
+// A lock-free slot's state is `(ticket + 1) << BREADCRUMB_SLOT_TICKET_SHIFT | revision << 1 | owned` for the crumb in
+// it. The revision goes up each time the crumb is changed in place, so a reader part way through copying the slot sees
+// that it changed. It wraps, but only after more repeats than a reader could miss while copying a single slot.
+#define BREADCRUMB_SLOT_TICKET_SHIFT 16
+#define BREADCRUMB_SLOT_REVISION_MASK 0xfffe
+#define BREADCRUMB_SLOT_OWNED 1
+
+// Attribute strings live in blocks whose sizes are multiples of this. Freed blocks go on a list for their size so
+// setting and clearing an attribute never has to move the others around.
+#define ATTRIBUTE_BLOCK_MIN_SIZE_BYTES 16u
+#define ATTRIBUTE_BLOCK_CLASS_COUNT 28
+#define ATTRIBUTE_BLOCK_NONE UINT32_MAX
+
+// The attribute hash table is kept at most half full so probes stay short.
+#define ATTRIBUTE_EMPTY_SLOT -1
+
+// Published attribute lists: the current one, an older one a report may still be reading, and one to fill in next.
+#define ATTRIBUTE_VERSION_COUNT 3
+
+// How many times `forensics_snapshot_breadcrumbs()` tries to copy a ring while writers keep changing it before it leaves
+// the ring out.
+#define SNAPSHOT_RETRY_LIMIT 100
+
+// Per-CPU rings are kept this far apart so that writers on different CPUs don't share cache lines.
+#define CACHE_LINE_SIZE_BYTES 64
+
+// Identifies a persistent store file and the version of its layout.
+#define STORE_MAGIC "FRNSTORE"
+#define STORE_VERSION 3
+
+// Every part of a snapshot buffer starts on a multiple of this.
+#define SNAPSHOT_ALIGNMENT 16
+
+// The most breadcrumbs from a `forensics_add_breadcrumbs()` batch that are measured up front and stored under a single
+// lock. Larger batches are split up.
+#define BREADCRUMB_BATCH_SIZE 32
+
+// The sizes of the strings in a breadcrumb are recorded when it is measured so they don't have to be scanned again when
+// it is copied. This is how many metadata pairs have room for that; strings past them are measured a second time.
+#define BREADCRUMB_MEASURED_META_COUNT 16
+#define BREADCRUMB_MEASURED_STRING_COUNT (1 + 2 * BREADCRUMB_MEASURED_META_COUNT)
+
+struct context_buffer_t {
+  ~context_buffer_t();
+
+  bool initialized;
+  forensics_context_stack_t* stack; // the thread's `forensics_private_context_stack`, so shutdown can reset it
+
+  // the thread's attributes are a stack too, with their strings packed in order so ending one just gives back the end
+  // of the buffer
+  int attribute_count;
+  int attribute_overflow_count;
+  char** attribute_keys;
+  char** attribute_values;
+  char* attribute_buf;
+  unsigned int attribute_buf_used;
+
+  context_buffer_t* prev;
+  context_buffer_t* next;
+};
+struct breadcrumb_t {
+  forensics_breadcrumb_t crumb;
+  unsigned int buf_offset;
+  unsigned int buf_size;
+  uint64_t hash; // hash of the name and metadata, used to quickly rule out repeats
+
+  // When the crumb was left in the pass through the repeating block that is under way, if it is part of one. They are
+  // only written to `crumb` once the pass is complete, since the pass may break off instead.
+  uint64_t pass_first_timestamp;
+  uint64_t pass_last_timestamp;
+};
+// A breadcrumb as it was given to one of the add functions, before it is copied into storage.
+struct breadcrumb_desc_t {
+  const char* name;
+  const char** meta_keys;                     // NULL when the keys are given as handles
+  const forensics_string_t* meta_key_handles; // NULL when the keys are given as strings
+  const char** meta_values;                 // NULL when the values are typed
+  const forensics_value_t* meta_typed_values; // NULL when the values are strings
+  int meta_count;
+  forensics_string_t name_handle; // set if the name is interned, in which case it is stored by pointer
+  forensics_channel_t channel;
+
+  // filled in by `breadcrumb_measure()`
+  unsigned int size; // space needed in a breadcrumb buffer
+  uint64_t hash;     // hash of the name and metadata
+  unsigned int string_sizes[BREADCRUMB_MEASURED_STRING_COUNT]; // name, then key and value of each pair, see above
+
+  uint64_t timestamp; // when the breadcrumb was left, filled in by `breadcrumb_add()`
+};
+// The most metadata pairs an archived breadcrumb keeps. Pairs past these are dropped when it is archived.
+#define BREADCRUMB_ARCHIVE_MAX_META_COUNT 32
+
+// The second tier of breadcrumb history. Crumbs pushed out of a ring are packed into a block, which is compressed into a
+// ring of compressed blocks once it fills up.
+struct breadcrumb_archive_t {
+  char* block;                   // crumbs packed since the last block was compressed
+  unsigned int block_size_bytes; // size of `block`
+  unsigned int block_used;
+  unsigned int block_crumb_count;
+
+  char* buf;                    // compressed blocks, each starting with a `breadcrumb_archive_block_t`
+  unsigned int buf_size_bytes;  // size of `buf`
+  unsigned int buf_read_index;  // start of the oldest block
+  unsigned int buf_write_index; // end of the newest block
+  unsigned int buf_wrap_index;  // end of the blocks before the write head wrapped around to the start (if it has)
+  bool buf_wrapped;
+  unsigned int buf_block_count;
+  unsigned int buf_crumb_count;
+
+  // scratch space for compressing a block, and for unpacking one when a report asks for it
+  char* scratch;
+  forensics_lz_table_t lz_table;
+  const char* meta_keys[BREADCRUMB_ARCHIVE_MAX_META_COUNT];
+  const char* meta_values[BREADCRUMB_ARCHIVE_MAX_META_COUNT];
+  forensics_value_t meta_typed_values[BREADCRUMB_ARCHIVE_MAX_META_COUNT];
+  char formatted_values[BREADCRUMB_ARCHIVE_MAX_META_COUNT][FORMATTED_VALUE_SIZE_BYTES];
+};
+struct breadcrumb_archive_block_t {
+  uint32_t stored_size; // compressed size of the block that follows
+  uint32_t raw_size;
+  uint32_t crumb_count;
+};
+// The fixed part of a packed crumb. It is followed by the name, then the key and value of each metadata pair. Typed
+// values are packed as their type followed by the string or the raw 8 bytes of the value.
+struct breadcrumb_archive_record_t {
+  uint64_t first_timestamp;
+  uint64_t last_timestamp;
+  int32_t count;
+  int32_t loop_length;
+  int32_t loop_count;
+  uint16_t meta_count;
+  uint8_t typed;
+};
+struct breadcrumb_ring_t {
+  unsigned int capacity;        // max number of crumbs
+  unsigned int buf_size_bytes;  // size of `buf`
+  breadcrumb_t* breadcrumbs;
+  unsigned int index_next;
+  unsigned int count;
+  char* buf;
+  unsigned int buf_read_index;  // start of the oldest crumb's data
+  unsigned int buf_write_index; // end of the newest crumb's data
+  unsigned int buf_used;        // total size of all the crumbs' data
+
+  // A block made of the newest `loop_length` crumbs is being repeated. Incoming crumbs that follow the block are only
+  // counted; they are written out as crumbs of their own if the repetition breaks off part way through the block.
+  unsigned int loop_length;
+  unsigned int loop_progress;  // number of crumbs in the block matched so far
+  unsigned int loop_repeat;    // number of repetitions matched so far of the crumb at `loop_progress`
+
+  breadcrumb_archive_t* archive; // where crumbs pushed out of the ring go, if anywhere
+};
+struct thread_breadcrumb_ring_t {
+  ~thread_breadcrumb_ring_t();
+
+  breadcrumb_ring_t ring;
+  std::atomic<unsigned int> sequence; // odd while the owning thread is writing to the ring
+  bool initialized;
+  bool report_skip;                   // set by the reporter if the ring could not be read safely
+  unsigned int report_cursor;         // number of crumbs not yet merged into the report
+
+  thread_breadcrumb_ring_t* next;
+};
+struct breadcrumb_channel_t {
+  const char* name;
+  std::mutex mutex;
+  breadcrumb_ring_t ring;
+  std::atomic<unsigned int> sequence; // odd while the ring is being changed, see `breadcrumb_sequence_begin()`
+};
+// The ring for one CPU in `FORENSICS_BREADCRUMB_MODE_PER_CPU`. The lock is only contended when a thread is moved to
+// another CPU part way through leaving a crumb. Reports copy the ring without taking it.
+struct alignas(CACHE_LINE_SIZE_BYTES) cpu_breadcrumb_ring_t {
+  std::mutex mutex;
+  breadcrumb_ring_t ring;
+  std::atomic<unsigned int> sequence; // odd while the ring is being changed, see `breadcrumb_sequence_begin()`
+};
+enum attribute_block_state_t : uint32_t {
+  ATTRIBUTE_BLOCK_FREE = 0,
+  ATTRIBUTE_BLOCK_LIVE = 1,
+  ATTRIBUTE_BLOCK_UNSET = 2,   // a registered attribute that has no value right now
+  ATTRIBUTE_BLOCK_RETIRED = 3, // replaced or cleared, but an older attribute list may still point at it
+};
+// The header of a block of attribute data, which is followed by the key and value strings. A free block holds the offset
+// of the next free block of its size instead. The headers let a later run walk the buffer in a persistent store.
+struct attribute_block_t {
+  uint32_t size_bytes; // including this header
+  uint32_t state;      // an `attribute_block_state_t`
+};
+// Why an attribute couldn't be set. The caller asserts once it has let go of `s_attribute_mutex`, since a report
+// handler may set attributes itself.
+enum attribute_error_t {
+  ATTRIBUTE_ERROR_NONE,
+  ATTRIBUTE_ERROR_COUNT_FULL, // no room for another key
+  ATTRIBUTE_ERROR_BUF_FULL,   // no block big enough
+};
+// An immutable list of the attributes set with `forensics_set_attribute()`. Writers fill in a spare one and publish it,
+// so reports can read the attributes without taking the lock writers use.
+struct attribute_version_t {
+  uint64_t generation; // counts up with each list published
+  int count;
+  char** keys;
+  char** values;
+};
+// A block that was replaced or cleared. It was in the lists published from generation `birth` up to (but not
+// including) `retire` and can be reused once a report can't be reading any of those.
+struct attribute_retired_t {
+  uint32_t offset;
+  uint64_t birth;
+  uint64_t retire;
+};
+// An attribute set up with `forensics_numeric_attribute_register()`. The value is the raw bits of an int64_t or a
+// double, depending on `type`.
+struct numeric_attribute_t {
+  const char* key; // interned
+  forensics_value_type_t type;
+  std::atomic<uint64_t> bits;
+};
+// An attribute filled in by a callback while a report is built.
+struct attribute_provider_t {
+  const char* key; // interned
+  forensics_attribute_provider_t provider;
+  void* user_data;
+};
+// An attribute set up with `forensics_attribute_register()`. It keeps its block for good.
+struct registered_attribute_t {
+  attribute_block_t* block;
+  char* value;                        // follows the key in the block
+  unsigned int value_size_bytes;      // the room for the value, including null terminator
+  std::atomic<unsigned int> sequence; // odd while the value is being written
+};
+
+// The state of the run that owns a persistent store, kept in its header.
+enum store_state_t : uint32_t {
+  STORE_STATE_RUNNING = 1,   // the run may still be going, or it ended without a chance to report
+  STORE_STATE_REPORTED = 2,  // the run ended with a fatal report
+  STORE_STATE_SHUT_DOWN = 3, // the run called `forensics_lib_shutdown()`
+};
+// The start of a persistent store file. The rest of the file is located by the offsets here, so a later run can read it
+// whatever config it has itself. The global ring and the attribute count live here so that they are in the file too.
+struct persistent_store_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size_bytes;     // sizeof(persistent_store_t), which covers the layout of `breadcrumbs`
+  uint32_t breadcrumb_size_bytes; // sizeof(breadcrumb_t), which covers the layout of the crumbs
+  uint32_t pointer_size_bytes;
+  uint64_t size_bytes;            // of the whole file
+  uint64_t address;               // where the file was mapped, to re-point the crumbs' pointers when it is read back
+  std::atomic<uint32_t> state;    // a `store_state_t`
+
+  breadcrumb_ring_t breadcrumbs;
+  std::atomic<unsigned int> breadcrumbs_sequence;
+  uint32_t breadcrumbs_offset;    // the ring's crumbs
+  uint32_t breadcrumb_buf_offset; // the ring's data
+
+  uint32_t attribute_buf_offset;
+  uint32_t attribute_buf_size_bytes;
+  uint32_t attribute_buf_used;
+  uint32_t attribute_count; // the buffer is a run of blocks up to `attribute_buf_used`, and this many are live
+};
+struct breadcrumb_slot_t {
+  std::atomic<uint64_t> state; // see `BREADCRUMB_SLOT_TICKET_SHIFT`
+  breadcrumb_t breadcrumb;
+};
+
+static forensics_config_t s_config;
+int forensics_private_breadcrumb_level;
+FORENSICS_THREAD_LOCAL forensics_context_stack_t forensics_private_context_stack;
+thread_local static context_buffer_t s_tls_context_buf;
+static context_buffer_t* s_context_buf_list;
+static std::mutex s_context_buf_list_mutex;
+
+static breadcrumb_ring_t* s_breadcrumbs;                  // either `s_breadcrumbs_storage` or in the persistent store
+static std::atomic<unsigned int>* s_breadcrumbs_sequence; // odd while `s_breadcrumbs` is being changed
+static breadcrumb_ring_t s_breadcrumbs_storage;
+static std::atomic<unsigned int> s_breadcrumbs_sequence_storage;
+thread_local static thread_breadcrumb_ring_t s_tls_breadcrumb_ring;
+static std::atomic<thread_breadcrumb_ring_t*> s_breadcrumb_ring_list; // pushed onto freely, unlinked under the mutex
+static std::mutex s_breadcrumb_ring_list_mutex;
+static std::atomic<bool> s_breadcrumb_report_active;
+static thread_breadcrumb_ring_t* s_report_ring_list; // the head of the list when the report paused the rings
+static breadcrumb_slot_t* s_breadcrumb_slots;
+static char* s_breadcrumb_slots_buf;
+static unsigned int s_breadcrumb_slot_size;
+static std::atomic<uint64_t> s_breadcrumb_slots_head;
+static breadcrumb_channel_t* s_breadcrumb_channels;
+static unsigned int s_breadcrumb_channel_count;
+static char* s_breadcrumb_channel_names_buf;
+
+// persistent store
+static persistent_store_t* s_store; // null unless `persistent_store_path` is set and the file could be mapped
+static size_t s_store_size_bytes;
+static char* s_store_previous_run;  // the file left by the previous run, until it is reported
+static size_t s_store_previous_run_size_bytes;
+
+// per-CPU breadcrumbs
+static void* s_cpu_rings_alloc; // the allocation `s_cpu_rings` is aligned within
+static cpu_breadcrumb_ring_t* s_cpu_rings;
+static unsigned int s_cpu_ring_count;
+
+static const char** s_interned_strings;
+static uint64_t* s_interned_string_hashes;
+static std::atomic<unsigned int> s_interned_string_count;
+static char* s_interned_string_buf;
+static unsigned int s_interned_string_buf_used;
+static std::atomic<forensics_string_t>* s_interned_string_table; // open addressing with linear probing, 0 is empty
+static unsigned int s_interned_string_table_mask;
+static std::mutex s_interned_string_mutex; // taken to add strings, finding them doesn't need it
+
+static std::mutex s_attribute_mutex; // taken by writers, reports read the published lists
+static char** s_attribute_keys;      // the live attributes are kept packed at the front so they can be published as is
+static char** s_attribute_values;
+static uint64_t* s_attribute_hashes;
+static uint64_t* s_attribute_births; // the generation each attribute's block was first published in
+static int s_attribute_count;
+static int* s_attribute_table; // open addressing with linear probing, holds indices into the arrays above
+static unsigned int s_attribute_table_mask;
+static char* s_attribute_buf;
+static int s_attribute_buf_used; // blocks are carved off the front, this is how far they reach
+static uint32_t s_attribute_free_blocks[ATTRIBUTE_BLOCK_CLASS_COUNT];
+static attribute_retired_t* s_attribute_retired;
+static unsigned int s_attribute_retired_count;
+static attribute_version_t s_attribute_versions[ATTRIBUTE_VERSION_COUNT];
+static std::atomic<attribute_version_t*> s_attribute_version;        // the latest published list
+static std::atomic<attribute_version_t*> s_attribute_version_pinned; // the list a report is reading, if any
+static registered_attribute_t* s_registered_attributes;
+static std::atomic<unsigned int> s_registered_attribute_count;
+static numeric_attribute_t* s_numeric_attributes;
+static std::atomic<unsigned int> s_numeric_attribute_count;
+static attribute_provider_t* s_attribute_providers; // guarded by `s_report_mutex`, since only reports call them
+static unsigned int s_attribute_provider_count;
+
+static void** s_backtrace_buf;
+
+static std::mutex s_report_mutex;
+static char* s_report_id;
+static char* s_report_formatted_msg;
+static forensics_breadcrumb_t* s_report_breadcrumbs;
+static unsigned int s_report_breadcrumb_capacity; // the most crumbs a report (or snapshot) can hold
+static char* s_report_breadcrumbs_buf;
+static char* s_report_ring_storage; // where the per-CPU rings and the channels are copied for a report
+static char* s_report_breadcrumb_values_buf;
+static unsigned int s_report_breadcrumb_values_buf_size;
+static bool s_report_breadcrumbs_flat; // set once the current report's crumbs have been copied into `s_report_breadcrumbs`
+static char** s_report_attribute_keys; // every kind of attribute gathered up for the current report
+static char** s_report_attribute_values;
+static forensics_value_t* s_report_attribute_typed_values;
+static char* s_report_attribute_values_buf;   // copies of registered attribute values
+static char* s_report_attribute_provider_buf; // the values written by the attribute providers
+static char* s_report_numeric_values_buf;     // the formatted values of the numeric attributes
+
+static void panic() {
+  exit(EXIT_FAILURE);
+}
+
+static void* default_alloc(uintptr_t size, void* user_data, const char* file, int line, const char* func) {
+  return malloc(size);
+}
+
+static void default_free(void* memory, void* user_data, const char* file, int line, const char* func) {
+  free(memory);
+}
+
+#define forensics_alloc(size) forensics_alloc_ex(size, __FILE__, __LINE__, __func__)
+#define forensics_free(ptr) forensics_free_ex(ptr, __FILE__, __LINE__, __func__)
+
+static void* forensics_alloc_ex(uintptr_t size, const char* file, int line, const char* func) {
+  return s_config.alloc(size, s_config.alloc_user_data, file, line, func);
+}
+
+static void forensics_free_ex(void* memory, const char* file, int line, const char* func) {
+  s_config.free(memory, s_config.alloc_user_data, file, line, func);
+}
+
+static bool interned_string_is_valid(forensics_string_t handle) {
+  return handle != FORENSICS_STRING_INVALID && handle <= s_interned_string_count.load(std::memory_order_acquire);
+}
+
+// Sets up a ring in storage that is owned by someone else.
+static void breadcrumb_ring_init_in(breadcrumb_ring_t* ring,
+                                    unsigned int capacity,
+                                    breadcrumb_t* breadcrumbs,
+                                    unsigned int buf_size_bytes,
+                                    char* buf) {
+  ring->capacity = capacity;
+  ring->buf_size_bytes = buf_size_bytes;
+  ring->breadcrumbs = breadcrumbs;
+  ring->buf = buf;
+  ring->count = 0;
+  ring->index_next = 0;
+  ring->buf_read_index = 0;
+  ring->buf_write_index = 0;
+  ring->buf_used = 0;
+  ring->loop_length = 0;
+  ring->loop_progress = 0;
+  ring->loop_repeat = 0;
+  ring->archive = nullptr;
+}
+
+static void breadcrumb_ring_init(breadcrumb_ring_t* ring, unsigned int capacity, unsigned int buf_size_bytes) {
+  breadcrumb_ring_init_in(ring,
+                          capacity,
+                          (breadcrumb_t*)forensics_alloc(capacity * sizeof(breadcrumb_t)),
+                          buf_size_bytes,
+                          (char*)forensics_alloc(buf_size_bytes));
+}
+
+static void breadcrumb_ring_destroy(breadcrumb_ring_t* ring) {
+  forensics_free(ring->buf);
+  forensics_free(ring->breadcrumbs);
+  ring->buf = nullptr;
+  ring->breadcrumbs = nullptr;
+  ring->capacity = 0;
+  ring->buf_size_bytes = 0;
+  ring->count = 0;
+  ring->index_next = 0;
+  ring->buf_read_index = 0;
+  ring->buf_write_index = 0;
+  ring->buf_used = 0;
+  ring->loop_length = 0;
+  ring->loop_progress = 0;
+  ring->loop_repeat = 0;
+  ring->archive = nullptr;
+}
+
+// Returns the breadcrumb `age` entries back from the newest one (0 is the newest).
+static breadcrumb_t* breadcrumb_ring_newest(breadcrumb_ring_t* ring, unsigned int age) {
+  const unsigned int index =
+      (ring->index_next + ring->capacity - 1 - age) % ring->capacity;
+  return ring->breadcrumbs + index;
+}
+
+static char* breadcrumb_buf_alloc(breadcrumb_ring_t* ring, unsigned int size_bytes) {
+  // start over at the beginning of the buffer whenever it is empty
+  if (ring->buf_used == 0) {
+    ring->buf_read_index = 0;
+    ring->buf_write_index = 0;
+  }
+
+  unsigned int write_index = ring->buf_write_index;
+  const unsigned int read_index = ring->buf_read_index;
+
+  if ((write_index < read_index) || (write_index == read_index && ring->buf_used > 0)) {
+    // the write head has wrapped around; check if it will pass the read head
+    if (write_index + size_bytes > read_index) {
+      return nullptr;
+    }
+  }
+  else if (write_index + size_bytes > ring->buf_size_bytes) {
+    // wrap around, checking if the write head will pass the read head
+    if (size_bytes > read_index) {
+      return nullptr;
+    }
+    write_index = 0;
+  }
+
+  ring->buf_write_index = write_index + size_bytes;
+  ring->buf_used += size_bytes;
+  return ring->buf + write_index;
+}
+
+static breadcrumb_archive_t* breadcrumb_archive_create(unsigned int buf_size_bytes, unsigned int block_size_bytes) {
+  breadcrumb_archive_t* archive = (breadcrumb_archive_t*)forensics_alloc(sizeof(breadcrumb_archive_t));
+  archive->block = (char*)forensics_alloc(block_size_bytes);
+  archive->block_size_bytes = block_size_bytes;
+  archive->block_used = 0;
+  archive->block_crumb_count = 0;
+  archive->buf = (char*)forensics_alloc(buf_size_bytes);
+  archive->buf_size_bytes = buf_size_bytes;
+  archive->buf_read_index = 0;
+  archive->buf_write_index = 0;
+  archive->buf_wrap_index = 0;
+  archive->buf_wrapped = false;
+  archive->buf_block_count = 0;
+  archive->buf_crumb_count = 0;
+  archive->scratch = (char*)forensics_alloc(forensics_private_lz_bound(block_size_bytes));
+  forensics_private_lz_table_init(&archive->lz_table);
+  return archive;
+}
+
+static void breadcrumb_archive_destroy(breadcrumb_archive_t* archive) {
+  forensics_free(archive->scratch);
+  forensics_free(archive->buf);
+  forensics_free(archive->block);
+  forensics_free(archive);
+}
+
+static unsigned int breadcrumb_archive_count(const breadcrumb_archive_t* archive) {
+  return archive->buf_crumb_count + archive->block_crumb_count;
+}
+
+static breadcrumb_archive_block_t breadcrumb_archive_block_at(const breadcrumb_archive_t* archive, unsigned int offset) {
+  breadcrumb_archive_block_t block;
+  memcpy(&block, archive->buf + offset, sizeof(block));
+  return block;
+}
+
+// Drops the oldest compressed block.
+static void breadcrumb_archive_pop(breadcrumb_archive_t* archive) {
+  const breadcrumb_archive_block_t block = breadcrumb_archive_block_at(archive, archive->buf_read_index);
+  archive->buf_read_index += (unsigned int)sizeof(block) + block.stored_size;
+  --archive->buf_block_count;
+  archive->buf_crumb_count -= block.crumb_count;
+  if (archive->buf_wrapped && archive->buf_read_index == archive->buf_wrap_index) {
+    archive->buf_read_index = 0;
+    archive->buf_wrapped = false;
+  }
+}
+
+// Makes room for a compressed block of `size_bytes` (including its header), dropping the oldest blocks as needed.
+// Blocks are never split across the end of the buffer.
+static char* breadcrumb_archive_alloc(breadcrumb_archive_t* archive, unsigned int size_bytes) {
+  if (size_bytes > archive->buf_size_bytes) {
+    return nullptr;
+  }
+  for (;;) {
+    if (archive->buf_block_count == 0) {
+      archive->buf_read_index = 0;
+      archive->buf_write_index = 0;
+      archive->buf_wrapped = false;
+    }
+    if (!archive->buf_wrapped) {
+      if (archive->buf_write_index + size_bytes <= archive->buf_size_bytes) {
+        break;
+      }
+      if (size_bytes <= archive->buf_read_index) {
+        archive->buf_wrap_index = archive->buf_write_index;
+        archive->buf_wrapped = true;
+        archive->buf_write_index = 0;
+        break;
+      }
+    }
+    else if (archive->buf_write_index + size_bytes <= archive->buf_read_index) {
+      break;
+    }
+    breadcrumb_archive_pop(archive);
+  }
+
+  char* alloc = archive->buf + archive->buf_write_index;
+  archive->buf_write_index += size_bytes;
+  return alloc;
+}
+
+// Compresses the block of packed crumbs into the archive.
+static void breadcrumb_archive_flush(breadcrumb_archive_t* archive) {
+  if (archive->block_crumb_count == 0) {
+    return;
+  }
+
+  breadcrumb_archive_block_t block;
+  block.raw_size = archive->block_used;
+  block.crumb_count = archive->block_crumb_count;
+  block.stored_size = forensics_private_lz_compress(archive->block,
+                                                    archive->block_used,
+                                                    archive->scratch,
+                                                    forensics_private_lz_bound(archive->block_size_bytes),
+                                                    &archive->lz_table);
+  archive->block_used = 0;
+  archive->block_crumb_count = 0;
+
+  char* alloc = breadcrumb_archive_alloc(archive, (unsigned int)sizeof(block) + block.stored_size);
+  if (alloc == nullptr) {
+    return;
+  }
+  memcpy(alloc, &block, sizeof(block));
+  memcpy(alloc + sizeof(block), archive->scratch, block.stored_size);
+  ++archive->buf_block_count;
+  archive->buf_crumb_count += block.crumb_count;
+}
+
+static char* breadcrumb_archive_pack_string(char* ptr, const char* str, unsigned int size_bytes) {
+  memcpy(ptr, str, size_bytes);
+  return ptr + size_bytes;
+}
+
+// Packs a crumb that is being pushed out of a ring into the archive's current block. Crumbs too big for a block are
+// dropped.
+static void breadcrumb_archive_add(breadcrumb_archive_t* archive, const forensics_breadcrumb_t* crumb) {
+  const bool typed = crumb->meta_typed_values != nullptr;
+  const int meta_count =
+      crumb->meta_count < BREADCRUMB_ARCHIVE_MAX_META_COUNT ? crumb->meta_count : BREADCRUMB_ARCHIVE_MAX_META_COUNT;
+
+  // Crumbs with string values that weren't interned have all their strings back to back in the ring buffer, in the
+  // same order they are packed in, right after the key and value arrays. Those are packed with a single copy.
+  const char* strings_end = nullptr;
+  if (!typed && meta_count > 0 && meta_count == crumb->meta_count &&
+      crumb->name == (const char*)(crumb->meta_values + meta_count)) {
+    const char* last = crumb->meta_values[meta_count - 1];
+    strings_end = last + strlen(last) + 1;
+  }
+
+  // measure
+  const unsigned int name_size_bytes = strings_end != nullptr ? 0 : (unsigned int)strlen(crumb->name) + 1;
+  unsigned int size_bytes = (unsigned int)sizeof(breadcrumb_archive_record_t) + name_size_bytes;
+  if (strings_end != nullptr) {
+    size_bytes += (unsigned int)(strings_end - crumb->name);
+  }
+  for (int index = 0; strings_end == nullptr && index < meta_count; ++index) {
+    size_bytes += (unsigned int)strlen(crumb->meta_keys[index]) + 1;
+    if (!typed) {
+      size_bytes += (unsigned int)strlen(crumb->meta_values[index]) + 1;
+    }
+    else if (crumb->meta_typed_values[index].type == FORENSICS_VALUE_STRING) {
+      size_bytes += 1 + (unsigned int)strlen(crumb->meta_typed_values[index].as.str) + 1;
+    }
+    else {
+      size_bytes += 1 + (unsigned int)sizeof(uint64_t);
+    }
+  }
+  if (size_bytes > archive->block_size_bytes) {
+    return;
+  }
+  if (archive->block_used + size_bytes > archive->block_size_bytes) {
+    breadcrumb_archive_flush(archive);
+  }
+
+  // pack
+  breadcrumb_archive_record_t record;
+  memset(&record, 0, sizeof(record));
+  record.first_timestamp = crumb->first_timestamp;
+  record.last_timestamp = crumb->last_timestamp;
+  record.count = crumb->count;
+  record.loop_length = crumb->loop_length;
+  record.loop_count = crumb->loop_count;
+  record.meta_count = (uint16_t)meta_count;
+  record.typed = typed ? 1 : 0;
+
+  char* ptr = archive->block + archive->block_used;
+  memcpy(ptr, &record, sizeof(record));
+  ptr += sizeof(record);
+  if (strings_end != nullptr) {
+    memcpy(ptr, crumb->name, strings_end - crumb->name);
+  }
+  else {
+    ptr = breadcrumb_archive_pack_string(ptr, crumb->name, name_size_bytes);
+  }
+  for (int index = 0; strings_end == nullptr && index < meta_count; ++index) {
+    const char* key = crumb->meta_keys[index];
+    ptr = breadcrumb_archive_pack_string(ptr, key, (unsigned int)strlen(key) + 1);
+    if (!typed) {
+      const char* value = crumb->meta_values[index];
+      ptr = breadcrumb_archive_pack_string(ptr, value, (unsigned int)strlen(value) + 1);
+      continue;
+    }
+    const forensics_value_t* value = &crumb->meta_typed_values[index];
+    *ptr++ = (char)value->type;
+    if (value->type == FORENSICS_VALUE_STRING) {
+      ptr = breadcrumb_archive_pack_string(ptr, value->as.str, (unsigned int)strlen(value->as.str) + 1);
+    }
+    else {
+      memcpy(ptr, &value->as, sizeof(uint64_t));
+      ptr += sizeof(uint64_t);
+    }
+  }
+  archive->block_used += size_bytes;
+  ++archive->block_crumb_count;
+}
+
+// Unpacks the crumbs in a block and passes each one to the visitor. Returns the number of crumbs visited.
+static int breadcrumb_archive_visit_block(breadcrumb_archive_t* archive,
+                                          const char* data,
+                                          unsigned int size_bytes,
+                                          forensics_breadcrumb_visitor_t visitor,
+                                          void* user_data) {
+  int visited = 0;
+  const char* ptr = data;
+  const char* end = data + size_bytes;
+  while (ptr + sizeof(breadcrumb_archive_record_t) <= end) {
+    breadcrumb_archive_record_t record;
+    memcpy(&record, ptr, sizeof(record));
+    ptr += sizeof(record);
+
+    forensics_breadcrumb_t crumb;
+    crumb.name = ptr;
+    ptr += strlen(ptr) + 1;
+    for (int index = 0; index < record.meta_count; ++index) {
+      archive->meta_keys[index] = ptr;
+      ptr += strlen(ptr) + 1;
+      if (!record.typed) {
+        archive->meta_values[index] = ptr;
+        ptr += strlen(ptr) + 1;
+        continue;
+      }
+      forensics_value_t* value = &archive->meta_typed_values[index];
+      value->type = (forensics_value_type_t)(uint8_t)*ptr++;
+      if (value->type == FORENSICS_VALUE_STRING) {
+        value->as.str = ptr;
+        archive->meta_values[index] = ptr;
+        ptr += strlen(ptr) + 1;
+      }
+      else {
+        memcpy(&value->as, ptr, sizeof(uint64_t));
+        ptr += sizeof(uint64_t);
+        forensics_value_format(value, archive->formatted_values[index], FORMATTED_VALUE_SIZE_BYTES);
+        archive->meta_values[index] = archive->formatted_values[index];
+      }
+    }
+    crumb.meta_keys = record.meta_count > 0 ? archive->meta_keys : nullptr;
+    crumb.meta_values = record.meta_count > 0 ? archive->meta_values : nullptr;
+    crumb.meta_typed_values = record.meta_count > 0 && record.typed ? archive->meta_typed_values : nullptr;
+    crumb.meta_count = record.meta_count;
+    crumb.count = record.count;
+    crumb.loop_length = record.loop_length;
+    crumb.loop_count = record.loop_count;
+    crumb.first_timestamp = record.first_timestamp;
+    crumb.last_timestamp = record.last_timestamp;
+    crumb.channel = nullptr;
+    visitor(&crumb, user_data);
+    ++visited;
+  }
+  return visited;
+}
+
+// Decompresses the archive one block at a time, oldest first, and passes each crumb to the visitor.
+static int breadcrumb_archive_visit(breadcrumb_archive_t* archive, forensics_breadcrumb_visitor_t visitor, void* user_data) {
+  int visited = 0;
+  unsigned int offset = archive->buf_read_index;
+  for (unsigned int index = 0; index < archive->buf_block_count; ++index) {
+    if (archive->buf_wrapped && offset == archive->buf_wrap_index) {
+      offset = 0;
+    }
+    const breadcrumb_archive_block_t block = breadcrumb_archive_block_at(archive, offset);
+    const int raw_size = forensics_private_lz_decompress(
+        archive->buf + offset + sizeof(block), block.stored_size, archive->scratch, archive->block_size_bytes);
+    offset += (unsigned int)sizeof(block) + block.stored_size;
+    if (raw_size != (int)block.raw_size) {
+      continue;
+    }
+    visited += breadcrumb_archive_visit_block(archive, archive->scratch, block.raw_size, visitor, user_data);
+  }
+  visited += breadcrumb_archive_visit_block(archive, archive->block, archive->block_used, visitor, user_data);
+  return visited;
+}
+
+static void breadcrumb_deque(breadcrumb_ring_t* ring) {
+  breadcrumb_t* breadcrumb = breadcrumb_ring_newest(ring, ring->count - 1);
+
+  // keep a compressed copy
+  if (ring->archive != nullptr) {
+    breadcrumb_archive_add(ring->archive, &breadcrumb->crumb);
+  }
+
+  // free the ring buffer space
+  ring->buf_used -= breadcrumb->buf_size;
+
+  // clear out the breadcrumb struct
+  breadcrumb->crumb.name = nullptr;
+  breadcrumb->crumb.meta_keys = nullptr;
+  breadcrumb->crumb.meta_values = nullptr;
+  breadcrumb->crumb.meta_typed_values = nullptr;
+  breadcrumb->crumb.meta_count = 0;
+  breadcrumb->crumb.count = 0;
+  breadcrumb->crumb.loop_length = 0;
+  breadcrumb->crumb.loop_count = 0;
+  breadcrumb->buf_offset = 0;
+  breadcrumb->buf_size = 0;
+  breadcrumb->crumb.first_timestamp = 0;
+  breadcrumb->crumb.last_timestamp = 0;
+  breadcrumb->hash = 0;
+
+  // forget about the breadcrumb
+  --ring->count;
+  if (ring->count > 0) {
+    ring->buf_read_index = breadcrumb_ring_newest(ring, ring->count - 1)->buf_offset;
+  }
+  else {
+    ring->buf_read_index = ring->buf_write_index;
+  }
+}
+
+static const char* breadcrumb_desc_key(const breadcrumb_desc_t* desc, int index) {
+  if (desc->meta_key_handles != nullptr) {
+    return s_interned_strings[desc->meta_key_handles[index] - 1];
+  }
+  return desc->meta_keys[index];
+}
+
+static bool breadcrumb_string_equals(const char* a, const char* b) {
+  return a == b || 0 == strcmp(a, b);
+}
+
+static bool breadcrumb_value_equals(const forensics_value_t* a, const forensics_value_t* b) {
+  if (a->type != b->type) {
+    return false;
+  }
+  switch (a->type) {
+    case FORENSICS_VALUE_STRING:
+      return breadcrumb_string_equals(a->as.str, b->as.str);
+    case FORENSICS_VALUE_INT64:
+      return a->as.i64 == b->as.i64;
+    case FORENSICS_VALUE_UINT64:
+      return a->as.u64 == b->as.u64;
+    case FORENSICS_VALUE_DOUBLE:
+      return 0 == memcmp(&a->as.f64, &b->as.f64, sizeof(double));
+    case FORENSICS_VALUE_POINTER:
+      return a->as.ptr == b->as.ptr;
+    case FORENSICS_VALUE_BOOL:
+      return a->as.b == b->as.b;
+  }
+  return false;
+}
+
+static bool breadcrumb_equals(const forensics_breadcrumb_t* crumb, const breadcrumb_desc_t* desc) {
+  if (crumb->meta_count != desc->meta_count) {
+    return false;
+  }
+  if ((crumb->meta_typed_values != nullptr) != (desc->meta_typed_values != nullptr)) {
+    return false;
+  }
+  if (!breadcrumb_string_equals(crumb->name, desc->name)) {
+    return false;
+  }
+  for (int index = 0; index < desc->meta_count; ++index) {
+    if (!breadcrumb_string_equals(crumb->meta_keys[index], breadcrumb_desc_key(desc, index))) {
+      return false;
+    }
+    if (desc->meta_typed_values != nullptr) {
+      if (!breadcrumb_value_equals(&crumb->meta_typed_values[index], &desc->meta_typed_values[index])) {
+        return false;
+      }
+    }
+    else if (!breadcrumb_string_equals(crumb->meta_values[index], desc->meta_values[index])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Looks up the size (including the null terminator) of one of a measured breadcrumb's strings. `string_index` is 0 for
+// the name, then `1 + 2 * index` for each key and `2 + 2 * index` for each value.
+static unsigned int breadcrumb_string_size(const breadcrumb_desc_t* desc, int string_index, const char* str) {
+  if (string_index < BREADCRUMB_MEASURED_STRING_COUNT) {
+    return desc->string_sizes[string_index];
+  }
+  return (unsigned int)strlen(str) + 1;
+}
+
+// Computes the space needed to store a breadcrumb's name in a breadcrumb buffer. Interned names take no space.
+static unsigned int breadcrumb_name_size(const breadcrumb_desc_t* desc) {
+  return desc->name_handle != FORENSICS_STRING_INVALID ? 0 : breadcrumb_string_size(desc, 0, desc->name);
+}
+
+// Computes the space needed to store one of a breadcrumb's metadata pairs in a breadcrumb buffer. Interned keys are
+// stored by pointer and only take up their slot in the key array. Typed values are stored raw; only strings are copied.
+static unsigned int breadcrumb_meta_size(const breadcrumb_desc_t* desc, int index) {
+  unsigned int size = sizeof(char**) * 2;
+  if (desc->meta_key_handles == nullptr) {
+    size += breadcrumb_string_size(desc, 1 + 2 * index, desc->meta_keys[index]);
+  }
+  if (desc->meta_typed_values != nullptr) {
+    size += sizeof(forensics_value_t);
+    if (desc->meta_typed_values[index].type == FORENSICS_VALUE_STRING) {
+      size += breadcrumb_string_size(desc, 2 + 2 * index, desc->meta_typed_values[index].as.str);
+    }
+  }
+  else {
+    size += breadcrumb_string_size(desc, 2 + 2 * index, desc->meta_values[index]);
+  }
+  return size;
+}
+
+static unsigned int breadcrumb_align_size(unsigned int size) {
+  return (size + BREADCRUMB_ALIGNMENT - 1) & ~(unsigned int)(BREADCRUMB_ALIGNMENT - 1);
+}
+
+static uint64_t hash_combine(uint64_t hash, uint64_t value) {
+  hash = (hash ^ value) * HASH_MULTIPLIER;
+  return hash ^ (hash >> 32);
+}
+
+#ifdef FORENSICS_SSE2_STRINGS
+static unsigned int count_trailing_zeros(unsigned int value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, value);
+  return (unsigned int)index;
+#else
+  return (unsigned int)__builtin_ctz(value);
+#endif
+}
+#endif
+
+#ifdef FORENSICS_SSE2_STRINGS
+// Copies the bytes of `str` up to its null terminator or the end of the chunk into `words`, zeroing the rest, using
+// only aligned loads. Returns how many were copied. The block after the one `str` starts in is only read if the string
+// runs into it.
+static unsigned int hash_string_chunk_sse2(const char* str, uint64_t* words) {
+  const unsigned int offset = (unsigned int)((uintptr_t)str & (HASH_CHUNK_SIZE_BYTES - 1));
+  const __m128i* block = (const __m128i*)(str - offset);
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i head = _mm_load_si128(block);
+  // the bytes before `str` are shifted out of the mask
+  unsigned int zero_mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(head, zero)) >> offset;
+  if (offset == 0) {
+    _mm_storeu_si128((__m128i*)words, head);
+  }
+  else {
+    // the chunk is shifted out of the two blocks a word at a time, which keeps clear of an unaligned reload
+    alignas(16) uint64_t blocks[4];
+    _mm_store_si128((__m128i*)blocks, head);
+    if (zero_mask == 0) {
+      const __m128i tail = _mm_load_si128(block + 1);
+      _mm_store_si128((__m128i*)(blocks + 2), tail);
+      zero_mask = ((unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(tail, zero)) << (HASH_CHUNK_SIZE_BYTES - offset)) &
+                  0xffff;
+    }
+    else {
+      _mm_store_si128((__m128i*)(blocks + 2), zero);
+    }
+    const unsigned int word = offset / sizeof(uint64_t);
+    const unsigned int shift = (offset % sizeof(uint64_t)) * 8;
+    if (shift == 0) {
+      words[0] = blocks[word];
+      words[1] = blocks[word + 1];
+    }
+    else {
+      words[0] = (blocks[word] >> shift) | (blocks[word + 1] << (64 - shift));
+      words[1] = (blocks[word + 1] >> shift) | (blocks[word + 2] << (64 - shift));
+    }
+  }
+  if (zero_mask == 0) {
+    return HASH_CHUNK_SIZE_BYTES;
+  }
+
+  // x86 is little endian so the bytes past the terminator are the high bits of their word
+  const unsigned int size = count_trailing_zeros(zero_mask);
+  if (size < sizeof(uint64_t)) {
+    words[0] &= ((uint64_t)1 << (size * 8)) - 1;
+    words[1] = 0;
+  }
+  else {
+    words[1] &= ((uint64_t)1 << ((size - sizeof(uint64_t)) * 8)) - 1;
+  }
+  return size;
+}
+#else
+// Copies the bytes of `str` up to its null terminator or the end of the chunk into `chunk`, one at a time. Returns how
+// many were copied. The rest of the chunk is left alone.
+static unsigned int hash_string_chunk_portable(const char* str, char* chunk) {
+  unsigned int size = 0;
+  while (size < HASH_CHUNK_SIZE_BYTES && str[size] != 0) {
+    chunk[size] = str[size];
+    ++size;
+  }
+  return size;
+}
+#endif
+
+// Hashes a string, measuring its size (including the null terminator) along the way. The string is consumed in chunks
+// that are mixed in as two words, with the bytes past the terminator in the last chunk zeroed, so the hash doesn't
+// depend on how the chunk was read.
+static uint64_t hash_string(const char* str, unsigned int* out_size_bytes) {
+  uint64_t hash = HASH_SEED;
+  const char* ptr = str;
+  for (;;) {
+    uint64_t words[HASH_CHUNK_SIZE_BYTES / sizeof(uint64_t)] = {0, 0};
+#ifdef FORENSICS_SSE2_STRINGS
+    const unsigned int chunk_size = hash_string_chunk_sse2(ptr, words);
+#else
+    const unsigned int chunk_size = hash_string_chunk_portable(ptr, (char*)words);
+#endif
+
+    // the second word is scrambled off of the dependency chain so each chunk only waits on one multiply
+    hash = hash_combine(hash, words[0] ^ (words[1] * HASH_MULTIPLIER));
+    ptr += chunk_size;
+    if (chunk_size < HASH_CHUNK_SIZE_BYTES) {
+      break;
+    }
+  }
+  *out_size_bytes = (unsigned int)(ptr - str) + 1;
+  return hash_combine(hash, *out_size_bytes);
+}
+
+static attribute_block_t* attribute_block(uint32_t offset) {
+  return (attribute_block_t*)(s_attribute_buf + offset);
+}
+
+static uint32_t* attribute_block_next_free(attribute_block_t* block) {
+  return (uint32_t*)(block + 1);
+}
+
+// Picks the free list for a block: list n holds the blocks from `ATTRIBUTE_BLOCK_MIN_SIZE_BYTES << n` bytes up to twice
+// that.
+static unsigned int attribute_block_class(unsigned int size_bytes) {
+  unsigned int block_class = 0;
+  while (block_class + 1 < ATTRIBUTE_BLOCK_CLASS_COUNT &&
+         (ATTRIBUTE_BLOCK_MIN_SIZE_BYTES << (block_class + 1)) <= size_bytes) {
+    ++block_class;
+  }
+  return block_class;
+}
+
+static void attribute_block_free(attribute_block_t* block) {
+  // marked first so a persistent store never shows a free block as live
+  block->state = ATTRIBUTE_BLOCK_FREE;
+  const unsigned int block_class = attribute_block_class(block->size_bytes);
+  *attribute_block_next_free(block) = s_attribute_free_blocks[block_class];
+  s_attribute_free_blocks[block_class] = (uint32_t)((char*)block - s_attribute_buf);
+}
+
+// Takes the first block on the free list at `block_class` that holds at least `size_bytes`.
+static attribute_block_t* attribute_block_take_free(unsigned int block_class, unsigned int size_bytes) {
+  uint32_t* link = &s_attribute_free_blocks[block_class];
+  while (*link != ATTRIBUTE_BLOCK_NONE) {
+    attribute_block_t* block = attribute_block(*link);
+    if (block->size_bytes >= size_bytes) {
+      *link = *attribute_block_next_free(block);
+      return block;
+    }
+    link = attribute_block_next_free(block);
+  }
+  return nullptr;
+}
+
+// Gives the end of a free block that is larger than `size_bytes` back to the free lists.
+static void attribute_block_split(attribute_block_t* block, unsigned int size_bytes) {
+  if (block->size_bytes - size_bytes < ATTRIBUTE_BLOCK_MIN_SIZE_BYTES) {
+    return;
+  }
+  // the rest gets its own header before this block shrinks, so a persistent store can always be walked
+  attribute_block_t* rest = (attribute_block_t*)((char*)block + size_bytes);
+  rest->size_bytes = block->size_bytes - size_bytes;
+  attribute_block_free(rest);
+  block->size_bytes = size_bytes;
+}
+
+// Merges every run of neighboring free blocks into one and rebuilds the free lists from them. A run at the end of the
+// used part of the buffer is handed back to it instead. Only free blocks change, so this is safe while reports read the
+// published attribute lists.
+static void attribute_block_coalesce() {
+  for (unsigned int block_class = 0; block_class < ATTRIBUTE_BLOCK_CLASS_COUNT; ++block_class) {
+    s_attribute_free_blocks[block_class] = ATTRIBUTE_BLOCK_NONE;
+  }
+  const unsigned int used = (unsigned int)s_attribute_buf_used;
+  unsigned int offset = 0;
+  while (offset < used) {
+    attribute_block_t* block = attribute_block(offset);
+    unsigned int end = offset + block->size_bytes;
+    if (block->state == ATTRIBUTE_BLOCK_FREE) {
+      while (end < used && attribute_block(end)->state == ATTRIBUTE_BLOCK_FREE) {
+        end += attribute_block(end)->size_bytes;
+      }
+      if (end == used) {
+        s_attribute_buf_used = (int)offset;
+        break;
+      }
+      block->size_bytes = end - offset;
+      attribute_block_free(block);
+    }
+    offset = end;
+  }
+}
+
+// Finds a block that can hold `size_bytes` of strings. The block size is rounded up to a multiple of
+// `ATTRIBUTE_BLOCK_MIN_SIZE_BYTES`. A freed block of about the right size is reused first, then a new one is carved off
+// of the unused end of the buffer, and failing that a larger freed block is split. When none of those fit, the free
+// blocks are merged with their neighbors and it all is tried once more.
+static attribute_block_t* attribute_block_alloc(unsigned int size_bytes) {
+  const unsigned int needed = size_bytes + (unsigned int)sizeof(attribute_block_t);
+  const unsigned int block_size_bytes =
+      (needed + ATTRIBUTE_BLOCK_MIN_SIZE_BYTES - 1) / ATTRIBUTE_BLOCK_MIN_SIZE_BYTES * ATTRIBUTE_BLOCK_MIN_SIZE_BYTES;
+  const unsigned int block_class = attribute_block_class(block_size_bytes);
+
+  for (int attempt = 0; attempt < 2; ++attempt) {
+    attribute_block_t* block = attribute_block_take_free(block_class, block_size_bytes);
+    if (block == nullptr && block_size_bytes <= s_config.attribute_buf_size_bytes - s_attribute_buf_used) {
+      block = attribute_block(s_attribute_buf_used);
+      block->size_bytes = block_size_bytes;
+      block->state = ATTRIBUTE_BLOCK_FREE;
+      s_attribute_buf_used += block_size_bytes;
+      return block;
+    }
+    // every block on a larger list is big enough
+    for (unsigned int from_class = block_class + 1; block == nullptr && from_class < ATTRIBUTE_BLOCK_CLASS_COUNT;
+         ++from_class) {
+      block = attribute_block_take_free(from_class, block_size_bytes);
+    }
+    if (block != nullptr) {
+      attribute_block_split(block, block_size_bytes);
+      return block;
+    }
+    attribute_block_coalesce();
+  }
+  return nullptr;
+}
+
+// Fills a block with an attribute and points the attribute at `index` at it.
+static void attribute_block_write(attribute_block_t* block,
+                                  int index,
+                                  const char* key,
+                                  unsigned int key_size_bytes,
+                                  const char* value,
+                                  unsigned int value_size_bytes) {
+  char* key_in_buf = (char*)(block + 1);
+  char* value_in_buf = key_in_buf + key_size_bytes;
+  memmove(key_in_buf, key, key_size_bytes);
+  memmove(value_in_buf, value, value_size_bytes);
+  block->state = ATTRIBUTE_BLOCK_LIVE;
+  s_attribute_keys[index] = key_in_buf;
+  s_attribute_values[index] = value_in_buf;
+}
+
+static void attribute_table_clear() {
+  for (unsigned int slot = 0; slot <= s_attribute_table_mask; ++slot) {
+    s_attribute_table[slot] = ATTRIBUTE_EMPTY_SLOT;
+  }
+  for (unsigned int block_class = 0; block_class < ATTRIBUTE_BLOCK_CLASS_COUNT; ++block_class) {
+    s_attribute_free_blocks[block_class] = ATTRIBUTE_BLOCK_NONE;
+  }
+  s_attribute_count = 0;
+  s_attribute_buf_used = 0;
+  s_attribute_retired_count = 0;
+}
+
+static uint64_t attribute_next_generation() {
+  return s_attribute_version.load(std::memory_order_relaxed)->generation + 1;
+}
+
+// Sets aside the block of the attribute at `index`. Published lists may still point into it, so it isn't reused until
+// `attribute_reclaim()` finds no report can be reading them. A block written since the last list was published (i.e.
+// earlier in the same batch) was never seen by a report and is freed straight away.
+static void attribute_block_retire(int index) {
+  attribute_block_t* block = (attribute_block_t*)s_attribute_keys[index] - 1;
+  if (s_attribute_births[index] == attribute_next_generation()) {
+    attribute_block_free(block);
+    return;
+  }
+  block->state = ATTRIBUTE_BLOCK_RETIRED;
+  attribute_retired_t* retired = &s_attribute_retired[s_attribute_retired_count++];
+  retired->offset = (uint32_t)((char*)block - s_attribute_buf);
+  retired->birth = s_attribute_births[index];
+  retired->retire = attribute_next_generation();
+}
+
+// Frees the retired blocks that neither the latest list nor the one a report has pinned point into.
+static void attribute_reclaim() {
+  const attribute_version_t* pinned = s_attribute_version_pinned.load(std::memory_order_seq_cst);
+  const uint64_t current = s_attribute_version.load(std::memory_order_relaxed)->generation;
+  unsigned int index = 0;
+  while (index < s_attribute_retired_count) {
+    const attribute_retired_t* retired = &s_attribute_retired[index];
+    const bool in_current = retired->retire > current;
+    const bool in_pinned =
+        pinned != nullptr && retired->birth <= pinned->generation && pinned->generation < retired->retire;
+    if (in_current || in_pinned) {
+      ++index;
+      continue;
+    }
+    attribute_block_free(attribute_block(retired->offset));
+    s_attribute_retired[index] = s_attribute_retired[--s_attribute_retired_count];
+  }
+}
+
+// Copies the attributes into a list that isn't published or pinned and makes it the latest, then frees whatever blocks
+// it can.
+static void attribute_publish() {
+  attribute_version_t* current = s_attribute_version.load(std::memory_order_relaxed);
+  const attribute_version_t* pinned = s_attribute_version_pinned.load(std::memory_order_seq_cst);
+  attribute_version_t* next = s_attribute_versions;
+  while (next == current || next == pinned) {
+    ++next;
+  }
+  next->generation = current->generation + 1;
+  next->count = s_attribute_count;
+  memcpy(next->keys, s_attribute_keys, s_attribute_count * sizeof(char*));
+  memcpy(next->values, s_attribute_values, s_attribute_count * sizeof(char*));
+  s_attribute_version.store(next, std::memory_order_seq_cst);
+  attribute_reclaim();
+}
+
+// Returns the latest attribute list and keeps writers from reusing it or the blocks it points into until
+// `attribute_version_unpin()`. Only one list can be pinned at a time, which holds since reports take `s_report_mutex`.
+static const attribute_version_t* attribute_version_pin() {
+  attribute_version_t* version = s_attribute_version.load(std::memory_order_acquire);
+  for (;;) {
+    // a writer that didn't see the pin may already be replacing the list, so check it is still the latest after
+    s_attribute_version_pinned.store(version, std::memory_order_seq_cst);
+    attribute_version_t* latest = s_attribute_version.load(std::memory_order_seq_cst);
+    if (latest == version) {
+      return version;
+    }
+    version = latest;
+  }
+}
+
+static void attribute_version_unpin() {
+  s_attribute_version_pinned.store(nullptr, std::memory_order_release);
+}
+
+// Returns the slot holding `key`, or the empty slot it would go in.
+static unsigned int attribute_table_find(const char* key, uint64_t hash) {
+  unsigned int slot = (unsigned int)hash & s_attribute_table_mask;
+  for (;;) {
+    const int index = s_attribute_table[slot];
+    if (index == ATTRIBUTE_EMPTY_SLOT ||
+        (s_attribute_hashes[index] == hash && 0 == strcmp(key, s_attribute_keys[index]))) {
+      return slot;
+    }
+    slot = (slot + 1) & s_attribute_table_mask;
+  }
+}
+
+// Returns the slot that holds the attribute at `index`.
+static unsigned int attribute_table_slot_of(int index) {
+  unsigned int slot = (unsigned int)s_attribute_hashes[index] & s_attribute_table_mask;
+  while (s_attribute_table[slot] != index) {
+    slot = (slot + 1) & s_attribute_table_mask;
+  }
+  return slot;
+}
+
+static void attribute_clear(unsigned int slot) {
+  const int index = s_attribute_table[slot];
+  attribute_block_retire(index);
+
+  // keep the attributes packed by moving the last one into the hole
+  const int last = s_attribute_count - 1;
+  if (index != last) {
+    s_attribute_table[attribute_table_slot_of(last)] = index;
+    s_attribute_keys[index] = s_attribute_keys[last];
+    s_attribute_values[index] = s_attribute_values[last];
+    s_attribute_hashes[index] = s_attribute_hashes[last];
+    s_attribute_births[index] = s_attribute_births[last];
+  }
+  --s_attribute_count;
+
+  // pull back any later entries in the probe run that could have used the emptied slot, so lookups don't need
+  // tombstones
+  unsigned int hole = slot;
+  unsigned int next = slot;
+  for (;;) {
+    next = (next + 1) & s_attribute_table_mask;
+    const int moved = s_attribute_table[next];
+    if (moved == ATTRIBUTE_EMPTY_SLOT) {
+      break;
+    }
+    const unsigned int home = (unsigned int)s_attribute_hashes[moved] & s_attribute_table_mask;
+    if (((next - home) & s_attribute_table_mask) >= ((next - hole) & s_attribute_table_mask)) {
+      s_attribute_table[hole] = moved;
+      hole = next;
+    }
+  }
+  s_attribute_table[hole] = ATTRIBUTE_EMPTY_SLOT;
+}
+
+static attribute_error_t attribute_set(unsigned int slot,
+                                       const char* key,
+                                       unsigned int key_size_bytes,
+                                       uint64_t hash,
+                                       const char* value) {
+  const unsigned int value_size_bytes = (unsigned int)strlen(value) + 1;
+  const unsigned int size_bytes = key_size_bytes + value_size_bytes;
+
+  // published lists may point at the old value, so a new value always goes in a new block
+  int index = s_attribute_table[slot];
+  if (index == ATTRIBUTE_EMPTY_SLOT && s_attribute_count == (int)s_config.max_attribute_count) {
+    return ATTRIBUTE_ERROR_COUNT_FULL;
+  }
+  attribute_block_t* block = attribute_block_alloc(size_bytes);
+  if (block == nullptr) {
+    return ATTRIBUTE_ERROR_BUF_FULL;
+  }
+  if (index != ATTRIBUTE_EMPTY_SLOT) {
+    attribute_block_retire(index);
+  }
+  else {
+    index = s_attribute_count++;
+    s_attribute_hashes[index] = hash;
+    s_attribute_table[slot] = index;
+  }
+  s_attribute_births[index] = attribute_next_generation();
+  attribute_block_write(block, index, key, key_size_bytes, value, value_size_bytes);
+  return ATTRIBUTE_ERROR_NONE;
+}
+
+// Sets or removes one attribute without publishing. Must be called with `s_attribute_mutex` held.
+static attribute_error_t attribute_change(const char* key, const char* value) {
+  unsigned int key_size_bytes;
+  const uint64_t hash = hash_string(key, &key_size_bytes);
+  const unsigned int slot = attribute_table_find(key, hash);
+  if (value != nullptr) {
+    return attribute_set(slot, key, key_size_bytes, hash, value);
+  }
+  if (s_attribute_table[slot] != ATTRIBUTE_EMPTY_SLOT) {
+    attribute_clear(slot);
+  }
+  return ATTRIBUTE_ERROR_NONE;
+}
+
+// Asserts on an error from `attribute_change()`. `avail` is the space that was left in the attribute buffer.
+static void attribute_assert_no_error(attribute_error_t error, const char* key, const char* value, int avail) {
+  FORENSICS_ASSERTF(error != ATTRIBUTE_ERROR_COUNT_FULL,
+                    "Cannot set attribute because the attribute key array is full. Try increasing the size of "
+                    "max_attribute_count. key=%s value=%s",
+                    key,
+                    value);
+  FORENSICS_ASSERTF(error != ATTRIBUTE_ERROR_BUF_FULL,
+                    "Cannot set attribute because the attribute buffer is full. Try increasing the size of "
+                    "attribute_buf_size_bytes. attribute=%s needed=%u avail=%d",
+                    key,
+                    (unsigned int)(strlen(key) + strlen(value) + 2),
+                    avail);
+}
+
+#ifdef _MSC_VER
+// Copies memory that writers may be changing at the same time, for readers that check a sequence or state word
+// afterwards and throw away a torn copy.
+static void seqlock_copy(void* dst, const void* src, size_t size_bytes) {
+  memcpy(dst, src, size_bytes);
+}
+#else
+typedef uintptr_t seqlock_word_t __attribute__((may_alias));
+
+// Copies memory that writers may be changing at the same time, for readers that check a sequence or state word
+// afterwards and throw away a torn copy. The loads are relaxed atomics, a word at a time where the buffers allow, so
+// the compiler can't assume the memory holds still. The writers' stores are plain ones, so ThreadSanitizer still sees
+// a race with this function, and only this function; `spec/tsan.supp` suppresses it.
+__attribute__((noinline)) static void seqlock_copy(void* dst, const void* src, size_t size_bytes) {
+  char* out = (char*)dst;
+  const char* in = (const char*)src;
+  if ((((uintptr_t)out | (uintptr_t)in) & (sizeof(seqlock_word_t) - 1)) == 0) {
+    for (; size_bytes >= sizeof(seqlock_word_t); size_bytes -= sizeof(seqlock_word_t)) {
+      *(seqlock_word_t*)out = __atomic_load_n((const seqlock_word_t*)in, __ATOMIC_RELAXED);
+      out += sizeof(seqlock_word_t);
+      in += sizeof(seqlock_word_t);
+    }
+  }
+  for (; size_bytes > 0; --size_bytes) {
+    *out++ = __atomic_load_n(in++, __ATOMIC_RELAXED);
+  }
+}
+#endif
+
+static bool registered_attribute_is_valid(forensics_attribute_t handle) {
+  return handle != FORENSICS_ATTRIBUTE_INVALID && handle <= s_registered_attribute_count.load(std::memory_order_acquire);
+}
+
+static void registered_attribute_write(registered_attribute_t* attribute, const char* value) {
+  if (value == nullptr) {
+    attribute->block->state = ATTRIBUTE_BLOCK_UNSET;
+    return;
+  }
+  unsigned int size = 0;
+  while (size + 1 < attribute->value_size_bytes && value[size] != 0) {
+    ++size;
+  }
+  memcpy(attribute->value, value, size);
+  attribute->value[size] = 0;
+  attribute->block->state = ATTRIBUTE_BLOCK_LIVE;
+}
+
+// Takes a registered attribute's sequence counter from even to odd. Only one thread can write the value at a time, so
+// this waits while another one is.
+static void registered_attribute_write_begin(registered_attribute_t* attribute) {
+  unsigned int sequence = attribute->sequence.load(std::memory_order_relaxed);
+  for (;;) {
+    if ((sequence & 1) != 0) {
+      std::this_thread::yield();
+      sequence = attribute->sequence.load(std::memory_order_relaxed);
+    }
+    else if (attribute->sequence.compare_exchange_weak(
+                 sequence, sequence + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+      break;
+    }
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+// Copies a registered attribute's value into `dst` without taking a lock. Returns false if it has no value or kept
+// changing while it was copied.
+static bool registered_attribute_copy(registered_attribute_t* attribute, char* dst) {
+  for (int attempt = 0; attempt < SNAPSHOT_RETRY_LIMIT; ++attempt) {
+    const unsigned int sequence = attribute->sequence.load(std::memory_order_acquire);
+    if ((sequence & 1) != 0) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t state;
+    seqlock_copy(&state, &attribute->block->state, sizeof(state));
+    seqlock_copy(dst, attribute->value, attribute->value_size_bytes);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (attribute->sequence.load(std::memory_order_relaxed) == sequence) {
+      dst[attribute->value_size_bytes - 1] = 0;
+      return state == ATTRIBUTE_BLOCK_LIVE;
+    }
+  }
+  return false;
+}
+
+static void registered_attributes_destroy() {
+  const unsigned int count = s_registered_attribute_count.load(std::memory_order_relaxed);
+  for (unsigned int index = 0; index < count; ++index) {
+    s_registered_attributes[index].~registered_attribute_t();
+  }
+  s_registered_attribute_count.store(0, std::memory_order_relaxed);
+}
+
+static bool numeric_attribute_is_valid(forensics_numeric_attribute_t handle) {
+  return handle != FORENSICS_NUMERIC_ATTRIBUTE_INVALID &&
+         handle <= s_numeric_attribute_count.load(std::memory_order_acquire);
+}
+
+// Returns the numeric attribute for a handle, or nullptr (after asserting) if the handle or type is wrong.
+static numeric_attribute_t* numeric_attribute_get(forensics_numeric_attribute_t handle, forensics_value_type_t type) {
+  if (!numeric_attribute_is_valid(handle)) {
+    FORENSICS_ASSERTF(false, "Invalid numeric attribute handle: %u", handle);
+    return nullptr;
+  }
+  numeric_attribute_t* attribute = &s_numeric_attributes[handle - 1];
+  if (!FORENSICS_ASSERTF(attribute->type == type,
+                         "Numeric attribute set with the wrong type. key=%s type=%d expected=%d",
+                         attribute->key,
+                         (int)type,
+                         (int)attribute->type)) {
+    return nullptr;
+  }
+  return attribute;
+}
+
+static forensics_value_t numeric_attribute_value(const numeric_attribute_t* attribute) {
+  const uint64_t bits = attribute->bits.load(std::memory_order_relaxed);
+  if (attribute->type == FORENSICS_VALUE_DOUBLE) {
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return forensics_value_f64(value);
+  }
+  return forensics_value_i64((int64_t)bits);
+}
+
+// Copies a string whose size is already known. Most breadcrumb strings are short, so rather than calling into the C
+// library those are copied with a pair of fixed size (possibly overlapping) moves that compile down to a couple of
+// register or vector loads and stores. Everything is loaded before anything is stored so `dst` may overlap `src`.
+static void copy_string(char* dst, const char* src, unsigned int size) {
+  if (size > 2 * HASH_CHUNK_SIZE_BYTES) {
+    memmove(dst, src, size);
+  }
+  else if (size >= HASH_CHUNK_SIZE_BYTES) {
+    char head[HASH_CHUNK_SIZE_BYTES];
+    char tail[HASH_CHUNK_SIZE_BYTES];
+    memcpy(head, src, HASH_CHUNK_SIZE_BYTES);
+    memcpy(tail, src + size - HASH_CHUNK_SIZE_BYTES, HASH_CHUNK_SIZE_BYTES);
+    memcpy(dst, head, HASH_CHUNK_SIZE_BYTES);
+    memcpy(dst + size - HASH_CHUNK_SIZE_BYTES, tail, HASH_CHUNK_SIZE_BYTES);
+  }
+  else if (size >= sizeof(uint64_t)) {
+    uint64_t head;
+    uint64_t tail;
+    memcpy(&head, src, sizeof(uint64_t));
+    memcpy(&tail, src + size - sizeof(uint64_t), sizeof(uint64_t));
+    memcpy(dst, &head, sizeof(uint64_t));
+    memcpy(dst + size - sizeof(uint64_t), &tail, sizeof(uint64_t));
+  }
+  else if (size >= sizeof(uint32_t)) {
+    uint32_t head;
+    uint32_t tail;
+    memcpy(&head, src, sizeof(uint32_t));
+    memcpy(&tail, src + size - sizeof(uint32_t), sizeof(uint32_t));
+    memcpy(dst, &head, sizeof(uint32_t));
+    memcpy(dst + size - sizeof(uint32_t), &tail, sizeof(uint32_t));
+  }
+  else {
+    // 1 to 3 bytes
+    const char first = src[0];
+    const char middle = src[size / 2];
+    const char last = src[size - 1];
+    dst[0] = first;
+    dst[size / 2] = middle;
+    dst[size - 1] = last;
+  }
+}
+
+// Records the size of one of a breadcrumb's strings for `breadcrumb_string_size()`.
+static void breadcrumb_record_string_size(breadcrumb_desc_t* desc, int string_index, unsigned int size_bytes) {
+  if (string_index < BREADCRUMB_MEASURED_STRING_COUNT) {
+    desc->string_sizes[string_index] = size_bytes;
+  }
+}
+
+// Computes the space needed to store a breadcrumb's data in a breadcrumb buffer along with a hash of its contents. Each
+// string is only scanned once to do both, and its size is recorded so copying it doesn't need another scan. Interned
+// strings were hashed when they were registered.
+static void breadcrumb_measure(breadcrumb_desc_t* desc) {
+  unsigned int size_bytes = 0;
+  unsigned int required_size = sizeof(char**) * 2 * desc->meta_count;
+  uint64_t hash = hash_combine(HASH_SEED, (uint64_t)desc->meta_count);
+
+  if (desc->name_handle != FORENSICS_STRING_INVALID) {
+    hash = hash_combine(hash, s_interned_string_hashes[desc->name_handle - 1]);
+  }
+  else {
+    hash = hash_combine(hash, hash_string(desc->name, &size_bytes));
+    breadcrumb_record_string_size(desc, 0, size_bytes);
+    required_size += size_bytes;
+  }
+
+  for (int index = 0; index < desc->meta_count; ++index) {
+    if (desc->meta_key_handles != nullptr) {
+      hash = hash_combine(hash, s_interned_string_hashes[desc->meta_key_handles[index] - 1]);
+    }
+    else {
+      hash = hash_combine(hash, hash_string(desc->meta_keys[index], &size_bytes));
+      breadcrumb_record_string_size(desc, 1 + 2 * index, size_bytes);
+      required_size += size_bytes;
+    }
+
+    if (desc->meta_typed_values != nullptr) {
+      const forensics_value_t* value = &desc->meta_typed_values[index];
+      required_size += sizeof(forensics_value_t);
+      hash = hash_combine(hash, (uint64_t)value->type);
+      if (value->type == FORENSICS_VALUE_STRING) {
+        hash = hash_combine(hash, hash_string(value->as.str, &size_bytes));
+        breadcrumb_record_string_size(desc, 2 + 2 * index, size_bytes);
+        required_size += size_bytes;
+      }
+      else {
+        uint64_t bits = 0;
+        switch (value->type) {
+          case FORENSICS_VALUE_POINTER:
+            bits = (uint64_t)(uintptr_t)value->as.ptr;
+            break;
+          case FORENSICS_VALUE_BOOL:
+            bits = value->as.b ? 1 : 0;
+            break;
+          default:
+            memcpy(&bits, &value->as, sizeof(uint64_t));
+            break;
+        }
+        hash = hash_combine(hash, bits);
+      }
+    }
+    else {
+      hash = hash_combine(hash, hash_string(desc->meta_values[index], &size_bytes));
+      breadcrumb_record_string_size(desc, 2 + 2 * index, size_bytes);
+      required_size += size_bytes;
+    }
+  }
+
+  desc->size = breadcrumb_align_size(required_size);
+  desc->hash = hash;
+}
+
+// Copies a breadcrumb's data into `buf` (which must hold `desc->size` bytes) and points `crumb` at the copy. The string
+// sizes recorded by `breadcrumb_measure()` are used so the strings are copied without being scanned again.
+static void breadcrumb_write(char* buf, forensics_breadcrumb_t* crumb, const breadcrumb_desc_t* desc) {
+  const int meta_count = desc->meta_count;
+
+  const char** out_meta_keys = (const char**)buf;
+  const char** out_meta_values = out_meta_keys + meta_count;
+  forensics_value_t* out_meta_typed_values = (forensics_value_t*)(out_meta_values + meta_count);
+  char* ptr = (char*)out_meta_typed_values;
+  if (desc->meta_typed_values != nullptr) {
+    ptr = (char*)(out_meta_typed_values + meta_count);
+  }
+  if (desc->name_handle != FORENSICS_STRING_INVALID) {
+    crumb->name = desc->name;
+  }
+  else {
+    const unsigned int name_size_bytes = breadcrumb_string_size(desc, 0, desc->name);
+    copy_string(ptr, desc->name, name_size_bytes);
+    crumb->name = ptr;
+    ptr += name_size_bytes;
+  }
+  for (int index = 0; index < meta_count; ++index) {
+    if (desc->meta_key_handles != nullptr) {
+      out_meta_keys[index] = breadcrumb_desc_key(desc, index);
+    }
+    else {
+      const unsigned int key_size_bytes = breadcrumb_string_size(desc, 1 + 2 * index, desc->meta_keys[index]);
+      copy_string(ptr, desc->meta_keys[index], key_size_bytes);
+      out_meta_keys[index] = ptr;
+      ptr += key_size_bytes;
+    }
+
+    if (desc->meta_typed_values != nullptr) {
+      // typed values are formatted when a report is generated
+      out_meta_typed_values[index] = desc->meta_typed_values[index];
+      out_meta_values[index] = nullptr;
+      if (desc->meta_typed_values[index].type == FORENSICS_VALUE_STRING) {
+        const unsigned int value_size_bytes =
+            breadcrumb_string_size(desc, 2 + 2 * index, desc->meta_typed_values[index].as.str);
+        copy_string(ptr, desc->meta_typed_values[index].as.str, value_size_bytes);
+        out_meta_typed_values[index].as.str = ptr;
+        out_meta_values[index] = ptr;
+        ptr += value_size_bytes;
+      }
+    }
+    else {
+      const unsigned int value_size_bytes = breadcrumb_string_size(desc, 2 + 2 * index, desc->meta_values[index]);
+      copy_string(ptr, desc->meta_values[index], value_size_bytes);
+      out_meta_values[index] = ptr;
+      ptr += value_size_bytes;
+    }
+  }
+
+  if (meta_count > 0) {
+    crumb->meta_keys = out_meta_keys;
+    crumb->meta_values = out_meta_values;
+  }
+  else {
+    crumb->meta_keys = nullptr;
+    crumb->meta_values = nullptr;
+  }
+  if (meta_count > 0 && desc->meta_typed_values != nullptr) {
+    crumb->meta_typed_values = out_meta_typed_values;
+  }
+  else {
+    crumb->meta_typed_values = nullptr;
+  }
+  crumb->meta_count = meta_count;
+  crumb->count = 1;
+  crumb->loop_length = 0;
+  crumb->loop_count = 0;
+  crumb->first_timestamp = desc->timestamp;
+  crumb->last_timestamp = desc->timestamp;
+  crumb->channel = nullptr;
+}
+
+// Re-points a breadcrumb whose data was copied from `src` (`size_bytes` long) to `dst` at the copy.
+static void breadcrumb_relocate(forensics_breadcrumb_t* crumb, const char* src, char* dst, unsigned int size_bytes) {
+  const char* src_end = src + size_bytes;
+  auto relocate = [=](const char* ptr) -> const char* {
+    if (ptr >= src && ptr < src_end) {
+      return dst + (ptr - src);
+    }
+    return ptr;
+  };
+
+  crumb->name = relocate(crumb->name);
+  if (crumb->meta_count > 0) {
+    crumb->meta_keys = (const char**)relocate((const char*)crumb->meta_keys);
+    crumb->meta_values = (const char**)relocate((const char*)crumb->meta_values);
+    for (int index = 0; index < crumb->meta_count; ++index) {
+      crumb->meta_keys[index] = relocate(crumb->meta_keys[index]);
+      crumb->meta_values[index] = relocate(crumb->meta_values[index]);
+    }
+  }
+  if (crumb->meta_typed_values != nullptr) {
+    forensics_value_t* meta_typed_values = (forensics_value_t*)relocate((const char*)crumb->meta_typed_values);
+    for (int index = 0; index < crumb->meta_count; ++index) {
+      if (meta_typed_values[index].type == FORENSICS_VALUE_STRING) {
+        meta_typed_values[index].as.str = relocate(meta_typed_values[index].as.str);
+      }
+    }
+    crumb->meta_typed_values = meta_typed_values;
+  }
+}
+
+// Frees up ring space for a crumb of the given size, removing the oldest crumbs as needed but keeping the newest `keep`
+// crumbs. Returns NULL if that isn't possible.
+static char* breadcrumb_ring_reserve(breadcrumb_ring_t* ring, unsigned int size_bytes, unsigned int keep) {
+  // remove a breadcrumb if there are too many
+  if (ring->count >= ring->capacity) {
+    if (ring->count <= keep) {
+      return nullptr;
+    }
+    breadcrumb_deque(ring);
+  }
+
+  // bail in the pathalogical case where it can't fit
+  if (size_bytes > ring->buf_size_bytes) {
+    return nullptr;
+  }
+
+  // remove breadcrumbs to make room
+  char* alloc = breadcrumb_buf_alloc(ring, size_bytes);
+  while (alloc == nullptr) {
+    if (ring->count <= keep) {
+      return nullptr;
+    }
+    breadcrumb_deque(ring);
+    alloc = breadcrumb_buf_alloc(ring, size_bytes);
+  }
+  return alloc;
+}
+
+// Appends the breadcrumb at `alloc` (which came from `breadcrumb_ring_reserve()`) to the ring.
+static breadcrumb_t* breadcrumb_ring_push(breadcrumb_ring_t* ring, char* alloc, unsigned int size_bytes, uint64_t hash) {
+  breadcrumb_t* breadcrumb = ring->breadcrumbs + ring->index_next;
+  breadcrumb->buf_offset = (unsigned int)(alloc - ring->buf);
+  breadcrumb->buf_size = size_bytes;
+  breadcrumb->hash = hash;
+
+  ring->index_next = (ring->index_next + 1) % ring->capacity;
+  ++ring->count;
+  return breadcrumb;
+}
+
+// Appends a copy of the crumb `age` entries back from the newest one, with the given repeat count, as it was left in
+// the partial pass through its block. Fails rather than removing the crumb being copied to make room.
+static bool breadcrumb_ring_copy(breadcrumb_ring_t* ring, unsigned int age, int count) {
+  const breadcrumb_t* src = breadcrumb_ring_newest(ring, age);
+  const unsigned int size_bytes = src->buf_size;
+  char* alloc = breadcrumb_ring_reserve(ring, size_bytes, age + 1);
+  if (alloc == nullptr) {
+    return false;
+  }
+
+  // `src` is still in the ring so its data can't overlap the new allocation
+  const char* src_buf = ring->buf + src->buf_offset;
+  memcpy(alloc, src_buf, size_bytes);
+  forensics_breadcrumb_t crumb = src->crumb;
+  breadcrumb_relocate(&crumb, src_buf, alloc, size_bytes);
+  crumb.count = count;
+  crumb.loop_length = 0;
+  crumb.loop_count = 0;
+  crumb.first_timestamp = src->pass_first_timestamp;
+  crumb.last_timestamp = src->pass_last_timestamp;
+
+  breadcrumb_t* breadcrumb = breadcrumb_ring_push(ring, alloc, size_bytes, src->hash);
+  breadcrumb->crumb = crumb;
+  return true;
+}
+
+// Tries to match the given crumb against the next expected crumb of the repeating block.
+static bool breadcrumb_ring_loop_match(breadcrumb_ring_t* ring, const breadcrumb_desc_t* desc) {
+  breadcrumb_t* expected = breadcrumb_ring_newest(ring, ring->loop_length - 1 - ring->loop_progress);
+  if (expected->hash != desc->hash || !breadcrumb_equals(&expected->crumb, desc)) {
+    return false;
+  }
+
+  if (ring->loop_repeat == 0) {
+    expected->pass_first_timestamp = desc->timestamp;
+  }
+  expected->pass_last_timestamp = desc->timestamp;
+  if (++ring->loop_repeat < (unsigned int)expected->crumb.count) {
+    return true;
+  }
+  ring->loop_repeat = 0;
+  if (++ring->loop_progress < ring->loop_length) {
+    return true;
+  }
+
+  // made it all the way through the block again
+  ring->loop_progress = 0;
+  for (unsigned int age = 0; age < ring->loop_length; ++age) {
+    breadcrumb_t* breadcrumb = breadcrumb_ring_newest(ring, age);
+    breadcrumb->crumb.last_timestamp = breadcrumb->pass_last_timestamp;
+  }
+  forensics_breadcrumb_t* end = &breadcrumb_ring_newest(ring, 0)->crumb;
+  end->loop_count = end->loop_length == 0 ? 2 : end->loop_count + 1;
+  end->loop_length = (int)ring->loop_length;
+  return true;
+}
+
+// Stops matching the repeating block, writing out the crumbs from the partial pass through it.
+static void breadcrumb_ring_loop_end(breadcrumb_ring_t* ring) {
+  const unsigned int length = ring->loop_length;
+  const unsigned int progress = ring->loop_progress;
+  const unsigned int repeat = ring->loop_repeat;
+  ring->loop_length = 0;
+  ring->loop_progress = 0;
+  ring->loop_repeat = 0;
+
+  // Each copy pushes the rest of the block back by one, so the next crumb to copy is always the same age. If the ring is
+  // too small to hold the copies, the rest of the partial pass is lost.
+  for (unsigned int index = 0; index < progress; ++index) {
+    const int count = breadcrumb_ring_newest(ring, length - 1)->crumb.count;
+    if (!breadcrumb_ring_copy(ring, length - 1, count)) {
+      return;
+    }
+  }
+  if (repeat > 0) {
+    breadcrumb_ring_copy(ring, length - 1, (int)repeat);
+  }
+}
+
+// Looks for a block of the newest crumbs that starts with the given crumb, so that the crumb repeats the block.
+static unsigned int breadcrumb_ring_loop_find(breadcrumb_ring_t* ring, const breadcrumb_desc_t* desc) {
+  unsigned int max_length = s_config.max_breadcrumb_loop_length;
+  if (max_length > ring->count) {
+    max_length = ring->count;
+  }
+
+  // blocks don't nest, so stop looking at the end of an earlier block
+  if (max_length < 2 || breadcrumb_ring_newest(ring, 0)->crumb.loop_length != 0) {
+    return 0;
+  }
+  for (unsigned int length = 2; length <= max_length; ++length) {
+    const breadcrumb_t* start = breadcrumb_ring_newest(ring, length - 1);
+    if (start->crumb.loop_length != 0) {
+      break;
+    }
+    if (start->hash == desc->hash && breadcrumb_equals(&start->crumb, desc)) {
+      return length;
+    }
+  }
+  return 0;
+}
+
+static void breadcrumb_ring_add(breadcrumb_ring_t* ring, const breadcrumb_desc_t* desc) {
+  // bail if configured to be disabled
+  if (ring->capacity == 0) {
+    return;
+  }
+
+  // continue the repeating block if there is one
+  if (ring->loop_length > 0) {
+    if (breadcrumb_ring_loop_match(ring, desc)) {
+      return;
+    }
+    breadcrumb_ring_loop_end(ring);
+  }
+
+  // compare against the last breadcrumb to see if we can just denote repetetion. The hashes rule out almost every
+  // mismatch without touching the strings. The end of a repeated block is left alone since its count belongs to every
+  // pass through the block.
+  if (ring->count > 0) {
+    breadcrumb_t* prev = breadcrumb_ring_newest(ring, 0);
+    if (prev->crumb.loop_length == 0 && prev->hash == desc->hash && breadcrumb_equals(&prev->crumb, desc)) {
+      // previous breadcrumb was identical; record the repetetion and bail
+      ++prev->crumb.count;
+      prev->crumb.last_timestamp = desc->timestamp;
+      return;
+    }
+  }
+
+  // see if this starts another pass through a block of recent breadcrumbs
+  const unsigned int loop_length = breadcrumb_ring_loop_find(ring, desc);
+  if (loop_length > 0) {
+    ring->loop_length = loop_length;
+    ring->loop_progress = 0;
+    ring->loop_repeat = 0;
+    breadcrumb_ring_loop_match(ring, desc);
+    return;
+  }
+
+  // alloc space from the ring buffer
+  const unsigned int required_size = desc->size;
+  char* alloc = breadcrumb_ring_reserve(ring, required_size, 0);
+  if (alloc == nullptr) {
+    return;
+  }
+
+  // copy the data into the ring buffer
+  breadcrumb_t* breadcrumb = breadcrumb_ring_push(ring, alloc, required_size, desc->hash);
+  breadcrumb_write(alloc, &breadcrumb->crumb, desc);
+}
+
+// Checks if a crumb in a batch is certain to get an entry of its own when it is added to the ring, i.e. nothing else in
+// the batch and none of the crumbs it could be coalesced with or matched against in the ring look the same.
+static bool breadcrumb_ring_batch_is_distinct(breadcrumb_ring_t* ring,
+                                              const breadcrumb_desc_t* descs,
+                                              int count,
+                                              int index,
+                                              unsigned int window) {
+  const uint64_t hash = descs[index].hash;
+  for (int other = 0; other < count; ++other) {
+    if (other != index && descs[other].hash == hash) {
+      return false;
+    }
+  }
+  for (unsigned int age = 0; age < window; ++age) {
+    if (breadcrumb_ring_newest(ring, age)->hash == hash) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Adds a batch of crumbs to the ring. Crumbs that would be pushed out of the ring by the distinct crumbs after them in
+// the batch are skipped rather than copied in and thrown away again.
+static void breadcrumb_ring_add_batch(breadcrumb_ring_t* ring, const breadcrumb_desc_t* descs, int count) {
+  if (count == 1) {
+    breadcrumb_ring_add(ring, descs);
+    return;
+  }
+
+  unsigned int window = s_config.max_breadcrumb_loop_length > 1 ? s_config.max_breadcrumb_loop_length : 1;
+  if (window > ring->count) {
+    window = ring->count;
+  }
+
+  int first = 0;
+  unsigned int distinct_count = 0;
+  unsigned int distinct_size = 0;
+  for (int index = count - 1; index >= 0; --index) {
+    if (!breadcrumb_ring_batch_is_distinct(ring, descs, count, index, window)) {
+      continue;
+    }
+    ++distinct_count;
+    distinct_size += descs[index].size;
+    if (distinct_count > ring->capacity || distinct_size > ring->buf_size_bytes) {
+      first = index + 1;
+      break;
+    }
+  }
+
+  for (int index = first; index < count; ++index) {
+    breadcrumb_ring_add(ring, &descs[index]);
+  }
+}
+
+// Returns the most crumbs from a partial pass through a repeating block that a ring with the given capacity can report
+// on top of its own crumbs.
+static unsigned int breadcrumb_loop_capacity(unsigned int capacity) {
+  return s_config.max_breadcrumb_loop_length < capacity ? s_config.max_breadcrumb_loop_length : capacity;
+}
+
+// Returns the number of crumbs a ring contributes to a report, including those from a partial pass through a repeating
+// block.
+static unsigned int breadcrumb_ring_report_count(const breadcrumb_ring_t* ring) {
+  if (ring->loop_length == 0) {
+    return ring->count;
+  }
+  return ring->count + ring->loop_progress + (ring->loop_repeat > 0 ? 1 : 0);
+}
+
+// Returns the crumb `age` entries back from the newest one as it appears in a report (see
+// `breadcrumb_ring_report_count()`).
+static forensics_breadcrumb_t breadcrumb_ring_report_crumb(breadcrumb_ring_t* ring, unsigned int age) {
+  const unsigned int pending = breadcrumb_ring_report_count(ring) - ring->count;
+  if (age >= pending) {
+    return breadcrumb_ring_newest(ring, age - pending)->crumb;
+  }
+
+  // the partial pass is made of the crumbs from the start of the block
+  const unsigned int index = pending - 1 - age;
+  const breadcrumb_t* breadcrumb = breadcrumb_ring_newest(ring, ring->loop_length - 1 - index);
+  forensics_breadcrumb_t crumb = breadcrumb->crumb;
+  if (index == ring->loop_progress) {
+    crumb.count = (int)ring->loop_repeat;
+  }
+  crumb.loop_length = 0;
+  crumb.loop_count = 0;
+  crumb.first_timestamp = breadcrumb->pass_first_timestamp;
+  crumb.last_timestamp = breadcrumb->pass_last_timestamp;
+  return crumb;
+}
+
+static void thread_ring_init(thread_breadcrumb_ring_t* thread_ring) {
+  breadcrumb_ring_init(&thread_ring->ring, s_config.max_breadcrumb_count, s_config.breadcrumb_buf_size_bytes);
+  thread_ring->sequence.store(0, std::memory_order_relaxed);
+  thread_ring->initialized = true;
+  thread_ring->report_skip = false;
+  thread_ring->report_cursor = 0;
+
+  // Push onto the head of the list without taking `s_breadcrumb_ring_list_mutex`, so a thread's first crumb never waits
+  // on a report (which holds the mutex until its handler returns). Only the head is ever changed by a push.
+  thread_breadcrumb_ring_t* head = s_breadcrumb_ring_list.load(std::memory_order_relaxed);
+  do {
+    thread_ring->next = head;
+  } while (!s_breadcrumb_ring_list.compare_exchange_weak(
+      head, thread_ring, std::memory_order_release, std::memory_order_relaxed));
+}
+
+static void thread_ring_destroy(thread_breadcrumb_ring_t* thread_ring) {
+  std::lock_guard<std::mutex> lock(s_breadcrumb_ring_list_mutex);
+
+  // handle multiple destroys (could be both explicit and implied from the destructor)
+  if (thread_ring->initialized) {
+    // remove the ring from the linked list. If other rings have been pushed in front of it since, the link to it is
+    // further down the list, where only the holder of the mutex makes changes.
+    thread_breadcrumb_ring_t* head = thread_ring;
+    if (!s_breadcrumb_ring_list.compare_exchange_strong(
+            head, thread_ring->next, std::memory_order_acq_rel, std::memory_order_acquire)) {
+      thread_breadcrumb_ring_t* prev = head;
+      while (prev->next != thread_ring) {
+        prev = prev->next;
+      }
+      prev->next = thread_ring->next;
+    }
+
+    breadcrumb_ring_destroy(&thread_ring->ring);
+    thread_ring->initialized = false;
+  }
+}
+
+thread_breadcrumb_ring_t::~thread_breadcrumb_ring_t() {
+  // a thread that never set up a ring has nothing to unlink, so it doesn't wait on a report to exit
+  if (initialized) {
+    thread_ring_destroy(this);
+  }
+}
+
+static void thread_ring_add(const breadcrumb_desc_t* descs, int count) {
+  thread_breadcrumb_ring_t* thread_ring = &s_tls_breadcrumb_ring;
+
+  // handle first-time initialization (per thread). Crumbs are dropped while a report is active anyway, so the ring
+  // isn't set up until the report is done.
+  if (!thread_ring->initialized) {
+    if (s_breadcrumb_report_active.load(std::memory_order_seq_cst)) {
+      return;
+    }
+    thread_ring_init(thread_ring);
+  }
+
+  // Flag the write as in progress before checking for an active report. Paired with the reporter setting the report
+  // flag before polling the sequence, this guarantees that either the writer sees the report and drops its crumb or the
+  // reporter sees the write and waits for it to finish.
+  const unsigned int sequence = thread_ring->sequence.load(std::memory_order_relaxed);
+  thread_ring->sequence.store(sequence + 1, std::memory_order_seq_cst);
+  if (!s_breadcrumb_report_active.load(std::memory_order_seq_cst)) {
+    breadcrumb_ring_add_batch(&thread_ring->ring, descs, count);
+  }
+  thread_ring->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+// Stops all threads from writing to their rings so they can be read by the reporter. Must be called with
+// `s_breadcrumb_ring_list_mutex` held so the rings stay alive. The report reads the rings that are in the list at this
+// point; any ring pushed later belongs to a thread that will see the report and leave its ring alone.
+static void thread_rings_pause() {
+  s_breadcrumb_report_active.store(true, std::memory_order_seq_cst);
+  s_report_ring_list = s_breadcrumb_ring_list.load(std::memory_order_seq_cst);
+
+  for (thread_breadcrumb_ring_t* thread_ring = s_report_ring_list; thread_ring != nullptr;
+       thread_ring = thread_ring->next) {
+    // wait for any in-flight write to finish. A ring that never settles (e.g. the report came from a signal that
+    // interrupted its owner mid-write) is left out of the report.
+    thread_ring->report_skip = true;
+    for (int spin = 0; spin < THREAD_RING_WRITE_SPIN_LIMIT; ++spin) {
+      if ((thread_ring->sequence.load(std::memory_order_seq_cst) & 1) == 0) {
+        thread_ring->report_skip = false;
+        break;
+      }
+      std::this_thread::yield();
+    }
+  }
+}
+
+static void thread_rings_resume() {
+  s_breadcrumb_report_active.store(false, std::memory_order_seq_cst);
+}
+
+// Merges the newest crumbs from every thread's ring into the report buffer in timestamp order.
+static int thread_rings_merge() {
+  unsigned int total = 0;
+  for (thread_breadcrumb_ring_t* thread_ring = s_report_ring_list; thread_ring != nullptr;
+       thread_ring = thread_ring->next) {
+    thread_ring->report_cursor = thread_ring->report_skip ? 0 : breadcrumb_ring_report_count(&thread_ring->ring);
+    total += thread_ring->report_cursor;
+  }
+  if (total > s_config.max_breadcrumb_count) {
+    total = s_config.max_breadcrumb_count;
+  }
+
+  // Fill the report from the back, repeatedly taking the newest remaining crumb across all rings. The rings are
+  // individually sorted so this is a k-way merge; a linear scan for the newest head is cheaper than maintaining a heap
+  // for the handful of threads and crumbs involved and it needs no extra storage.
+  for (unsigned int out_index = total; out_index > 0; --out_index) {
+    thread_breadcrumb_ring_t* newest = nullptr;
+    uint64_t newest_timestamp = 0;
+    for (thread_breadcrumb_ring_t* thread_ring = s_report_ring_list; thread_ring != nullptr;
+         thread_ring = thread_ring->next) {
+      if (thread_ring->report_cursor == 0) {
+        continue;
+      }
+      const unsigned int age = breadcrumb_ring_report_count(&thread_ring->ring) - thread_ring->report_cursor;
+      const uint64_t timestamp = breadcrumb_ring_report_crumb(&thread_ring->ring, age).first_timestamp;
+      if (newest == nullptr || timestamp > newest_timestamp) {
+        newest = thread_ring;
+        newest_timestamp = timestamp;
+      }
+    }
+
+    const unsigned int age = breadcrumb_ring_report_count(&newest->ring) - newest->report_cursor;
+    s_report_breadcrumbs[out_index - 1] = breadcrumb_ring_report_crumb(&newest->ring, age);
+    --newest->report_cursor;
+  }
+
+  return (int)total;
+}
+
+static void breadcrumb_slots_init() {
+  // keep each slot aligned for its pointer arrays
+  s_breadcrumb_slot_size = 0;
+  if (s_config.max_breadcrumb_count > 0) {
+    s_breadcrumb_slot_size = s_config.breadcrumb_slot_size_bytes;
+    s_breadcrumb_slot_size -= s_breadcrumb_slot_size % BREADCRUMB_ALIGNMENT;
+  }
+  const unsigned int buf_size_bytes = s_breadcrumb_slot_size * s_config.max_breadcrumb_count;
+
+  s_breadcrumb_slots = (breadcrumb_slot_t*)forensics_alloc(s_config.max_breadcrumb_count * sizeof(breadcrumb_slot_t));
+  s_breadcrumb_slots_buf = (char*)forensics_alloc(buf_size_bytes);
+  s_report_breadcrumbs_buf = (char*)forensics_alloc(buf_size_bytes);
+  for (unsigned int index = 0; index < s_config.max_breadcrumb_count; ++index) {
+    s_breadcrumb_slots[index].state.store(0, std::memory_order_relaxed);
+  }
+  s_breadcrumb_slots_head.store(0);
+}
+
+static void breadcrumb_slots_destroy() {
+  forensics_free(s_report_breadcrumbs_buf);
+  forensics_free(s_breadcrumb_slots_buf);
+  forensics_free(s_breadcrumb_slots);
+  s_report_breadcrumbs_buf = nullptr;
+  s_breadcrumb_slots_buf = nullptr;
+  s_breadcrumb_slots = nullptr;
+  s_breadcrumb_slot_size = 0;
+  s_breadcrumb_slots_head.store(0);
+}
+
+// The state of a slot once the crumb with the given ticket is first published in it.
+static uint64_t breadcrumb_slot_state(uint64_t ticket) {
+  return (ticket + 1) << BREADCRUMB_SLOT_TICKET_SHIFT;
+}
+
+// Takes ownership of the slot for the crumb with the given ticket. Fails if a newer crumb already claimed the slot or
+// if another writer holds on to it for too long.
+static bool breadcrumb_slot_acquire(breadcrumb_slot_t* slot, uint64_t ticket) {
+  const uint64_t owned = breadcrumb_slot_state(ticket) | BREADCRUMB_SLOT_OWNED;
+  for (int spin = 0; spin < BREADCRUMB_SLOT_SPIN_LIMIT; ++spin) {
+    uint64_t state = slot->state.load(std::memory_order_relaxed);
+    if ((state >> BREADCRUMB_SLOT_TICKET_SHIFT) > ticket + 1) {
+      return false;
+    }
+    if ((state & BREADCRUMB_SLOT_OWNED) == 0 &&
+        slot->state.compare_exchange_weak(state, owned, std::memory_order_acquire, std::memory_order_relaxed)) {
+      return true;
+    }
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+static void breadcrumb_slots_add(const breadcrumb_desc_t* desc) {
+  // bail if configured to be disabled
+  if (s_breadcrumb_slot_size == 0) {
+    return;
+  }
+
+  // Compare against the newest breadcrumb to see if we can just denote repetetion. The slot is owned for the duration
+  // of the check so it can't be recycled underneath us. If another crumb has been reserved in the meantime, the
+  // repetition is no longer adjacent and is stored as a new crumb.
+  const uint64_t head = s_breadcrumb_slots_head.load(std::memory_order_acquire);
+  if (head > 0) {
+    breadcrumb_slot_t* prev = s_breadcrumb_slots + (head - 1) % s_config.max_breadcrumb_count;
+    uint64_t state = prev->state.load(std::memory_order_relaxed);
+    if ((state >> BREADCRUMB_SLOT_TICKET_SHIFT) == head && (state & BREADCRUMB_SLOT_OWNED) == 0 &&
+        prev->state.compare_exchange_strong(
+            state, state | BREADCRUMB_SLOT_OWNED, std::memory_order_acquire, std::memory_order_relaxed)) {
+      const bool match = s_breadcrumb_slots_head.load(std::memory_order_relaxed) == head &&
+                         prev->breadcrumb.hash == desc->hash && breadcrumb_equals(&prev->breadcrumb.crumb, desc);
+      if (match) {
+        // readers copying the slot have to see the new revision if they see any of the changes
+        std::atomic_thread_fence(std::memory_order_release);
+        ++prev->breadcrumb.crumb.count;
+        prev->breadcrumb.crumb.last_timestamp = desc->timestamp;
+        state = (state & ~(uint64_t)BREADCRUMB_SLOT_REVISION_MASK) | ((state + 2) & BREADCRUMB_SLOT_REVISION_MASK);
+      }
+      prev->state.store(state, std::memory_order_release);
+      if (match) {
+        return;
+      }
+    }
+  }
+
+  // reserve a slot
+  const uint64_t ticket = s_breadcrumb_slots_head.fetch_add(1, std::memory_order_acq_rel);
+  const unsigned int index = (unsigned int)(ticket % s_config.max_breadcrumb_count);
+  breadcrumb_slot_t* slot = s_breadcrumb_slots + index;
+  if (!breadcrumb_slot_acquire(slot, ticket)) {
+    return;
+  }
+
+  // Crumbs that are too big for their slot keep as many metadata pairs as fit. If even the name doesn't fit, it is cut
+  // short.
+  breadcrumb_desc_t fit_desc = *desc;
+  const unsigned int name_size_bytes = breadcrumb_name_size(desc);
+  unsigned int required_size = name_size_bytes;
+  for (fit_desc.meta_count = 0; fit_desc.meta_count < desc->meta_count; ++fit_desc.meta_count) {
+    const unsigned int pair_size = breadcrumb_meta_size(desc, fit_desc.meta_count);
+    if (required_size + pair_size > s_breadcrumb_slot_size) {
+      break;
+    }
+    required_size += pair_size;
+  }
+
+  char* buf = s_breadcrumb_slots_buf + index * s_breadcrumb_slot_size;
+  breadcrumb_t* breadcrumb = &slot->breadcrumb;
+  breadcrumb->hash = desc->hash;
+  if (name_size_bytes > s_breadcrumb_slot_size) {
+    memmove(buf, desc->name, s_breadcrumb_slot_size - 1);
+    buf[s_breadcrumb_slot_size - 1] = 0;
+    breadcrumb->crumb.name = buf;
+    breadcrumb->crumb.meta_keys = nullptr;
+    breadcrumb->crumb.meta_values = nullptr;
+    breadcrumb->crumb.meta_typed_values = nullptr;
+    breadcrumb->crumb.meta_count = 0;
+    breadcrumb->crumb.count = 1;
+    breadcrumb->crumb.loop_length = 0;
+    breadcrumb->crumb.loop_count = 0;
+    breadcrumb->crumb.first_timestamp = desc->timestamp;
+    breadcrumb->crumb.last_timestamp = desc->timestamp;
+    breadcrumb->crumb.channel = nullptr;
+    breadcrumb->buf_size = s_breadcrumb_slot_size;
+  }
+  else {
+    breadcrumb_write(buf, &breadcrumb->crumb, &fit_desc);
+    breadcrumb->buf_size = required_size;
+  }
+
+  // publish
+  slot->state.store(breadcrumb_slot_state(ticket), std::memory_order_release);
+}
+
+// Copies the newest crumbs out of the lock-free slots into `breadcrumbs` in order, along with their data into `buf`
+// (which holds a slot's worth of data per crumb). Writers keep going while this happens so each slot is validated
+// against its state after the copy. Slots that are being written are retried a few times and then skipped, as are
+// slots that were recycled for a newer crumb.
+static int breadcrumb_slots_gather(forensics_breadcrumb_t* breadcrumbs, char* buf) {
+  const uint64_t head = s_breadcrumb_slots_head.load(std::memory_order_acquire);
+  const uint64_t first = head > s_config.max_breadcrumb_count ? head - s_config.max_breadcrumb_count : 0;
+
+  int out_count = 0;
+  for (uint64_t ticket = first; ticket < head; ++ticket) {
+    const unsigned int index = (unsigned int)(ticket % s_config.max_breadcrumb_count);
+    breadcrumb_slot_t* slot = s_breadcrumb_slots + index;
+    const char* src = s_breadcrumb_slots_buf + index * s_breadcrumb_slot_size;
+    char* dst = buf + out_count * s_breadcrumb_slot_size;
+
+    for (int spin = 0; spin < BREADCRUMB_SLOT_SPIN_LIMIT; ++spin) {
+      const uint64_t state = slot->state.load(std::memory_order_acquire);
+      const uint64_t state_ticket = state >> BREADCRUMB_SLOT_TICKET_SHIFT;
+      if (state_ticket < ticket + 1 || (state_ticket == ticket + 1 && (state & BREADCRUMB_SLOT_OWNED) != 0)) {
+        // still being written (or not even claimed yet)
+        std::this_thread::yield();
+        continue;
+      }
+      if (state_ticket != ticket + 1) {
+        break;
+      }
+
+      forensics_breadcrumb_t crumb;
+      seqlock_copy(&crumb, &slot->breadcrumb.crumb, sizeof(crumb));
+      seqlock_copy(dst, src, s_breadcrumb_slot_size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->state.load(std::memory_order_relaxed) != state) {
+        continue;
+      }
+
+      breadcrumb_relocate(&crumb, src, dst, s_breadcrumb_slot_size);
+      breadcrumbs[out_count] = crumb;
+      ++out_count;
+      break;
+    }
+  }
+
+  return out_count;
+}
 
-struct context_buffer_t {
-  ~context_buffer_t();
+static void breadcrumb_channels_init() {
+  s_breadcrumb_channel_count = s_config.breadcrumb_channel_count;
+  s_breadcrumb_channels =
+      (breadcrumb_channel_t*)forensics_alloc(s_breadcrumb_channel_count * sizeof(breadcrumb_channel_t));
 
-  int count;
-  int capacity;
-  int overflow_count;
-  bool initialized;
-  const char** stack;
+  // copy all the names into a single buffer
+  unsigned int names_size_bytes = 0;
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    names_size_bytes += (unsigned int)strlen(s_config.breadcrumb_channels[index].name) + 1;
+  }
+  s_breadcrumb_channel_names_buf = (char*)forensics_alloc(names_size_bytes);
 
-  context_buffer_t* prev;
-  context_buffer_t* next;
-};
-struct breadcrumb_t {
-  forensics_breadcrumb_t crumb;
-  int buf_size;
-};
+  char* name = s_breadcrumb_channel_names_buf;
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    const forensics_breadcrumb_channel_config_t* channel_config = &s_config.breadcrumb_channels[index];
+    breadcrumb_channel_t* channel = new (s_breadcrumb_channels + index) breadcrumb_channel_t;
+    const unsigned int name_size_bytes = (unsigned int)strlen(channel_config->name) + 1;
+    memmove(name, channel_config->name, name_size_bytes);
+    channel->name = name;
+    channel->sequence.store(0, std::memory_order_relaxed);
+    name += name_size_bytes;
+    breadcrumb_ring_init(
+        &channel->ring, channel_config->max_breadcrumb_count, channel_config->breadcrumb_buf_size_bytes);
+  }
 
-static forensics_config_t s_config;
-thread_local static context_buffer_t s_tls_context_buf;
-static context_buffer_t* s_context_buf_list;
-static std::mutex s_context_buf_list_mutex;
+  // the config array is only borrowed for the call to `forensics_lib_init()`
+  s_config.breadcrumb_channels = nullptr;
+}
 
-static breadcrumb_t* s_breadcrumbs;
-static int s_breadcrumbs_index_next;
-static unsigned int s_breadcrumbs_count;
-static char* s_breadcrumbs_buf;
-static unsigned int s_breadcrumbs_buf_read_index;
-static unsigned int s_breadcrumbs_buf_write_index;
+static void breadcrumb_channels_destroy() {
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    breadcrumb_ring_destroy(&s_breadcrumb_channels[index].ring);
+    s_breadcrumb_channels[index].~breadcrumb_channel_t();
+  }
+  forensics_free(s_breadcrumb_channel_names_buf);
+  forensics_free(s_breadcrumb_channels);
+  s_breadcrumb_channel_names_buf = nullptr;
+  s_breadcrumb_channels = nullptr;
+  s_breadcrumb_channel_count = 0;
+}
 
-static char** s_attribute_keys;
-static char** s_attribute_values;
-static int s_attribute_count;
-static char* s_attribute_buf;
-static int s_attribute_buf_used;
+static void cpu_rings_init() {
+  s_cpu_ring_count = forensics_private_cpu_count();
+  s_cpu_rings_alloc = forensics_alloc(s_cpu_ring_count * sizeof(cpu_breadcrumb_ring_t) + CACHE_LINE_SIZE_BYTES);
+  const uintptr_t address = (uintptr_t)s_cpu_rings_alloc;
+  const uintptr_t aligned = (address + CACHE_LINE_SIZE_BYTES - 1) & ~(uintptr_t)(CACHE_LINE_SIZE_BYTES - 1);
+  s_cpu_rings = (cpu_breadcrumb_ring_t*)aligned;
+  for (unsigned int index = 0; index < s_cpu_ring_count; ++index) {
+    cpu_breadcrumb_ring_t* cpu_ring = new (s_cpu_rings + index) cpu_breadcrumb_ring_t;
+    cpu_ring->sequence.store(0, std::memory_order_relaxed);
+    breadcrumb_ring_init(&cpu_ring->ring, s_config.max_breadcrumb_count, s_config.breadcrumb_buf_size_bytes);
+  }
+}
 
-static void** s_backtrace_buf;
+static void cpu_rings_destroy() {
+  for (unsigned int index = 0; index < s_cpu_ring_count; ++index) {
+    breadcrumb_ring_destroy(&s_cpu_rings[index].ring);
+    s_cpu_rings[index].~cpu_breadcrumb_ring_t();
+  }
+  forensics_free(s_cpu_rings_alloc);
+  s_cpu_rings_alloc = nullptr;
+  s_cpu_rings = nullptr;
+  s_cpu_ring_count = 0;
+}
 
-static std::mutex s_report_mutex;
-static char* s_report_id;
-static char* s_report_formatted_msg;
-static forensics_breadcrumb_t* s_report_breadcrumbs;
+static bool breadcrumb_channel_is_valid(forensics_channel_t channel) {
+  return channel <= s_breadcrumb_channel_count;
+}
 
-static void panic() {
-  exit(EXIT_FAILURE);
+// Brackets a change to a ring that readers may be copying without taking its lock (see `breadcrumb_ring_snapshot()`).
+// Only one thread changes the ring at a time, so the sequence is odd exactly while the change is in progress.
+static void breadcrumb_sequence_begin(std::atomic<unsigned int>* sequence) {
+  sequence->store(sequence->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
 }
 
-static void* default_alloc(uintptr_t size, void* user_data, const char* file, int line, const char* func) {
-  return malloc(size);
+static void breadcrumb_sequence_end(std::atomic<unsigned int>* sequence) {
+  sequence->store(sequence->load(std::memory_order_relaxed) + 1, std::memory_order_release);
 }
 
-static void default_free(void* memory, void* user_data, const char* file, int line, const char* func) {
-  free(memory);
+// Adds one or more crumbs that all go to the same channel.
+static void breadcrumb_add(breadcrumb_desc_t* descs, int count) {
+  // do all the string scanning (and read the clock) before any locks are taken. A batch shares one timestamp.
+  const uint64_t timestamp = forensics_private_clock_ns();
+  for (int index = 0; index < count; ++index) {
+    breadcrumb_measure(&descs[index]);
+    descs[index].timestamp = timestamp;
+  }
+
+  // extra channels only contend with writers to the same channel
+  if (descs[0].channel != FORENSICS_CHANNEL_DEFAULT) {
+    breadcrumb_channel_t* channel = s_breadcrumb_channels + descs[0].channel - 1;
+    std::lock_guard<std::mutex> lock(channel->mutex);
+    breadcrumb_sequence_begin(&channel->sequence);
+    breadcrumb_ring_add_batch(&channel->ring, descs, count);
+    breadcrumb_sequence_end(&channel->sequence);
+    return;
+  }
+
+  switch (s_config.breadcrumb_mode) {
+    case FORENSICS_BREADCRUMB_MODE_GLOBAL: {
+      // allow multi-threaded access to this function and protect against the crash handler
+      std::lock_guard<std::mutex> lock(s_report_mutex);
+      breadcrumb_sequence_begin(s_breadcrumbs_sequence);
+      breadcrumb_ring_add_batch(s_breadcrumbs, descs, count);
+      breadcrumb_sequence_end(s_breadcrumbs_sequence);
+      break;
+    }
+    case FORENSICS_BREADCRUMB_MODE_PER_THREAD:
+      thread_ring_add(descs, count);
+      break;
+    case FORENSICS_BREADCRUMB_MODE_LOCK_FREE:
+      for (int index = 0; index < count; ++index) {
+        breadcrumb_slots_add(&descs[index]);
+      }
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_CPU: {
+      // CPU numbers aren't always dense, so fold any stragglers back onto the rings there are
+      cpu_breadcrumb_ring_t* cpu_ring = &s_cpu_rings[forensics_private_current_cpu() % s_cpu_ring_count];
+      std::lock_guard<std::mutex> lock(cpu_ring->mutex);
+      breadcrumb_sequence_begin(&cpu_ring->sequence);
+      breadcrumb_ring_add_batch(&cpu_ring->ring, descs, count);
+      breadcrumb_sequence_end(&cpu_ring->sequence);
+      break;
+    }
+  }
 }
 
-#define forensics_alloc(size) forensics_alloc_ex(size, __FILE__, __LINE__, __func__)
-#define forensics_free(ptr) forensics_free_ex(ptr, __FILE__, __LINE__, __func__)
+// Merges a channel's crumbs into the first `count` crumbs in `breadcrumbs`, which are already in time order. Both lists
+// are sorted, so the merge works from the back of the array and needs no extra storage.
+static int breadcrumbs_merge_channel(forensics_breadcrumb_t* breadcrumbs,
+                                     int count,
+                                     breadcrumb_ring_t* ring,
+                                     const char* channel_name) {
+  const unsigned int channel_count = breadcrumb_ring_report_count(ring);
+  const int total = count + (int)channel_count;
 
-static void* forensics_alloc_ex(uintptr_t size, const char* file, int line, const char* func) {
-  return s_config.alloc(size, s_config.alloc_user_data, file, line, func);
+  int index = count - 1;
+  unsigned int age = 0;
+  for (int out_index = total - 1; age < channel_count; --out_index) {
+    forensics_breadcrumb_t crumb = breadcrumb_ring_report_crumb(ring, age);
+    if (index >= 0 && breadcrumbs[index].first_timestamp > crumb.first_timestamp) {
+      breadcrumbs[out_index] = breadcrumbs[index];
+      --index;
+    }
+    else {
+      crumb.channel = channel_name;
+      breadcrumbs[out_index] = crumb;
+      ++age;
+    }
+  }
+  return total;
 }
 
-static void forensics_free_ex(void* memory, const char* file, int line, const char* func) {
-  s_config.free(memory, s_config.alloc_user_data, file, line, func);
+// Clamps the blocks of repeated crumbs to the crumbs in `breadcrumbs`. The start of a block may have been pushed out.
+static void breadcrumbs_clamp_loops(forensics_breadcrumb_t* breadcrumbs, int count) {
+  for (int index = 0; index < count; ++index) {
+    if (breadcrumbs[index].loop_length > index + 1) {
+      breadcrumbs[index].loop_length = index + 1;
+    }
+  }
+}
+
+// Returns true if a crumb has typed values that haven't been formatted as strings.
+static bool breadcrumb_has_unformatted_values(const forensics_breadcrumb_t* crumb) {
+  if (crumb->meta_typed_values == nullptr) {
+    return false;
+  }
+  for (int index = 0; index < crumb->meta_count; ++index) {
+    if (crumb->meta_typed_values[index].type != FORENSICS_VALUE_STRING) {
+      return true;
+    }
+  }
+  return false;
 }
 
-static int attribute_find(const char* key) {
-  for (int index = 0; index < s_attribute_count; ++index) {
-    if (0 == strcmp(key, s_attribute_keys[index])) {
-      return index;
+// Formats a crumb's typed values into `buf`. The crumb gets a value array of its own in `buf` too, so the array it
+// pointed at (which belongs to the ring it came from) is left alone. Values that don't fit are shown as "...".
+static void breadcrumb_format_values(forensics_breadcrumb_t* crumb,
+                                     char* buf,
+                                     unsigned int buf_size_bytes,
+                                     unsigned int* buf_used) {
+  if (!breadcrumb_has_unformatted_values(crumb)) {
+    return;
+  }
+  const unsigned int array_offset =
+      (*buf_used + (unsigned int)alignof(const char*) - 1) & ~((unsigned int)alignof(const char*) - 1);
+  const unsigned int array_size_bytes = (unsigned int)crumb->meta_count * (unsigned int)sizeof(const char*);
+  if (array_offset + array_size_bytes > buf_size_bytes) {
+    // the buffer is sized so this can't happen, but values without strings would be worse than no values
+    crumb->meta_count = 0;
+    crumb->meta_keys = nullptr;
+    crumb->meta_values = nullptr;
+    crumb->meta_typed_values = nullptr;
+    return;
+  }
+  const char** meta_values = (const char**)(buf + array_offset);
+  *buf_used = array_offset + array_size_bytes;
+
+  for (int index = 0; index < crumb->meta_count; ++index) {
+    const forensics_value_t* value = &crumb->meta_typed_values[index];
+    if (value->type == FORENSICS_VALUE_STRING) {
+      meta_values[index] = crumb->meta_values[index];
+      continue;
+    }
+    if (*buf_used + FORMATTED_VALUE_SIZE_BYTES > buf_size_bytes) {
+      meta_values[index] = "...";
+      continue;
     }
+    char* formatted = buf + *buf_used;
+    forensics_value_format(value, formatted, FORMATTED_VALUE_SIZE_BYTES);
+    meta_values[index] = formatted;
+    *buf_used += (unsigned int)strlen(formatted) + 1;
   }
-  return -1;
+  crumb->meta_values = meta_values;
 }
 
-static void attribute_clear(int index) {
-  char* key = s_attribute_keys[index];
-  char* value = s_attribute_values[index];
-  const int key_size_bytes = (int)strlen(key) + 1;
-  const int value_size_bytes = (int)strlen(value) + 1;
-  const int size_bytes = key_size_bytes + value_size_bytes;
+static void report_add_breadcrumb_span(forensics_report_t* report,
+                                       const forensics_breadcrumb_t* first,
+                                       int count,
+                                       int stride_bytes) {
+  if (count == 0) {
+    return;
+  }
+  forensics_breadcrumb_span_t* span = &report->breadcrumb_spans[report->breadcrumb_span_count++];
+  span->first = first;
+  span->count = count;
+  span->stride_bytes = stride_bytes;
+}
 
-  // fill in the hole in the buffer
-  const intptr_t key_offset = (intptr_t)(key - s_attribute_buf);
-  const intptr_t bytes_to_copy = s_attribute_buf_used - key_offset - size_bytes;
-  memcpy(key, key + size_bytes, bytes_to_copy);
+// Describes the crumbs in the global ring as they sit in the ring, rather than copying them out. Only the crumbs from a
+// partial pass through a repeated block, which aren't stored as crumbs of their own, and the oldest crumbs that need
+// their repeated block clamped are copied into the report buffer. They go at the position they would have in a flat
+// array so that flattening leaves them where they are.
+static void report_gather_ring_in_place(forensics_report_t* report, breadcrumb_ring_t* ring) {
+  const unsigned int count = ring->count;
+  const unsigned int pending = breadcrumb_ring_report_count(ring) - count;
+  report->breadcrumb_count = (int)(count + pending);
+  if (count == 0) {
+    return;
+  }
 
-  // fill in the hole in the pointers update the pointer dests
-  for (int fix_index = index + 1; fix_index < s_attribute_count; ++fix_index) {
-    const int dest_index = fix_index - 1;
-    s_attribute_keys[dest_index] = s_attribute_keys[fix_index] - size_bytes;
-    s_attribute_values[dest_index] = s_attribute_values[fix_index] - size_bytes;
+  // The start of a repeated block may have been pushed out of the ring. Blocks are short so only the oldest few crumbs
+  // can be affected. Those are clamped in copies at the front of the report buffer; the ring itself is left alone for
+  // the snapshot readers.
+  const unsigned int clamp_count =
+      count < s_config.max_breadcrumb_loop_length ? count : s_config.max_breadcrumb_loop_length;
+  unsigned int copy_count = 0;
+  for (unsigned int index = 0; index < clamp_count; ++index) {
+    if (breadcrumb_ring_newest(ring, count - 1 - index)->crumb.loop_length > (int)index + 1) {
+      copy_count = index + 1;
+    }
   }
-  --s_attribute_count;
+  for (unsigned int index = 0; index < copy_count; ++index) {
+    forensics_breadcrumb_t* crumb = &s_report_breadcrumbs[index];
+    *crumb = breadcrumb_ring_newest(ring, count - 1 - index)->crumb;
+    if (crumb->loop_length > (int)index + 1) {
+      crumb->loop_length = (int)index + 1;
+    }
+  }
+  report_add_breadcrumb_span(report, s_report_breadcrumbs, (int)copy_count, (int)sizeof(forensics_breadcrumb_t));
+
+  const unsigned int rest_count = count - copy_count;
+  const unsigned int oldest = (ring->index_next + ring->capacity - rest_count) % ring->capacity;
+  const unsigned int head_count = rest_count < ring->capacity - oldest ? rest_count : ring->capacity - oldest;
+  report_add_breadcrumb_span(report, &ring->breadcrumbs[oldest].crumb, (int)head_count, (int)sizeof(breadcrumb_t));
+  report_add_breadcrumb_span(
+      report, &ring->breadcrumbs[0].crumb, (int)(rest_count - head_count), (int)sizeof(breadcrumb_t));
+
+  for (unsigned int index = 0; index < pending; ++index) {
+    s_report_breadcrumbs[count + index] = breadcrumb_ring_report_crumb(ring, pending - 1 - index);
+  }
+  report_add_breadcrumb_span(report, s_report_breadcrumbs + count, (int)pending, (int)sizeof(forensics_breadcrumb_t));
 }
 
-static void attribute_append(const char* key, const char* value) {
-  FORENSICS_ASSERTF(s_attribute_count < (int)s_config.max_attribute_count,
-                    "Cannot set attribute because the attribute key array is full. Try increasing the size of "
-                    "max_attribute_count. key=%s value=%s",
-                    key,
-                    value);
+// Copies the current report's crumbs into `s_report_breadcrumbs` in order, if they aren't there already.
+static const forensics_breadcrumb_t* report_flatten_breadcrumbs(const forensics_report_t* report) {
+  if (report->breadcrumb_count == 0) {
+    return nullptr;
+  }
+  if (!s_report_breadcrumbs_flat) {
+    int out_index = 0;
+    for (int span_index = 0; span_index < report->breadcrumb_span_count; ++span_index) {
+      const forensics_breadcrumb_span_t* span = &report->breadcrumb_spans[span_index];
+      if (span->first != s_report_breadcrumbs + out_index) {
+        for (int index = 0; index < span->count; ++index) {
+          s_report_breadcrumbs[out_index + index] = *forensics_breadcrumb_span_at(span, index);
+        }
+      }
+      out_index += span->count;
+    }
+    s_report_breadcrumbs_flat = true;
+  }
+  return s_report_breadcrumbs;
+}
 
-  const int key_size_bytes = (int)strlen(key) + 1;
-  const int value_size_bytes = (int)strlen(value) + 1;
-  const int size_bytes = key_size_bytes + value_size_bytes;
+static size_t snapshot_align(size_t size) {
+  return (size + SNAPSHOT_ALIGNMENT - 1) & ~(size_t)(SNAPSHOT_ALIGNMENT - 1);
+}
 
-  const int avail = s_config.attribute_buf_size_bytes - s_attribute_buf_used;
-  FORENSICS_ASSERTF(avail >= size_bytes,
-                    "Cannot set attribute because the attribute buffer is full. Try increasing the size of "
-                    "attribute_buf_size_bytes. attribute=%s needed=%d avail=%d",
-                    key,
-                    size_bytes,
-                    avail);
+// Returns the space a copy of a ring takes in a snapshot buffer: its crumbs followed by its data.
+static size_t snapshot_ring_size(const breadcrumb_ring_t* ring) {
+  return snapshot_align(ring->capacity * sizeof(breadcrumb_t)) + snapshot_align(ring->buf_size_bytes);
+}
 
-  // copy in the string data
-  char* key_in_buf = s_attribute_buf + s_attribute_buf_used;
-  char* value_in_buf = key_in_buf + key_size_bytes;
-  memmove(key_in_buf, key, key_size_bytes);
-  memmove(value_in_buf, value, value_size_bytes);
-  s_attribute_buf_used += size_bytes;
+// Copies a ring into `storage` (see `snapshot_ring_size()`) without taking its lock and points `copy` at it. The copy
+// is thrown away and taken again if `sequence` shows that a writer changed the ring part way through. Returns false if
+// the writers never left the ring alone for long enough.
+static bool breadcrumb_ring_snapshot(const breadcrumb_ring_t* ring,
+                                     const std::atomic<unsigned int>* sequence,
+                                     breadcrumb_ring_t* copy,
+                                     char* storage) {
+  breadcrumb_t* breadcrumbs = (breadcrumb_t*)storage;
+  char* buf = storage + snapshot_align(ring->capacity * sizeof(breadcrumb_t));
+  for (int attempt = 0; attempt < SNAPSHOT_RETRY_LIMIT; ++attempt) {
+    const unsigned int before = sequence->load(std::memory_order_acquire);
+    if (before & 1) {
+      std::this_thread::yield();
+      continue;
+    }
+    seqlock_copy(copy, ring, sizeof(*copy));
+    seqlock_copy(breadcrumbs, ring->breadcrumbs, ring->capacity * sizeof(breadcrumb_t));
+    seqlock_copy(buf, ring->buf, ring->buf_size_bytes);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence->load(std::memory_order_relaxed) != before) {
+      continue;
+    }
 
-  // flesh out the KV pointers
-  s_attribute_keys[s_attribute_count] = key_in_buf;
-  s_attribute_values[s_attribute_count] = value_in_buf;
-  ++s_attribute_count;
+    copy->breadcrumbs = breadcrumbs;
+    copy->buf = buf;
+    copy->archive = nullptr;
+    for (unsigned int age = 0; age < copy->count; ++age) {
+      breadcrumb_relocate(&breadcrumb_ring_newest(copy, age)->crumb, ring->buf, buf, ring->buf_size_bytes);
+    }
+    return true;
+  }
+  return false;
 }
 
-static char* breadcrumb_buf_alloc(unsigned int size_bytes) {
-  unsigned int write_index = s_breadcrumbs_buf_write_index;
-  const unsigned int read_index = s_breadcrumbs_buf_read_index;
+static void report_gather_breadcrumbs(forensics_report_t* report) {
+  report->breadcrumb_span_count = 0;
+  s_report_breadcrumbs_flat = false;
+  report->archived_breadcrumb_count = 0;
+  if (s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_GLOBAL && s_breadcrumbs->archive != nullptr) {
+    report->archived_breadcrumb_count = (int)breadcrumb_archive_count(s_breadcrumbs->archive);
+  }
+
+  if (s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_GLOBAL && s_breadcrumb_channel_count == 0) {
+    report_gather_ring_in_place(report, s_breadcrumbs);
 
-  // check if the write head will pass the read head
-  if ((write_index < read_index) && (write_index + size_bytes > read_index)) {
-    return nullptr;
+    // Formatting typed values means pointing the crumbs at value arrays of the report's own, which can't be done to
+    // crumbs that are still in the ring. Those reports copy the crumbs out instead.
+    bool has_unformatted_values = false;
+    for (int span_index = 0; span_index < report->breadcrumb_span_count && !has_unformatted_values; ++span_index) {
+      const forensics_breadcrumb_span_t* span = &report->breadcrumb_spans[span_index];
+      for (int crumb_index = 0; crumb_index < span->count && !has_unformatted_values; ++crumb_index) {
+        has_unformatted_values = breadcrumb_has_unformatted_values(forensics_breadcrumb_span_at(span, crumb_index));
+      }
+    }
+    if (has_unformatted_values) {
+      report_flatten_breadcrumbs(report);
+      report->breadcrumb_span_count = 0;
+      report_add_breadcrumb_span(
+          report, s_report_breadcrumbs, report->breadcrumb_count, (int)sizeof(forensics_breadcrumb_t));
+    }
   }
+  else {
+    // The per-CPU rings and the channels are copied rather than locked, so the report handler never runs while holding
+    // a writer's lock. A ring that writers never leave alone for long enough (e.g. one that the crashing thread was
+    // part way through writing to) is left out.
+    char* ring_storage = s_report_ring_storage;
+    switch (s_config.breadcrumb_mode) {
+      case FORENSICS_BREADCRUMB_MODE_GLOBAL: {
+        const unsigned int count = breadcrumb_ring_report_count(s_breadcrumbs);
+        report->breadcrumb_count = (int)count;
+        for (unsigned int index = 0; index < count; ++index) {
+          s_report_breadcrumbs[index] = breadcrumb_ring_report_crumb(s_breadcrumbs, count - 1 - index);
+        }
+        break;
+      }
+      case FORENSICS_BREADCRUMB_MODE_PER_THREAD:
+        report->breadcrumb_count = thread_rings_merge();
+        break;
+      case FORENSICS_BREADCRUMB_MODE_LOCK_FREE:
+        report->breadcrumb_count = breadcrumb_slots_gather(s_report_breadcrumbs, s_report_breadcrumbs_buf);
+        break;
+      case FORENSICS_BREADCRUMB_MODE_PER_CPU:
+        report->breadcrumb_count = 0;
+        for (unsigned int index = 0; index < s_cpu_ring_count; ++index) {
+          cpu_breadcrumb_ring_t* cpu_ring = &s_cpu_rings[index];
+          breadcrumb_ring_t ring;
+          if (breadcrumb_ring_snapshot(&cpu_ring->ring, &cpu_ring->sequence, &ring, ring_storage)) {
+            report->breadcrumb_count =
+                breadcrumbs_merge_channel(s_report_breadcrumbs, report->breadcrumb_count, &ring, nullptr);
+          }
+          ring_storage += snapshot_ring_size(&cpu_ring->ring);
+        }
+        break;
+    }
 
-  // wrap around if needed
-  if (write_index + size_bytes > s_config.breadcrumb_buf_size_bytes) {
-    write_index = 0;
+    for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+      breadcrumb_channel_t* channel = &s_breadcrumb_channels[index];
+      breadcrumb_ring_t ring;
+      if (breadcrumb_ring_snapshot(&channel->ring, &channel->sequence, &ring, ring_storage)) {
+        report->breadcrumb_count =
+            breadcrumbs_merge_channel(s_report_breadcrumbs, report->breadcrumb_count, &ring, channel->name);
+      }
+      ring_storage += snapshot_ring_size(&channel->ring);
+    }
+    breadcrumbs_clamp_loops(s_report_breadcrumbs, report->breadcrumb_count);
 
-    // check again if the write head will pass the read head
-    if (size_bytes > read_index) {
+    report_add_breadcrumb_span(
+        report, s_report_breadcrumbs, report->breadcrumb_count, (int)sizeof(forensics_breadcrumb_t));
+    s_report_breadcrumbs_flat = true;
+  }
+
+  // Format the typed values now that they are needed. Any crumb with values to format is a copy of the report's own by
+  // now, so it can be pointed at the formatted strings.
+  unsigned int values_buf_used = 0;
+  for (int span_index = 0; span_index < report->breadcrumb_span_count; ++span_index) {
+    const forensics_breadcrumb_span_t* span = &report->breadcrumb_spans[span_index];
+    for (int crumb_index = 0; crumb_index < span->count; ++crumb_index) {
+      breadcrumb_format_values((forensics_breadcrumb_t*)forensics_breadcrumb_span_at(span, crumb_index),
+                               s_report_breadcrumb_values_buf,
+                               s_report_breadcrumb_values_buf_size,
+                               &values_buf_used);
+    }
+  }
+
+  if (s_config.flatten_report_breadcrumbs || s_report_breadcrumbs_flat) {
+    report->breadcrumbs = report_flatten_breadcrumbs(report);
+  }
+  else {
+    report->breadcrumbs = nullptr;
+  }
+}
+
+// Lays out a snapshot buffer. Any of the pointers may be null to only measure it. Returns the size of the buffer.
+static size_t snapshot_layout(char* buf,
+                              char** default_storage,
+                              char** channel_storage,
+                              forensics_breadcrumb_t** breadcrumbs,
+                              char** values_buf) {
+  size_t size = 0;
+  auto reserve = [&](char** ptr, size_t size_bytes) {
+    if (ptr != nullptr) {
+      *ptr = buf + size;
+    }
+    size += snapshot_align(size_bytes);
+  };
+
+  switch (s_config.breadcrumb_mode) {
+    case FORENSICS_BREADCRUMB_MODE_GLOBAL:
+      reserve(default_storage, snapshot_ring_size(s_breadcrumbs));
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_THREAD:
+      reserve(default_storage, 0);
+      break;
+    case FORENSICS_BREADCRUMB_MODE_LOCK_FREE:
+      reserve(default_storage, s_breadcrumb_slot_size * s_config.max_breadcrumb_count);
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_CPU: {
+      size_t cpu_rings_size_bytes = 0;
+      for (unsigned int index = 0; index < s_cpu_ring_count; ++index) {
+        cpu_rings_size_bytes += snapshot_ring_size(&s_cpu_rings[index].ring);
+      }
+      reserve(default_storage, cpu_rings_size_bytes);
+      break;
+    }
+  }
+  size_t channels_size_bytes = 0;
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    channels_size_bytes += snapshot_ring_size(&s_breadcrumb_channels[index].ring);
+  }
+  reserve(channel_storage, channels_size_bytes);
+  char* breadcrumbs_storage;
+  reserve(&breadcrumbs_storage, s_report_breadcrumb_capacity * sizeof(forensics_breadcrumb_t));
+  if (breadcrumbs != nullptr) {
+    *breadcrumbs = (forensics_breadcrumb_t*)breadcrumbs_storage;
+  }
+  reserve(values_buf, s_report_breadcrumb_values_buf_size);
+  return size;
+}
+
+// Keeps the per-thread rings stable while a report is built and handled. Only a thread that exits in the meantime waits
+// for the report (so its ring outlives the report); adding a crumb never does. The per-CPU rings and the channels are
+// copied for the report instead (see `report_gather_breadcrumbs()`).
+struct report_breadcrumb_lock_t {
+  report_breadcrumb_lock_t()
+      : list_lock(s_breadcrumb_ring_list_mutex, std::defer_lock) {
+    if (s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_PER_THREAD) {
+      list_lock.lock();
+      thread_rings_pause();
+    }
+  }
+  ~report_breadcrumb_lock_t() {
+    if (list_lock.owns_lock()) {
+      thread_rings_resume();
+    }
+  }
+
+  std::unique_lock<std::mutex> list_lock;
+};
+
+static size_t store_align(size_t size) {
+  return (size + CACHE_LINE_SIZE_BYTES - 1) & ~(size_t)(CACHE_LINE_SIZE_BYTES - 1);
+}
+
+static bool store_region_is_valid(uint64_t offset, uint64_t region_size_bytes, uint64_t size_bytes) {
+  return offset <= size_bytes && region_size_bytes <= size_bytes - offset;
+}
+
+// Reads the file left at `path` by a previous run, if there is one, so it can be reported once the library is set up.
+static void store_load_previous_run(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    return;
+  }
+  if (fseek(file, 0, SEEK_END) == 0) {
+    const long size_bytes = ftell(file);
+    if (size_bytes >= (long)sizeof(persistent_store_t) && fseek(file, 0, SEEK_SET) == 0) {
+      char* data = (char*)forensics_alloc((size_t)size_bytes);
+      if (fread(data, 1, (size_t)size_bytes, file) == (size_t)size_bytes) {
+        s_store_previous_run = data;
+        s_store_previous_run_size_bytes = (size_t)size_bytes;
+      }
+      else {
+        forensics_free(data);
+      }
+    }
+  }
+  fclose(file);
+}
+
+// Maps the persistent store at `path` and lays out the global ring and the attribute buffer in it. Leaves `s_store`
+// null if the file can't be mapped, in which case they are allocated as usual.
+static void store_open(const char* path) {
+  const bool global = s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_GLOBAL;
+  const unsigned int breadcrumb_capacity = global ? s_config.max_breadcrumb_count : 0;
+  const unsigned int breadcrumb_buf_size_bytes = global ? s_config.breadcrumb_buf_size_bytes : 0;
+  const size_t breadcrumbs_offset = store_align(sizeof(persistent_store_t));
+  const size_t breadcrumb_buf_offset = breadcrumbs_offset + store_align(breadcrumb_capacity * sizeof(breadcrumb_t));
+  const size_t attribute_buf_offset = breadcrumb_buf_offset + store_align(breadcrumb_buf_size_bytes);
+  const size_t size_bytes = attribute_buf_offset + store_align(s_config.attribute_buf_size_bytes);
+
+  char* base = (char*)forensics_private_map_file(path, size_bytes);
+  if (base == nullptr) {
+    return;
+  }
+  memset(base, 0, size_bytes);
+
+  persistent_store_t* store = new (base) persistent_store_t;
+  memcpy(store->magic, STORE_MAGIC, sizeof(store->magic));
+  store->version = STORE_VERSION;
+  store->header_size_bytes = sizeof(persistent_store_t);
+  store->breadcrumb_size_bytes = sizeof(breadcrumb_t);
+  store->pointer_size_bytes = sizeof(void*);
+  store->size_bytes = size_bytes;
+  store->address = (uint64_t)(uintptr_t)base;
+  store->state.store(STORE_STATE_RUNNING, std::memory_order_relaxed);
+
+  breadcrumb_ring_init_in(&store->breadcrumbs,
+                          breadcrumb_capacity,
+                          (breadcrumb_t*)(base + breadcrumbs_offset),
+                          breadcrumb_buf_size_bytes,
+                          base + breadcrumb_buf_offset);
+  store->breadcrumbs_sequence.store(0, std::memory_order_relaxed);
+  store->breadcrumbs_offset = (uint32_t)breadcrumbs_offset;
+  store->breadcrumb_buf_offset = (uint32_t)breadcrumb_buf_offset;
+
+  store->attribute_buf_offset = (uint32_t)attribute_buf_offset;
+  store->attribute_buf_size_bytes = s_config.attribute_buf_size_bytes;
+  store->attribute_buf_used = 0;
+  store->attribute_count = 0;
+
+  s_store = store;
+  s_store_size_bytes = size_bytes;
+}
+
+static void store_close() {
+  if (s_store == nullptr) {
+    return;
+  }
+  s_store->state.store(STORE_STATE_SHUT_DOWN, std::memory_order_relaxed);
+  s_store->~persistent_store_t();
+  forensics_private_unmap_file(s_store, s_store_size_bytes);
+  s_store = nullptr;
+  s_store_size_bytes = 0;
+}
+
+static void store_set_state(store_state_t state) {
+  if (s_store != nullptr) {
+    s_store->state.store(state, std::memory_order_relaxed);
+  }
+}
+
+static void store_sync_attributes() {
+  if (s_store != nullptr) {
+    s_store->attribute_buf_used = (uint32_t)s_attribute_buf_used;
+    s_store->attribute_count = (uint32_t)s_attribute_count;
+  }
+}
+
+// Checks that a crumb read back from a previous run only points into its own data, which was at `src` and is now at
+// `dst`, and re-points it there. Names and keys that point anywhere else were interned, and the interned strings didn't
+// survive the run. Returns false if the crumb can't be trusted.
+static bool store_recover_crumb(forensics_breadcrumb_t* crumb, uint64_t src, char* dst, unsigned int size_bytes) {
+  auto local = [=](const void* ptr, size_t region_size_bytes, size_t alignment) -> char* {
+    const uint64_t address = (uint64_t)(uintptr_t)ptr;
+    if (address < src || !store_region_is_valid(address - src, region_size_bytes, size_bytes)) {
       return nullptr;
     }
+    char* result = dst + (address - src);
+    return (uintptr_t)result % alignment == 0 ? result : nullptr;
+  };
+  auto recover_string = [=](const char** str, bool may_be_interned) -> bool {
+    char* ptr = local(*str, 1, 1);
+    if (ptr == nullptr) {
+      *str = "<interned>";
+      return may_be_interned;
+    }
+    *str = ptr;
+    return memchr(ptr, 0, size_bytes - (ptr - dst)) != nullptr;
+  };
+
+  crumb->channel = nullptr;
+  if (!recover_string(&crumb->name, true)) {
+    return false;
+  }
+  if (crumb->meta_count <= 0) {
+    crumb->meta_count = 0;
+    crumb->meta_keys = nullptr;
+    crumb->meta_values = nullptr;
+    crumb->meta_typed_values = nullptr;
+    return true;
+  }
+
+  const size_t meta_count = (size_t)crumb->meta_count;
+  const char** meta_keys = (const char**)local(crumb->meta_keys, meta_count * sizeof(char*), alignof(char*));
+  const char** meta_values = (const char**)local(crumb->meta_values, meta_count * sizeof(char*), alignof(char*));
+  forensics_value_t* meta_typed_values = nullptr;
+  if (crumb->meta_typed_values != nullptr) {
+    meta_typed_values = (forensics_value_t*)local(
+        crumb->meta_typed_values, meta_count * sizeof(forensics_value_t), alignof(forensics_value_t));
+    if (meta_typed_values == nullptr) {
+      return false;
+    }
+  }
+  if (meta_keys == nullptr || meta_values == nullptr) {
+    return false;
+  }
+  crumb->meta_keys = meta_keys;
+  crumb->meta_values = meta_values;
+  crumb->meta_typed_values = meta_typed_values;
+
+  for (size_t index = 0; index < meta_count; ++index) {
+    if (!recover_string(&meta_keys[index], true)) {
+      return false;
+    }
+    if (meta_typed_values == nullptr) {
+      if (!recover_string(&meta_values[index], false)) {
+        return false;
+      }
+    }
+    else if (meta_typed_values[index].type == FORENSICS_VALUE_STRING) {
+      if (!recover_string(&meta_typed_values[index].as.str, false)) {
+        return false;
+      }
+      meta_values[index] = meta_typed_values[index].as.str;
+    }
+    else if ((unsigned int)meta_typed_values[index].type > FORENSICS_VALUE_BOOL) {
+      return false;
+    }
+    else {
+      // formatted along with the rest of the report
+      meta_values[index] = "";
+    }
+  }
+  return true;
+}
+
+// Copies the crumbs out of the global ring in a previous run's store into a new array, leaving out any that can't be
+// trusted. Returns the number of crumbs.
+static int store_recover_breadcrumbs(persistent_store_t* store,
+                                     char* data,
+                                     size_t size_bytes,
+                                     forensics_breadcrumb_t** out_breadcrumbs,
+                                     char** out_values_buf) {
+  breadcrumb_ring_t ring = store->breadcrumbs;
+  const bool valid =
+      ring.capacity > 0 &&
+      store_region_is_valid(store->breadcrumbs_offset, (uint64_t)ring.capacity * sizeof(breadcrumb_t), size_bytes) &&
+      store_region_is_valid(store->breadcrumb_buf_offset, ring.buf_size_bytes, size_bytes) &&
+      ring.count <= ring.capacity && ring.index_next < ring.capacity && ring.loop_length <= ring.count &&
+      (ring.loop_length == 0 || ring.loop_progress < ring.loop_length);
+  if (!valid) {
+    return 0;
+  }
+  ring.breadcrumbs = (breadcrumb_t*)(data + store->breadcrumbs_offset);
+  ring.buf = data + store->breadcrumb_buf_offset;
+  ring.archive = nullptr;
+
+  // the newest crumb may be torn if the run ended while it was being written
+  const unsigned int torn_count = (store->breadcrumbs_sequence.load(std::memory_order_relaxed) & 1) != 0 ? 1 : 0;
+  const uint64_t buf_address = store->address + store->breadcrumb_buf_offset;
+  for (unsigned int age = 0; age < ring.count; ++age) {
+    breadcrumb_t* breadcrumb = breadcrumb_ring_newest(&ring, age);
+    if (age < torn_count ||
+        !store_region_is_valid(breadcrumb->buf_offset, breadcrumb->buf_size, ring.buf_size_bytes) ||
+        !store_recover_crumb(&breadcrumb->crumb,
+                             buf_address + breadcrumb->buf_offset,
+                             ring.buf + breadcrumb->buf_offset,
+                             breadcrumb->buf_size)) {
+      breadcrumb->crumb.name = nullptr;
+    }
+  }
+
+  const unsigned int report_count = breadcrumb_ring_report_count(&ring);
+  forensics_breadcrumb_t* breadcrumbs =
+      (forensics_breadcrumb_t*)forensics_alloc(report_count * sizeof(forensics_breadcrumb_t));
+  int count = 0;
+  for (unsigned int age = report_count; age > 0; --age) {
+    const forensics_breadcrumb_t crumb = breadcrumb_ring_report_crumb(&ring, age - 1);
+    if (crumb.name != nullptr) {
+      breadcrumbs[count++] = crumb;
+    }
   }
+  breadcrumbs_clamp_loops(breadcrumbs, count);
 
-  s_breadcrumbs_buf_write_index = write_index + size_bytes;
-  return s_breadcrumbs_buf + write_index;
+  // room for the crumbs' value arrays as well as the strings, as in a report
+  const unsigned int values_buf_size_bytes = 2 * ring.buf_size_bytes;
+  char* values_buf = (char*)forensics_alloc(values_buf_size_bytes);
+  unsigned int values_buf_used = 0;
+  for (int index = 0; index < count; ++index) {
+    breadcrumb_format_values(&breadcrumbs[index], values_buf, values_buf_size_bytes, &values_buf_used);
+  }
+
+  *out_breadcrumbs = breadcrumbs;
+  *out_values_buf = values_buf;
+  return count;
 }
 
-static void breadcrumb_deque() {
-  const int first_index =
-      (s_breadcrumbs_index_next + s_config.max_breadcrumb_count - s_breadcrumbs_count) % s_config.max_breadcrumb_count;
-  breadcrumb_t* breadcrumb = s_breadcrumbs + first_index;
+// Passes the store left by the previous run to `previous_run_handler` if the run ended without a report, then lets it
+// go. Anything in the file that doesn't check out is left out of the report.
+static void store_report_previous_run() {
+  char* data = s_store_previous_run;
+  const size_t size_bytes = s_store_previous_run_size_bytes;
+  s_store_previous_run = nullptr;
+  s_store_previous_run_size_bytes = 0;
+  if (data == nullptr) {
+    return;
+  }
+
+  persistent_store_t* store = (persistent_store_t*)data;
+  const bool valid = 0 == memcmp(store->magic, STORE_MAGIC, sizeof(store->magic)) &&
+                     store->version == STORE_VERSION && store->header_size_bytes == sizeof(persistent_store_t) &&
+                     store->breadcrumb_size_bytes == sizeof(breadcrumb_t) &&
+                     store->pointer_size_bytes == sizeof(void*) && store->size_bytes <= size_bytes;
+  if (!valid || s_config.previous_run_handler == nullptr ||
+      store->state.load(std::memory_order_relaxed) != STORE_STATE_RUNNING) {
+    forensics_free(data);
+    return;
+  }
 
-  // free the ring buffer space
-  s_breadcrumbs_buf_read_index += breadcrumb->buf_size;
-  if (s_breadcrumbs_buf_read_index >= s_config.breadcrumb_buf_size_bytes) {
-    s_breadcrumbs_buf_read_index = 0;
-    if (s_breadcrumbs_buf_write_index >= s_config.breadcrumb_buf_size_bytes) {
-      s_breadcrumbs_buf_write_index = 0;
+  forensics_report_t report;
+  report.id = "previous-run";
+  report.file = "";
+  report.line = 0;
+  report.func = "";
+  report.expression = "";
+  report.format = "The previous run ended without a report";
+  report.formatted = report.format;
+  report.fatal = true;
+  report.timestamp = 0;
+  report.context_stack = nullptr;
+  report.context_hashes = nullptr;
+  report.context_count = 0;
+  report.backtrace = nullptr;
+  report.backtrace_count = 0;
+
+  // the attributes are in the live blocks of their buffer
+  const char** attribute_keys = nullptr;
+  const char** attribute_values = nullptr;
+  forensics_value_t* attribute_typed_values = nullptr;
+  int attribute_count = 0;
+  if (store->attribute_buf_used <= store->attribute_buf_size_bytes &&
+      store_region_is_valid(store->attribute_buf_offset, store->attribute_buf_used, store->size_bytes)) {
+    const uint32_t max_count = store->attribute_buf_used / ATTRIBUTE_BLOCK_MIN_SIZE_BYTES;
+    attribute_keys = (const char**)forensics_alloc(max_count * sizeof(const char*));
+    attribute_values = (const char**)forensics_alloc(max_count * sizeof(const char*));
+    attribute_typed_values = (forensics_value_t*)forensics_alloc(max_count * sizeof(forensics_value_t));
+    const char* ptr = data + store->attribute_buf_offset;
+    const char* end = ptr + store->attribute_buf_used;
+    while ((size_t)(end - ptr) >= sizeof(attribute_block_t)) {
+      attribute_block_t block;
+      memcpy(&block, ptr, sizeof(block));
+      if (block.size_bytes < ATTRIBUTE_BLOCK_MIN_SIZE_BYTES || block.size_bytes % ATTRIBUTE_BLOCK_MIN_SIZE_BYTES != 0 ||
+          block.size_bytes > (size_t)(end - ptr)) {
+        break;
+      }
+      const char* key = ptr + sizeof(attribute_block_t);
+      const char* block_end = ptr + block.size_bytes;
+      const char* key_end = (const char*)memchr(key, 0, block_end - key);
+      const char* value_end =
+          key_end != nullptr ? (const char*)memchr(key_end + 1, 0, block_end - key_end - 1) : nullptr;
+      if (block.state == ATTRIBUTE_BLOCK_LIVE && value_end != nullptr) {
+        attribute_keys[attribute_count] = key;
+        attribute_values[attribute_count] = key_end + 1;
+        attribute_typed_values[attribute_count] = forensics_value_str(key_end + 1);
+        ++attribute_count;
+      }
+      ptr = block_end;
     }
   }
+  report.attribute_keys = attribute_count > 0 ? attribute_keys : nullptr;
+  report.attribute_values = attribute_count > 0 ? attribute_values : nullptr;
+  report.attribute_typed_values = attribute_count > 0 ? attribute_typed_values : nullptr;
+  report.attribute_count = attribute_count;
 
-  // clear out the breadcrumb struct
-  breadcrumb->crumb.name = nullptr;
-  breadcrumb->crumb.meta_keys = nullptr;
-  breadcrumb->crumb.meta_values = nullptr;
-  breadcrumb->crumb.meta_count = 0;
-  breadcrumb->crumb.count = 0;
-  breadcrumb->buf_size = 0;
+  forensics_breadcrumb_t* breadcrumbs = nullptr;
+  char* values_buf = nullptr;
+  report.breadcrumb_count = store_recover_breadcrumbs(store, data, store->size_bytes, &breadcrumbs, &values_buf);
+  report.breadcrumbs = report.breadcrumb_count > 0 ? breadcrumbs : nullptr;
+  report.breadcrumb_span_count = 0;
+  report_add_breadcrumb_span(&report, breadcrumbs, report.breadcrumb_count, (int)sizeof(forensics_breadcrumb_t));
+  report.archived_breadcrumb_count = 0;
+  if (report.breadcrumb_count > 0) {
+    report.timestamp = breadcrumbs[report.breadcrumb_count - 1].last_timestamp;
+  }
 
-  // forget about the breadcrumb
-  --s_breadcrumbs_count;
+  s_config.previous_run_handler(&report);
+
+  if (breadcrumbs != nullptr) {
+    forensics_free(values_buf);
+    forensics_free(breadcrumbs);
+  }
+  if (attribute_keys != nullptr) {
+    forensics_free(attribute_typed_values);
+    forensics_free(attribute_values);
+    forensics_free(attribute_keys);
+  }
+  forensics_free(data);
 }
 
 static void context_buffer_init(context_buffer_t* ctx_buf) {
   std::lock_guard<std::mutex> lock(s_context_buf_list_mutex);
 
-  ctx_buf->count = 0;
-  ctx_buf->capacity = s_config.max_context_depth;
-  ctx_buf->overflow_count = 0;
   ctx_buf->initialized = true;
-  ctx_buf->stack = (const char**)forensics_alloc(sizeof(const char*) * s_config.max_context_depth);
+  ctx_buf->stack = &forensics_private_context_stack;
+  ctx_buf->stack->names = (const char**)forensics_alloc(sizeof(const char*) * s_config.max_context_depth);
+  ctx_buf->stack->hashes = (uint64_t*)forensics_alloc(sizeof(uint64_t) * s_config.max_context_depth);
+  ctx_buf->stack->count = 0;
+  ctx_buf->stack->capacity = (int)s_config.max_context_depth;
+  ctx_buf->stack->overflow_count = 0;
+  ctx_buf->attribute_count = 0;
+  ctx_buf->attribute_overflow_count = 0;
+  ctx_buf->attribute_keys = (char**)forensics_alloc(sizeof(char*) * s_config.max_thread_attribute_count);
+  ctx_buf->attribute_values = (char**)forensics_alloc(sizeof(char*) * s_config.max_thread_attribute_count);
+  ctx_buf->attribute_buf = (char*)forensics_alloc(s_config.thread_attribute_buf_size_bytes);
+  ctx_buf->attribute_buf_used = 0;
   ctx_buf->next = nullptr;
   ctx_buf->prev = nullptr;
 
@@ -222,8 +3201,21 @@ static void context_buffer_destroy(context_buffer_t* ctx_buf) {
 
   // handle multiple destroys (could be both explicit and implied from the destructor)
   if (ctx_buf->initialized) {
-    forensics_free(ctx_buf->stack);
+    forensics_free(ctx_buf->stack->hashes);
+    forensics_free(ctx_buf->stack->names);
+    forensics_free(ctx_buf->attribute_buf);
+    forensics_free(ctx_buf->attribute_values);
+    forensics_free(ctx_buf->attribute_keys);
+    ctx_buf->stack->names = nullptr;
+    ctx_buf->stack->hashes = nullptr;
+    ctx_buf->stack->count = 0;
+    ctx_buf->stack->capacity = 0;
+    ctx_buf->stack->overflow_count = 0;
     ctx_buf->stack = nullptr;
+    ctx_buf->attribute_buf = nullptr;
+    ctx_buf->attribute_values = nullptr;
+    ctx_buf->attribute_keys = nullptr;
+    ctx_buf->attribute_count = 0;
     ctx_buf->initialized = false;
 
     // remove the context buffer from the linked list
@@ -250,6 +3242,75 @@ context_buffer_t::~context_buffer_t() {
   context_buffer_destroy(this);
 }
 
+// Returns the handle of an interned string, or `FORENSICS_STRING_INVALID` with the empty slot it would go in. Slots are
+// only ever filled in (until shutdown), so this is safe without the lock.
+static forensics_string_t interned_string_find(const char* str, uint64_t hash, unsigned int* out_slot) {
+  unsigned int slot = (unsigned int)hash & s_interned_string_table_mask;
+  for (;;) {
+    const forensics_string_t handle = s_interned_string_table[slot].load(std::memory_order_acquire);
+    if (handle == FORENSICS_STRING_INVALID) {
+      *out_slot = slot;
+      return FORENSICS_STRING_INVALID;
+    }
+    if (s_interned_string_hashes[handle - 1] == hash && 0 == strcmp(s_interned_strings[handle - 1], str)) {
+      return handle;
+    }
+    slot = (slot + 1) & s_interned_string_table_mask;
+  }
+}
+
+// Interns `str` like `forensics_intern_string()`. When the table is full it returns `FORENSICS_STRING_INVALID`, and
+// only asserts if `assert_if_full` is set.
+static forensics_string_t intern_string(const char* str, bool assert_if_full) {
+  // reuse an existing copy
+  unsigned int size_bytes = 0;
+  const uint64_t hash = hash_string(str, &size_bytes);
+  unsigned int slot;
+  forensics_string_t handle = interned_string_find(str, hash, &slot);
+  if (handle != FORENSICS_STRING_INVALID) {
+    return handle;
+  }
+
+  // another thread may have added it before the lock was taken. The lock is let go before asserting, since a report
+  // handler may intern strings itself.
+  std::unique_lock<std::mutex> lock(s_interned_string_mutex);
+  handle = interned_string_find(str, hash, &slot);
+  if (handle != FORENSICS_STRING_INVALID) {
+    return handle;
+  }
+  const unsigned int count = s_interned_string_count.load(std::memory_order_relaxed);
+  if (count == s_config.max_interned_string_count) {
+    lock.unlock();
+    FORENSICS_ASSERTF(!assert_if_full,
+                      "Cannot intern string because the interned string array is full. Try increasing the size of "
+                      "max_interned_string_count. string=%s",
+                      str);
+    return FORENSICS_STRING_INVALID;
+  }
+  const unsigned int avail = s_config.interned_string_buf_size_bytes - s_interned_string_buf_used;
+  if (avail < size_bytes) {
+    lock.unlock();
+    FORENSICS_ASSERTF(!assert_if_full,
+                      "Cannot intern string because the interned string buffer is full. Try increasing the size of "
+                      "interned_string_buf_size_bytes. string=%s needed=%u avail=%u",
+                      str,
+                      size_bytes,
+                      avail);
+    return FORENSICS_STRING_INVALID;
+  }
+
+  // copy in the string and publish it to lock-free readers
+  char* str_in_buf = s_interned_string_buf + s_interned_string_buf_used;
+  memmove(str_in_buf, str, size_bytes);
+  s_interned_string_buf_used += size_bytes;
+  s_interned_strings[count] = str_in_buf;
+  s_interned_string_hashes[count] = hash;
+  handle = (forensics_string_t)(count + 1);
+  s_interned_string_count.store(handle, std::memory_order_release);
+  s_interned_string_table[slot].store(handle, std::memory_order_release);
+  return handle;
+}
+
 void forensics_config_init(forensics_config_t* config) {
   if (config != nullptr) {
     config->fatal_should_halt = true;
@@ -259,9 +3320,29 @@ void forensics_config_init(forensics_config_t* config) {
     config->max_formatted_message_size_bytes = DEFAULT_MAX_FORMATTED_MESSAGE_SIZE_BYTES;
     config->max_attribute_count = DEFAULT_MAX_ATTRIBUTE_COUNT;
     config->attribute_buf_size_bytes = DEFAULT_ATTRIBUTE_BUF_SIZE_BYTES;
+    config->max_registered_attribute_count = DEFAULT_MAX_REGISTERED_ATTRIBUTE_COUNT;
+    config->relaxed_attribute_handles = false;
+    config->max_numeric_attribute_count = DEFAULT_MAX_NUMERIC_ATTRIBUTE_COUNT;
+    config->max_attribute_provider_count = DEFAULT_MAX_ATTRIBUTE_PROVIDER_COUNT;
+    config->attribute_provider_value_size_bytes = DEFAULT_ATTRIBUTE_PROVIDER_VALUE_SIZE_BYTES;
+    config->max_thread_attribute_count = DEFAULT_MAX_THREAD_ATTRIBUTE_COUNT;
+    config->thread_attribute_buf_size_bytes = DEFAULT_THREAD_ATTRIBUTE_BUF_SIZE_BYTES;
     config->max_backtrace_count = DEFAULT_MAX_BACKTRACE_COUNT;
     config->max_breadcrumb_count = DEFAULT_MAX_BREADCRUMB_COUNT;
     config->breadcrumb_buf_size_bytes = DEFAULT_BREADCRUMB_BUF_SIZE_BYTES;
+    config->breadcrumb_mode = FORENSICS_BREADCRUMB_MODE_GLOBAL;
+    config->breadcrumb_slot_size_bytes = DEFAULT_BREADCRUMB_SLOT_SIZE_BYTES;
+    config->max_breadcrumb_loop_length = DEFAULT_MAX_BREADCRUMB_LOOP_LENGTH;
+    config->breadcrumb_channels = nullptr;
+    config->breadcrumb_channel_count = 0;
+    config->breadcrumb_archive_size_bytes = 0;
+    config->breadcrumb_archive_block_size_bytes = DEFAULT_BREADCRUMB_ARCHIVE_BLOCK_SIZE_BYTES;
+    config->breadcrumb_level = FORENSICS_BREADCRUMB_LEVEL_TRACE;
+    config->flatten_report_breadcrumbs = true;
+    config->max_interned_string_count = DEFAULT_MAX_INTERNED_STRING_COUNT;
+    config->interned_string_buf_size_bytes = DEFAULT_INTERNED_STRING_BUF_SIZE_BYTES;
+    config->persistent_store_path = nullptr;
+    config->previous_run_handler = nullptr;
     config->report_handler = &forensics_default_report_handler;
     config->alloc = &default_alloc;
     config->free = &default_free;
@@ -279,27 +3360,158 @@ void forensics_lib_init(const forensics_config_t* config) {
 
   s_context_buf_list = nullptr;
 
+  // read whatever the previous run left behind before the file is reused
+  if (s_config.persistent_store_path != nullptr) {
+    store_load_previous_run(s_config.persistent_store_path);
+    store_open(s_config.persistent_store_path);
+  }
+  // the path is only borrowed for the call to `forensics_lib_init()`
+  s_config.persistent_store_path = nullptr;
+
   s_report_id = (char*)forensics_alloc(s_config.max_id_size_bytes);
   s_report_formatted_msg = (char*)forensics_alloc(s_config.max_formatted_message_size_bytes);
+  // A ring can report a partial pass through a repeated block on top of its crumbs. The report holds the crumbs from
+  // every channel (and every CPU).
+  unsigned int report_breadcrumb_count = s_config.max_breadcrumb_count;
+  s_report_breadcrumb_values_buf_size = s_config.breadcrumb_buf_size_bytes;
+  if (s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_GLOBAL) {
+    report_breadcrumb_count += breadcrumb_loop_capacity(s_config.max_breadcrumb_count);
+  }
+  else if (s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_PER_CPU) {
+    const unsigned int cpu_count = forensics_private_cpu_count();
+    report_breadcrumb_count =
+        cpu_count * (s_config.max_breadcrumb_count + breadcrumb_loop_capacity(s_config.max_breadcrumb_count));
+    s_report_breadcrumb_values_buf_size = cpu_count * s_config.breadcrumb_buf_size_bytes;
+  }
+  else if (s_config.breadcrumb_mode == FORENSICS_BREADCRUMB_MODE_LOCK_FREE) {
+    s_report_breadcrumb_values_buf_size = s_config.max_breadcrumb_count * s_config.breadcrumb_slot_size_bytes;
+  }
+  for (unsigned int index = 0; index < s_config.breadcrumb_channel_count; ++index) {
+    const forensics_breadcrumb_channel_config_t* channel_config = &s_config.breadcrumb_channels[index];
+    report_breadcrumb_count +=
+        channel_config->max_breadcrumb_count + breadcrumb_loop_capacity(channel_config->max_breadcrumb_count);
+    s_report_breadcrumb_values_buf_size += channel_config->breadcrumb_buf_size_bytes;
+  }
+  // the formatted crumbs get copies of their value arrays next to the strings. A crumb's values take up more room in
+  // its ring than those copies do (even counting the copy reported for a partial pass), so doubling leaves the strings
+  // as much room as before.
+  s_report_breadcrumb_values_buf_size *= 2;
+  s_report_breadcrumb_capacity = report_breadcrumb_count;
   s_report_breadcrumbs =
-      (forensics_breadcrumb_t*)forensics_alloc(s_config.max_breadcrumb_count * sizeof(forensics_breadcrumb_t));
+      (forensics_breadcrumb_t*)forensics_alloc(report_breadcrumb_count * sizeof(forensics_breadcrumb_t));
+  s_report_breadcrumb_values_buf = (char*)forensics_alloc(s_report_breadcrumb_values_buf_size);
 
   s_attribute_keys = (char**)forensics_alloc(s_config.max_attribute_count * sizeof(char*));
   s_attribute_values = (char**)forensics_alloc(s_config.max_attribute_count * sizeof(char*));
-  s_attribute_buf = (char*)forensics_alloc(s_config.attribute_buf_size_bytes);
-  s_attribute_count = 0;
-  s_attribute_buf_used = 0;
+  s_attribute_hashes = (uint64_t*)forensics_alloc(s_config.max_attribute_count * sizeof(uint64_t));
+  s_attribute_births = (uint64_t*)forensics_alloc(s_config.max_attribute_count * sizeof(uint64_t));
+  // each attribute can have one block waiting on a pinned list and one replaced since
+  s_attribute_retired =
+      (attribute_retired_t*)forensics_alloc(2 * s_config.max_attribute_count * sizeof(attribute_retired_t));
+  for (attribute_version_t& version : s_attribute_versions) {
+    version.generation = 0;
+    version.count = 0;
+    version.keys = (char**)forensics_alloc(s_config.max_attribute_count * sizeof(char*));
+    version.values = (char**)forensics_alloc(s_config.max_attribute_count * sizeof(char*));
+  }
+  s_attribute_version.store(s_attribute_versions, std::memory_order_relaxed);
+  s_attribute_version_pinned.store(nullptr, std::memory_order_relaxed);
+  unsigned int attribute_table_size = 1;
+  while (attribute_table_size < 2 * s_config.max_attribute_count) {
+    attribute_table_size *= 2;
+  }
+  s_attribute_table = (int*)forensics_alloc(attribute_table_size * sizeof(int));
+  s_attribute_table_mask = attribute_table_size - 1;
+  if (s_store != nullptr) {
+    s_attribute_buf = (char*)s_store + s_store->attribute_buf_offset;
+  }
+  else {
+    s_attribute_buf = (char*)forensics_alloc(s_config.attribute_buf_size_bytes);
+  }
+  attribute_table_clear();
+  s_registered_attributes =
+      (registered_attribute_t*)forensics_alloc(s_config.max_registered_attribute_count * sizeof(registered_attribute_t));
+  s_registered_attribute_count.store(0, std::memory_order_relaxed);
+  s_numeric_attributes =
+      (numeric_attribute_t*)forensics_alloc(s_config.max_numeric_attribute_count * sizeof(numeric_attribute_t));
+  s_numeric_attribute_count.store(0, std::memory_order_relaxed);
+  s_report_numeric_values_buf =
+      (char*)forensics_alloc(s_config.max_numeric_attribute_count * FORMATTED_VALUE_SIZE_BYTES);
+  s_attribute_providers =
+      (attribute_provider_t*)forensics_alloc(s_config.max_attribute_provider_count * sizeof(attribute_provider_t));
+  s_attribute_provider_count = 0;
+  s_report_attribute_provider_buf =
+      (char*)forensics_alloc(s_config.max_attribute_provider_count * s_config.attribute_provider_value_size_bytes);
+  const unsigned int report_attribute_count = s_config.max_attribute_count + s_config.max_registered_attribute_count +
+                                              s_config.max_numeric_attribute_count +
+                                              s_config.max_attribute_provider_count +
+                                              s_config.max_thread_attribute_count;
+  s_report_attribute_keys = (char**)forensics_alloc(report_attribute_count * sizeof(char*));
+  s_report_attribute_values = (char**)forensics_alloc(report_attribute_count * sizeof(char*));
+  s_report_attribute_typed_values =
+      (forensics_value_t*)forensics_alloc(report_attribute_count * sizeof(forensics_value_t));
+  s_report_attribute_values_buf = (char*)forensics_alloc(s_config.attribute_buf_size_bytes);
+
+  s_interned_strings = (const char**)forensics_alloc(s_config.max_interned_string_count * sizeof(const char*));
+  s_interned_string_hashes = (uint64_t*)forensics_alloc(s_config.max_interned_string_count * sizeof(uint64_t));
+  s_interned_string_buf = (char*)forensics_alloc(s_config.interned_string_buf_size_bytes);
+  s_interned_string_buf_used = 0;
+  s_interned_string_count.store(0);
+  unsigned int interned_string_table_size = 1;
+  while (interned_string_table_size < 2 * s_config.max_interned_string_count) {
+    interned_string_table_size *= 2;
+  }
+  s_interned_string_table = (std::atomic<forensics_string_t>*)forensics_alloc(interned_string_table_size *
+                                                                              sizeof(std::atomic<forensics_string_t>));
+  for (unsigned int slot = 0; slot < interned_string_table_size; ++slot) {
+    new (&s_interned_string_table[slot]) std::atomic<forensics_string_t>(FORENSICS_STRING_INVALID);
+  }
+  s_interned_string_table_mask = interned_string_table_size - 1;
 
-  s_breadcrumbs = (breadcrumb_t*)forensics_alloc(s_config.max_breadcrumb_count * sizeof(breadcrumb_t));
-  s_breadcrumbs_buf = (char*)forensics_alloc(s_config.breadcrumb_buf_size_bytes);
-  s_breadcrumbs_count = 0;
-  s_breadcrumbs_index_next = 0;
-  s_breadcrumbs_buf_read_index = 0;
-  s_breadcrumbs_buf_write_index = 0;
+  s_breadcrumb_ring_list = nullptr;
+  s_breadcrumb_report_active.store(false);
+  switch (s_config.breadcrumb_mode) {
+    case FORENSICS_BREADCRUMB_MODE_GLOBAL:
+      if (s_store != nullptr) {
+        // already laid out in the store
+        s_breadcrumbs = &s_store->breadcrumbs;
+        s_breadcrumbs_sequence = &s_store->breadcrumbs_sequence;
+      }
+      else {
+        s_breadcrumbs = &s_breadcrumbs_storage;
+        s_breadcrumbs_sequence = &s_breadcrumbs_sequence_storage;
+        breadcrumb_ring_init(s_breadcrumbs, s_config.max_breadcrumb_count, s_config.breadcrumb_buf_size_bytes);
+      }
+      if (s_config.breadcrumb_archive_size_bytes > 0 && s_config.breadcrumb_archive_block_size_bytes > 0) {
+        s_breadcrumbs->archive = breadcrumb_archive_create(s_config.breadcrumb_archive_size_bytes,
+                                                          s_config.breadcrumb_archive_block_size_bytes);
+      }
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_THREAD:
+      break;
+    case FORENSICS_BREADCRUMB_MODE_LOCK_FREE:
+      breadcrumb_slots_init();
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_CPU:
+      cpu_rings_init();
+      break;
+  }
+  breadcrumb_channels_init();
+  size_t report_ring_storage_size_bytes = 0;
+  for (unsigned int index = 0; index < s_cpu_ring_count; ++index) {
+    report_ring_storage_size_bytes += snapshot_ring_size(&s_cpu_rings[index].ring);
+  }
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    report_ring_storage_size_bytes += snapshot_ring_size(&s_breadcrumb_channels[index].ring);
+  }
+  s_report_ring_storage = (char*)forensics_alloc(report_ring_storage_size_bytes);
+  forensics_set_breadcrumb_level(s_config.breadcrumb_level);
 
   s_backtrace_buf = (void**)forensics_alloc(s_config.max_backtrace_count * sizeof(void*));
 
   forensics_private_register_signal_handlers();
+
+  store_report_previous_run();
 }
 
 void forensics_lib_shutdown() {
@@ -312,33 +3524,108 @@ void forensics_lib_shutdown() {
 
   forensics_free(s_backtrace_buf);
 
-  forensics_free(s_breadcrumbs_buf);
-  forensics_free(s_breadcrumbs);
-  s_breadcrumbs_buf = nullptr;
-  s_breadcrumbs = nullptr;
-  s_breadcrumbs_count = 0;
-  s_breadcrumbs_index_next = 0;
-  s_breadcrumbs_buf_read_index = 0;
-  s_breadcrumbs_buf_write_index = 0;
+  // free the allocated thread breadcrumb rings
+  while (s_breadcrumb_ring_list != nullptr) {
+    thread_ring_destroy(s_breadcrumb_ring_list);
+  }
+  switch (s_config.breadcrumb_mode) {
+    case FORENSICS_BREADCRUMB_MODE_GLOBAL:
+      if (s_breadcrumbs->archive != nullptr) {
+        breadcrumb_archive_destroy(s_breadcrumbs->archive);
+        s_breadcrumbs->archive = nullptr;
+      }
+      if (s_store == nullptr) {
+        breadcrumb_ring_destroy(s_breadcrumbs);
+      }
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_THREAD:
+      break;
+    case FORENSICS_BREADCRUMB_MODE_LOCK_FREE:
+      breadcrumb_slots_destroy();
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_CPU:
+      cpu_rings_destroy();
+      break;
+  }
+  breadcrumb_channels_destroy();
 
-  forensics_free(s_attribute_buf);
+  forensics_free(s_interned_string_table);
+  forensics_free(s_interned_string_buf);
+  forensics_free(s_interned_string_hashes);
+  forensics_free(s_interned_strings);
+  s_interned_string_table = nullptr;
+  s_interned_string_buf = nullptr;
+  s_interned_string_hashes = nullptr;
+  s_interned_strings = nullptr;
+  s_interned_string_buf_used = 0;
+  s_interned_string_count.store(0);
+
+  if (s_store == nullptr) {
+    forensics_free(s_attribute_buf);
+  }
+  registered_attributes_destroy();
+  forensics_free(s_report_attribute_provider_buf);
+  forensics_free(s_attribute_providers);
+  s_report_attribute_provider_buf = nullptr;
+  s_attribute_providers = nullptr;
+  s_attribute_provider_count = 0;
+  forensics_free(s_report_numeric_values_buf);
+  forensics_free(s_numeric_attributes);
+  s_report_numeric_values_buf = nullptr;
+  s_numeric_attributes = nullptr;
+  s_numeric_attribute_count.store(0, std::memory_order_relaxed);
+  forensics_free(s_report_attribute_values_buf);
+  forensics_free(s_report_attribute_typed_values);
+  forensics_free(s_report_attribute_values);
+  forensics_free(s_report_attribute_keys);
+  forensics_free(s_registered_attributes);
+  s_report_attribute_values_buf = nullptr;
+  s_report_attribute_typed_values = nullptr;
+  s_report_attribute_values = nullptr;
+  s_report_attribute_keys = nullptr;
+  s_registered_attributes = nullptr;
+  for (attribute_version_t& version : s_attribute_versions) {
+    forensics_free(version.values);
+    forensics_free(version.keys);
+    version.values = nullptr;
+    version.keys = nullptr;
+  }
+  s_attribute_version.store(nullptr, std::memory_order_relaxed);
+  forensics_free(s_attribute_retired);
+  forensics_free(s_attribute_births);
+  s_attribute_retired = nullptr;
+  s_attribute_births = nullptr;
+  forensics_free(s_attribute_table);
+  forensics_free(s_attribute_hashes);
   forensics_free(s_attribute_values);
   forensics_free(s_attribute_keys);
   s_attribute_buf = nullptr;
+  s_attribute_table = nullptr;
+  s_attribute_table_mask = 0;
+  s_attribute_hashes = nullptr;
   s_attribute_values = nullptr;
   s_attribute_keys = nullptr;
   s_attribute_count = 0;
   s_attribute_buf_used = 0;
 
+  forensics_free(s_report_breadcrumb_values_buf);
+  s_report_breadcrumb_values_buf = nullptr;
+  s_report_breadcrumb_values_buf_size = 0;
   forensics_free(s_report_breadcrumbs);
   s_report_breadcrumbs = nullptr;
+  forensics_free(s_report_ring_storage);
+  s_report_ring_storage = nullptr;
   forensics_free(s_report_formatted_msg);
   s_report_formatted_msg = nullptr;
   forensics_free(s_report_id);
   s_report_id = nullptr;
+
+  store_close();
+  s_breadcrumbs = nullptr;
+  s_breadcrumbs_sequence = nullptr;
 }
 
-void forensics_context_begin(const char* name) {
+void forensics_private_context_begin_slow(const char* name, uint64_t hash) {
   context_buffer_t* ctx_buf = &s_tls_context_buf;
 
   // handle first-time initialization (per thread)
@@ -347,161 +3634,608 @@ void forensics_context_begin(const char* name) {
   }
 
   // check for overflow
-  const int new_count = ctx_buf->count + 1;
-  if (new_count > ctx_buf->capacity) {
-    ++ctx_buf->overflow_count;
+  forensics_context_stack_t* stack = &forensics_private_context_stack;
+  if (stack->count >= stack->capacity) {
+    ++stack->overflow_count;
     return;
   }
 
   // append the new context
-  ctx_buf->stack[ctx_buf->count] = name;
-  ctx_buf->count = new_count;
+  stack->names[stack->count] = name;
+  stack->hashes[stack->count] = hash;
+  std::atomic_signal_fence(std::memory_order_seq_cst);
+  ++stack->count;
+}
+
+void forensics_context_begin(const char* name) {
+  forensics_private_context_push(name, 0);
+}
+
+void forensics_context_begin_copy(const char* name) {
+  // a full table isn't worth a report of its own, the context is just left unnamed
+  const char* interned_name = forensics_interned_string(intern_string(name, false));
+
+  // push something either way so the context still lines up with its `forensics_context_end()`
+  forensics_private_context_push(interned_name != nullptr ? interned_name : CONTEXT_NAME_UNKNOWN, 0);
+}
+
+void forensics_context_begin_interned(forensics_string_t name) {
+  if (!interned_string_is_valid(name)) {
+    FORENSICS_ASSERTF(false, "Invalid interned context name handle: %u", name);
+    forensics_private_context_push(CONTEXT_NAME_UNKNOWN, 0);
+    return;
+  }
+  forensics_private_context_push(s_interned_strings[name - 1], 0);
 }
 
 void forensics_context_end() {
-  context_buffer_t* ctx_buf = &s_tls_context_buf;
+  forensics_private_context_pop();
+}
+
+void forensics_private_context_end_slow() {
+  forensics_context_stack_t* stack = &forensics_private_context_stack;
 
   // check for overflow
-  if (ctx_buf->overflow_count > 0) {
-    --ctx_buf->overflow_count;
+  if (stack->overflow_count > 0) {
+    --stack->overflow_count;
     return;
   }
 
   // check for underflow
-  FORENSICS_ASSERTF(ctx_buf->count > 0,
-                    "The forensics context stack underflowed. Do you have mismatched "
-                    "forensics_context_begin/forensics_context_end calls?");
+  if (!FORENSICS_ASSERTF(stack->count > 0,
+                         "The forensics context stack underflowed. Do you have mismatched "
+                         "forensics_context_begin/forensics_context_end calls?")) {
+    return;
+  }
 
-  --ctx_buf->count;
+  --stack->count;
 }
 
-void forensics_add_breadcrumb(const char* name, const char** meta_keys, const char** meta_values, int meta_count) {
-  // allow multi-threaded access to this function and protect against the crash handler
-  std::lock_guard<std::mutex> lock(s_report_mutex);
+void forensics_thread_attribute_begin(const char* key, const char* value) {
+  context_buffer_t* ctx_buf = &s_tls_context_buf;
 
-  // bail if configured to be disabled
-  if (s_config.max_breadcrumb_count == 0) {
+  // handle first-time initialization (per thread)
+  if (!ctx_buf->initialized) {
+    context_buffer_init(ctx_buf);
+  }
+
+  // check for overflow
+  const unsigned int key_size_bytes = (unsigned int)strlen(key) + 1;
+  const unsigned int value_size_bytes = (unsigned int)strlen(value) + 1;
+  if (ctx_buf->attribute_count == (int)s_config.max_thread_attribute_count ||
+      key_size_bytes + value_size_bytes > s_config.thread_attribute_buf_size_bytes - ctx_buf->attribute_buf_used) {
+    ++ctx_buf->attribute_overflow_count;
     return;
   }
 
-  // compare against the last breadcrumb to see if we can just denote repetetion
-  if (s_breadcrumbs_count > 0) {
-    const int last_index =
-        (s_breadcrumbs_index_next + s_config.max_breadcrumb_count - 1) % s_config.max_breadcrumb_count;
-    forensics_breadcrumb_t* prev = &s_breadcrumbs[last_index].crumb;
-    if (prev->meta_count == meta_count) {
-      if (!strcmp(prev->name, name)) {
-        bool match = true;
-        for (int index = 0; index < meta_count; ++index) {
-          if (0 != strcmp(prev->meta_keys[index], meta_keys[index])) {
-            match = false;
-            break;
-          }
-          if (0 != strcmp(prev->meta_values[index], meta_values[index])) {
-            match = false;
-            break;
-          }
-        }
-        if (match == true) {
-          // previous breadcrumb was identical; record the repetetion and bail
-          ++prev->count;
-          return;
-        }
-      }
+  // copy in the strings before the count covers them, in case a signal handler reports on this thread in between
+  char* key_in_buf = ctx_buf->attribute_buf + ctx_buf->attribute_buf_used;
+  char* value_in_buf = key_in_buf + key_size_bytes;
+  memcpy(key_in_buf, key, key_size_bytes);
+  memcpy(value_in_buf, value, value_size_bytes);
+  ctx_buf->attribute_buf_used += key_size_bytes + value_size_bytes;
+  ctx_buf->attribute_keys[ctx_buf->attribute_count] = key_in_buf;
+  ctx_buf->attribute_values[ctx_buf->attribute_count] = value_in_buf;
+  std::atomic_signal_fence(std::memory_order_release);
+  ++ctx_buf->attribute_count;
+}
+
+void forensics_thread_attribute_end() {
+  context_buffer_t* ctx_buf = &s_tls_context_buf;
+
+  // check for overflow
+  if (ctx_buf->attribute_overflow_count > 0) {
+    --ctx_buf->attribute_overflow_count;
+    return;
+  }
+
+  // check for underflow
+  if (!FORENSICS_ASSERTF(ctx_buf->attribute_count > 0,
+                         "The forensics thread attribute stack underflowed. Do you have mismatched "
+                         "forensics_thread_attribute_begin/forensics_thread_attribute_end calls?")) {
+    return;
+  }
+
+  --ctx_buf->attribute_count;
+  std::atomic_signal_fence(std::memory_order_release);
+  const char* key = ctx_buf->attribute_keys[ctx_buf->attribute_count];
+  ctx_buf->attribute_buf_used = (unsigned int)(key - ctx_buf->attribute_buf);
+}
+
+forensics_channel_t forensics_breadcrumb_channel(const char* name) {
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    if (0 == strcmp(name, s_breadcrumb_channels[index].name)) {
+      return (forensics_channel_t)(index + 1);
     }
   }
+  return FORENSICS_CHANNEL_DEFAULT;
+}
 
-  const int name_size_bytes = (int)strlen(name) + 1;
+void forensics_add_breadcrumb(const char* name, const char** meta_keys, const char** meta_values, int meta_count) {
+  forensics_add_channel_breadcrumb(FORENSICS_CHANNEL_DEFAULT, name, meta_keys, meta_values, meta_count);
+}
 
-  // compute the required space in the ringbuffer
-  unsigned int required_size = 0;
-  required_size += sizeof(char**) * meta_count * 2;
-  required_size += name_size_bytes;
-  for (int index = 0; index < meta_count; ++index) {
-    required_size += (int)strlen(meta_keys[index]) + 1;
-    required_size += (int)strlen(meta_values[index]) + 1;
+void forensics_add_channel_breadcrumb(forensics_channel_t channel,
+                                      const char* name,
+                                      const char** meta_keys,
+                                      const char** meta_values,
+                                      int meta_count) {
+  if (!breadcrumb_channel_is_valid(channel)) {
+    FORENSICS_ASSERTF(false, "Invalid breadcrumb channel handle: %u", channel);
+    return;
   }
 
-  // remove a breadcrumb if there are too many
-  if (s_breadcrumbs_count >= s_config.max_breadcrumb_count) {
-    breadcrumb_deque();
+  breadcrumb_desc_t desc;
+  desc.name = name;
+  desc.meta_keys = meta_keys;
+  desc.meta_key_handles = nullptr;
+  desc.meta_values = meta_values;
+  desc.meta_typed_values = nullptr;
+  desc.meta_count = meta_count;
+  desc.name_handle = FORENSICS_STRING_INVALID;
+  desc.channel = channel;
+  breadcrumb_add(&desc, 1);
+}
+
+void forensics_add_breadcrumb_typed(const char* name,
+                                    const char** meta_keys,
+                                    const forensics_value_t* meta_values,
+                                    int meta_count) {
+  forensics_add_channel_breadcrumb_typed(FORENSICS_CHANNEL_DEFAULT, name, meta_keys, meta_values, meta_count);
+}
+
+void forensics_add_channel_breadcrumb_typed(forensics_channel_t channel,
+                                            const char* name,
+                                            const char** meta_keys,
+                                            const forensics_value_t* meta_values,
+                                            int meta_count) {
+  if (!breadcrumb_channel_is_valid(channel)) {
+    FORENSICS_ASSERTF(false, "Invalid breadcrumb channel handle: %u", channel);
+    return;
   }
 
-  // alloc space from the ring buffer
-  char* alloc = breadcrumb_buf_alloc(required_size);
-  if (alloc == nullptr) {
-    // bail in the pathalogical case where it can't fit
-    if (required_size > s_config.breadcrumb_buf_size_bytes) {
+  breadcrumb_desc_t desc;
+  desc.name = name;
+  desc.meta_keys = meta_keys;
+  desc.meta_key_handles = nullptr;
+  desc.meta_values = nullptr;
+  desc.meta_typed_values = meta_values;
+  desc.meta_count = meta_count;
+  desc.name_handle = FORENSICS_STRING_INVALID;
+  desc.channel = channel;
+  breadcrumb_add(&desc, 1);
+}
+
+void forensics_add_breadcrumb_interned(forensics_string_t name,
+                                       const forensics_string_t* meta_keys,
+                                       const char** meta_values,
+                                       int meta_count) {
+  forensics_add_channel_breadcrumb_interned(FORENSICS_CHANNEL_DEFAULT, name, meta_keys, meta_values, meta_count);
+}
+
+void forensics_add_channel_breadcrumb_interned(forensics_channel_t channel,
+                                               forensics_string_t name,
+                                               const forensics_string_t* meta_keys,
+                                               const char** meta_values,
+                                               int meta_count) {
+  // check the handles up front so a bad one doesn't leave a dangling crumb behind
+  if (!breadcrumb_channel_is_valid(channel)) {
+    FORENSICS_ASSERTF(false, "Invalid breadcrumb channel handle: %u", channel);
+    return;
+  }
+  if (!interned_string_is_valid(name)) {
+    FORENSICS_ASSERTF(false, "Invalid interned breadcrumb name handle: %u", name);
+    return;
+  }
+  for (int index = 0; index < meta_count; ++index) {
+    if (!interned_string_is_valid(meta_keys[index])) {
+      FORENSICS_ASSERTF(false, "Invalid interned breadcrumb meta key handle: %u", meta_keys[index]);
       return;
     }
+  }
 
-    // remove a breadcrumb to make room
-    while (alloc == nullptr) {
-      breadcrumb_deque();
-      alloc = breadcrumb_buf_alloc(required_size);
-    }
+  breadcrumb_desc_t desc;
+  desc.name = s_interned_strings[name - 1];
+  desc.meta_keys = nullptr;
+  desc.meta_key_handles = meta_keys;
+  desc.meta_values = meta_values;
+  desc.meta_typed_values = nullptr;
+  desc.meta_count = meta_count;
+  desc.name_handle = name;
+  desc.channel = channel;
+  breadcrumb_add(&desc, 1);
+}
+
+void forensics_add_breadcrumbs(const forensics_breadcrumb_entry_t* breadcrumbs, int count) {
+  forensics_add_channel_breadcrumbs(FORENSICS_CHANNEL_DEFAULT, breadcrumbs, count);
+}
+
+void forensics_add_channel_breadcrumbs(forensics_channel_t channel,
+                                       const forensics_breadcrumb_entry_t* breadcrumbs,
+                                       int count) {
+  if (!breadcrumb_channel_is_valid(channel)) {
+    FORENSICS_ASSERTF(false, "Invalid breadcrumb channel handle: %u", channel);
+    return;
   }
 
-  // copy the data into the ring buffer
-  char** out_meta_keys = (char**)alloc;
-  char** out_meta_values = (char**)(out_meta_keys + meta_count);
-  char* out_name = (char*)(out_meta_values + meta_count);
-  char* ptr = out_name + name_size_bytes;
-  memmove(out_name, name, name_size_bytes);
-  for (int index = 0; index < meta_count; ++index) {
-    const int key_size_bytes = (int)strlen(meta_keys[index]) + 1;
-    const int value_size_bytes = (int)strlen(meta_values[index]) + 1;
-    char* out_key = ptr;
-    char* out_value = out_key + key_size_bytes;
-    ptr = out_value + value_size_bytes;
-
-    memmove(out_key, meta_keys[index], key_size_bytes);
-    memmove(out_value, meta_values[index], value_size_bytes);
-    out_meta_keys[index] = out_key;
-    out_meta_values[index] = out_value;
-  }
-
-  breadcrumb_t* breadcrumb = s_breadcrumbs + s_breadcrumbs_index_next;
-  breadcrumb->buf_size = required_size;
-  forensics_breadcrumb_t* crumb = &breadcrumb->crumb;
-  crumb->name = out_name;
-  if (meta_count > 0) {
-    crumb->meta_keys = (const char**)out_meta_keys;
-    crumb->meta_values = (const char**)out_meta_values;
+  breadcrumb_desc_t descs[BREADCRUMB_BATCH_SIZE];
+  for (int offset = 0; offset < count; offset += BREADCRUMB_BATCH_SIZE) {
+    const int batch_count = count - offset < BREADCRUMB_BATCH_SIZE ? count - offset : BREADCRUMB_BATCH_SIZE;
+    for (int index = 0; index < batch_count; ++index) {
+      const forensics_breadcrumb_entry_t* entry = &breadcrumbs[offset + index];
+      breadcrumb_desc_t* desc = &descs[index];
+      desc->name = entry->name;
+      desc->meta_keys = entry->meta_keys;
+      desc->meta_key_handles = nullptr;
+      desc->meta_values = entry->meta_typed_values != nullptr ? nullptr : entry->meta_values;
+      desc->meta_typed_values = entry->meta_typed_values;
+      desc->meta_count = entry->meta_count;
+      desc->name_handle = FORENSICS_STRING_INVALID;
+      desc->channel = channel;
+    }
+    breadcrumb_add(descs, batch_count);
   }
-  else {
-    crumb->meta_keys = nullptr;
-    crumb->meta_values = nullptr;
+}
+
+forensics_string_t forensics_intern_string(const char* str) {
+  return intern_string(str, true);
+}
+
+const char* forensics_interned_string(forensics_string_t handle) {
+  if (!interned_string_is_valid(handle)) {
+    return nullptr;
   }
-  crumb->meta_count = meta_count;
-  crumb->count = 1;
+  return s_interned_strings[handle - 1];
+}
 
-  s_breadcrumbs_index_next = (s_breadcrumbs_index_next + 1) % s_config.max_breadcrumb_count;
-  ++s_breadcrumbs_count;
+void forensics_set_breadcrumb_level(int level) {
+  // pairs with the relaxed load in `FORENSICS_BREADCRUMB_ENABLED()`
+#ifdef _MSC_VER
+  _InterlockedExchange((volatile long*)&forensics_private_breadcrumb_level, level);
+#else
+  __atomic_store_n(&forensics_private_breadcrumb_level, level, __ATOMIC_RELAXED);
+#endif
 }
 
-void forensics_set_attribute(const char* key, const char* value) {
-  // allow multi-threaded access to this function and protect against the crash handler
-  std::lock_guard<std::mutex> lock(s_report_mutex);
+int forensics_get_breadcrumb_level() {
+  return FORENSICS_LOAD_RELAXED(forensics_private_breadcrumb_level);
+}
 
+void forensics_set_attribute(const char* key, const char* value) {
   // bail if configured to be disabled
   if (s_config.max_attribute_count == 0) {
     return;
   }
 
-  if (value == nullptr) {
-    const int index = attribute_find(key);
-    if (index != -1) {
-      attribute_clear(index);
+  // allow multi-threaded access to this function. Reports only read published lists so they don't need this lock.
+  std::unique_lock<std::mutex> lock(s_attribute_mutex);
+  const attribute_error_t error = attribute_change(key, value);
+  attribute_publish();
+  store_sync_attributes();
+  const int avail = (int)s_config.attribute_buf_size_bytes - s_attribute_buf_used;
+  lock.unlock();
+
+  // a report handler may set attributes itself, so assert once the lock is let go
+  attribute_assert_no_error(error, key, value, avail);
+}
+
+void forensics_set_attributes(const char* const* keys, const char* const* values, int count) {
+  // bail if configured to be disabled
+  if (s_config.max_attribute_count == 0 || count <= 0) {
+    return;
+  }
+
+  // only the first change that didn't fit is reported
+  std::unique_lock<std::mutex> lock(s_attribute_mutex);
+  attribute_error_t first_error = ATTRIBUTE_ERROR_NONE;
+  int first_error_index = 0;
+  int first_error_avail = 0;
+  for (int index = 0; index < count; ++index) {
+    const attribute_error_t error = attribute_change(keys[index], values[index]);
+    if (error != ATTRIBUTE_ERROR_NONE && first_error == ATTRIBUTE_ERROR_NONE) {
+      first_error = error;
+      first_error_index = index;
+      first_error_avail = (int)s_config.attribute_buf_size_bytes - s_attribute_buf_used;
     }
   }
-  else {
-    const int index = attribute_find(key);
-    if (index != -1) {
-      attribute_clear(index);
+  attribute_publish();
+  store_sync_attributes();
+  lock.unlock();
+
+  attribute_assert_no_error(first_error, keys[first_error_index], values[first_error_index], first_error_avail);
+}
+
+forensics_attribute_t forensics_attribute_register(const char* key, unsigned int max_value_size_bytes) {
+  // bail if configured to be disabled
+  if (s_config.max_registered_attribute_count == 0) {
+    return FORENSICS_ATTRIBUTE_INVALID;
+  }
+
+  // the lock is let go before asserting, since a report handler may set attributes itself
+  std::unique_lock<std::mutex> lock(s_attribute_mutex);
+  const unsigned int count = s_registered_attribute_count.load(std::memory_order_relaxed);
+  for (unsigned int index = 0; index < count; ++index) {
+    if (0 == strcmp(key, (const char*)(s_registered_attributes[index].block + 1))) {
+      return (forensics_attribute_t)(index + 1);
+    }
+  }
+
+  if (count == s_config.max_registered_attribute_count) {
+    lock.unlock();
+    FORENSICS_ASSERTF(false,
+                      "Cannot register attribute because the registered attribute array is full. Try increasing the "
+                      "size of max_registered_attribute_count. key=%s",
+                      key);
+    return FORENSICS_ATTRIBUTE_INVALID;
+  }
+  const unsigned int key_size_bytes = (unsigned int)strlen(key) + 1;
+  const unsigned int value_size_bytes = max_value_size_bytes > 0 ? max_value_size_bytes : 1;
+  attribute_block_t* block = attribute_block_alloc(key_size_bytes + value_size_bytes);
+  if (block == nullptr) {
+    const int avail = (int)s_config.attribute_buf_size_bytes - s_attribute_buf_used;
+    lock.unlock();
+    FORENSICS_ASSERTF(false,
+                      "Cannot register attribute because the attribute buffer is full. Try increasing the size of "
+                      "attribute_buf_size_bytes. attribute=%s needed=%u avail=%d",
+                      key,
+                      key_size_bytes + value_size_bytes,
+                      avail);
+    return FORENSICS_ATTRIBUTE_INVALID;
+  }
+
+  registered_attribute_t* attribute = new (s_registered_attributes + count) registered_attribute_t;
+  attribute->block = block;
+  attribute->value = (char*)(block + 1) + key_size_bytes;
+  attribute->value_size_bytes = value_size_bytes;
+  attribute->sequence.store(0, std::memory_order_relaxed);
+  memmove(block + 1, key, key_size_bytes);
+  attribute->value[0] = 0;
+  block->state = ATTRIBUTE_BLOCK_UNSET;
+  s_registered_attribute_count.store(count + 1, std::memory_order_release);
+  store_sync_attributes();
+  return (forensics_attribute_t)(count + 1);
+}
+
+bool forensics_register_attribute_provider(const char* key, forensics_attribute_provider_t provider, void* user_data) {
+  // bail if configured to be disabled
+  if (s_config.max_attribute_provider_count == 0 || s_config.attribute_provider_value_size_bytes == 0) {
+    return false;
+  }
+
+  // interned keys can be compared by pointer
+  const char* interned_key = forensics_interned_string(forensics_intern_string(key));
+  if (interned_key == nullptr) {
+    return false;
+  }
+
+  // the lock is let go before asserting since the report takes it too
+  std::unique_lock<std::mutex> lock(s_report_mutex);
+  unsigned int index = 0;
+  while (index < s_attribute_provider_count && s_attribute_providers[index].key != interned_key) {
+    ++index;
+  }
+  if (index == s_config.max_attribute_provider_count) {
+    lock.unlock();
+    FORENSICS_ASSERTF(false,
+                      "Cannot register attribute provider because the attribute provider array is full. Try increasing "
+                      "the size of max_attribute_provider_count. key=%s",
+                      key);
+    return false;
+  }
+  if (index == s_attribute_provider_count) {
+    ++s_attribute_provider_count;
+  }
+  s_attribute_providers[index].key = interned_key;
+  s_attribute_providers[index].provider = provider;
+  s_attribute_providers[index].user_data = user_data;
+  return true;
+}
+
+void forensics_attribute_set_by_handle(forensics_attribute_t attribute, const char* value) {
+  if (!registered_attribute_is_valid(attribute)) {
+    FORENSICS_ASSERTF(false, "Invalid attribute handle: %u", attribute);
+    return;
+  }
+
+  std::unique_lock<std::mutex> lock(s_attribute_mutex, std::defer_lock);
+  if (!s_config.relaxed_attribute_handles) {
+    lock.lock();
+  }
+  registered_attribute_t* registered = &s_registered_attributes[attribute - 1];
+  registered_attribute_write_begin(registered);
+  registered_attribute_write(registered, value);
+  breadcrumb_sequence_end(&registered->sequence);
+}
+
+forensics_numeric_attribute_t forensics_numeric_attribute_register(const char* key, forensics_value_type_t type) {
+  // bail if configured to be disabled
+  if (s_config.max_numeric_attribute_count == 0) {
+    return FORENSICS_NUMERIC_ATTRIBUTE_INVALID;
+  }
+  if (!FORENSICS_ASSERTF(type == FORENSICS_VALUE_INT64 || type == FORENSICS_VALUE_DOUBLE,
+                         "Numeric attributes must be FORENSICS_VALUE_INT64 or FORENSICS_VALUE_DOUBLE. key=%s type=%d",
+                         key,
+                         (int)type)) {
+    return FORENSICS_NUMERIC_ATTRIBUTE_INVALID;
+  }
+
+  // interned keys can be compared by pointer
+  const char* interned_key = forensics_interned_string(forensics_intern_string(key));
+  if (interned_key == nullptr) {
+    return FORENSICS_NUMERIC_ATTRIBUTE_INVALID;
+  }
+
+  // the lock is let go before asserting, since a report handler may set attributes itself
+  std::unique_lock<std::mutex> lock(s_attribute_mutex);
+  const unsigned int count = s_numeric_attribute_count.load(std::memory_order_relaxed);
+  for (unsigned int index = 0; index < count; ++index) {
+    if (s_numeric_attributes[index].key == interned_key) {
+      const forensics_value_type_t registered_type = s_numeric_attributes[index].type;
+      lock.unlock();
+      if (!FORENSICS_ASSERTF(registered_type == type,
+                             "Numeric attribute was already registered with another type. key=%s type=%d "
+                             "registered_type=%d",
+                             key,
+                             (int)type,
+                             (int)registered_type)) {
+        return FORENSICS_NUMERIC_ATTRIBUTE_INVALID;
+      }
+      return (forensics_numeric_attribute_t)(index + 1);
+    }
+  }
+
+  if (count == s_config.max_numeric_attribute_count) {
+    lock.unlock();
+    FORENSICS_ASSERTF(false,
+                      "Cannot register numeric attribute because the numeric attribute array is full. Try increasing "
+                      "the size of max_numeric_attribute_count. key=%s",
+                      key);
+    return FORENSICS_NUMERIC_ATTRIBUTE_INVALID;
+  }
+  numeric_attribute_t* attribute = new (s_numeric_attributes + count) numeric_attribute_t;
+  attribute->key = interned_key;
+  attribute->type = type;
+  attribute->bits.store(0, std::memory_order_relaxed);
+  s_numeric_attribute_count.store(count + 1, std::memory_order_release);
+  return (forensics_numeric_attribute_t)(count + 1);
+}
+
+void forensics_numeric_attribute_set_i64(forensics_numeric_attribute_t attribute, int64_t value) {
+  numeric_attribute_t* numeric = numeric_attribute_get(attribute, FORENSICS_VALUE_INT64);
+  if (numeric != nullptr) {
+    numeric->bits.store((uint64_t)value, std::memory_order_relaxed);
+  }
+}
+
+void forensics_numeric_attribute_add_i64(forensics_numeric_attribute_t attribute, int64_t delta) {
+  numeric_attribute_t* numeric = numeric_attribute_get(attribute, FORENSICS_VALUE_INT64);
+  if (numeric != nullptr) {
+    numeric->bits.fetch_add((uint64_t)delta, std::memory_order_relaxed);
+  }
+}
+
+void forensics_numeric_attribute_set_f64(forensics_numeric_attribute_t attribute, double value) {
+  numeric_attribute_t* numeric = numeric_attribute_get(attribute, FORENSICS_VALUE_DOUBLE);
+  if (numeric != nullptr) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    numeric->bits.store(bits, std::memory_order_relaxed);
+  }
+}
+
+const forensics_breadcrumb_t* forensics_report_breadcrumbs(const forensics_report_t* report) {
+  if (report->breadcrumbs != nullptr) {
+    return report->breadcrumbs;
+  }
+  return report_flatten_breadcrumbs(report);
+}
+
+int forensics_report_archived_breadcrumbs(const forensics_report_t* report,
+                                          forensics_breadcrumb_visitor_t visitor,
+                                          void* user_data) {
+  if (report->archived_breadcrumb_count == 0 || s_config.breadcrumb_mode != FORENSICS_BREADCRUMB_MODE_GLOBAL ||
+      s_breadcrumbs->archive == nullptr) {
+    return 0;
+  }
+  return breadcrumb_archive_visit(s_breadcrumbs->archive, visitor, user_data);
+}
+
+size_t forensics_breadcrumb_snapshot_size() {
+  return snapshot_layout(nullptr, nullptr, nullptr, nullptr, nullptr);
+}
+
+bool forensics_snapshot_breadcrumbs(void* buf, size_t buf_size, forensics_breadcrumb_snapshot_t* snapshot) {
+  snapshot->breadcrumbs = nullptr;
+  snapshot->breadcrumb_count = 0;
+  snapshot->skipped_channel_count = 0;
+
+  char* default_storage = nullptr;
+  char* channel_storage = nullptr;
+  forensics_breadcrumb_t* breadcrumbs = nullptr;
+  char* values_buf = nullptr;
+  const size_t size_bytes = snapshot_layout((char*)buf, &default_storage, &channel_storage, &breadcrumbs, &values_buf);
+  if (buf_size < size_bytes) {
+    FORENSICS_ASSERTF(false, "Breadcrumb snapshot buffer is too small: %zu < %zu", buf_size, size_bytes);
+    return false;
+  }
+
+  int count = 0;
+  switch (s_config.breadcrumb_mode) {
+    case FORENSICS_BREADCRUMB_MODE_GLOBAL: {
+      breadcrumb_ring_t ring;
+      if (breadcrumb_ring_snapshot(s_breadcrumbs, s_breadcrumbs_sequence, &ring, default_storage)) {
+        count = (int)breadcrumb_ring_report_count(&ring);
+        for (int index = 0; index < count; ++index) {
+          breadcrumbs[index] = breadcrumb_ring_report_crumb(&ring, (unsigned int)(count - 1 - index));
+        }
+      }
+      else {
+        ++snapshot->skipped_channel_count;
+      }
+      break;
+    }
+    case FORENSICS_BREADCRUMB_MODE_PER_THREAD:
+      break;
+    case FORENSICS_BREADCRUMB_MODE_LOCK_FREE:
+      count = breadcrumb_slots_gather(breadcrumbs, default_storage);
+      break;
+    case FORENSICS_BREADCRUMB_MODE_PER_CPU:
+      for (unsigned int index = 0; index < s_cpu_ring_count; ++index) {
+        cpu_breadcrumb_ring_t* cpu_ring = &s_cpu_rings[index];
+        breadcrumb_ring_t ring;
+        if (breadcrumb_ring_snapshot(&cpu_ring->ring, &cpu_ring->sequence, &ring, default_storage)) {
+          count = breadcrumbs_merge_channel(breadcrumbs, count, &ring, nullptr);
+        }
+        else {
+          ++snapshot->skipped_channel_count;
+        }
+        default_storage += snapshot_ring_size(&cpu_ring->ring);
+      }
+      break;
+  }
+
+  for (unsigned int index = 0; index < s_breadcrumb_channel_count; ++index) {
+    breadcrumb_channel_t* channel = &s_breadcrumb_channels[index];
+    breadcrumb_ring_t ring;
+    if (breadcrumb_ring_snapshot(&channel->ring, &channel->sequence, &ring, channel_storage)) {
+      count = breadcrumbs_merge_channel(breadcrumbs, count, &ring, channel->name);
     }
-    attribute_append(key, value);
+    else {
+      ++snapshot->skipped_channel_count;
+    }
+    channel_storage += snapshot_ring_size(&channel->ring);
+  }
+  breadcrumbs_clamp_loops(breadcrumbs, count);
+
+  unsigned int values_buf_used = 0;
+  for (int index = 0; index < count; ++index) {
+    breadcrumb_format_values(&breadcrumbs[index], values_buf, s_report_breadcrumb_values_buf_size, &values_buf_used);
   }
+
+  snapshot->breadcrumbs = breadcrumbs;
+  snapshot->breadcrumb_count = count;
+  return true;
+}
+
+int forensics_value_format(const forensics_value_t* value, char* buf, size_t buf_size) {
+  switch (value->type) {
+    case FORENSICS_VALUE_STRING:
+      return snprintf(buf, buf_size, "%s", value->as.str);
+    case FORENSICS_VALUE_INT64:
+      return snprintf(buf, buf_size, "%" PRId64, value->as.i64);
+    case FORENSICS_VALUE_UINT64:
+      return snprintf(buf, buf_size, "%" PRIu64, value->as.u64);
+    case FORENSICS_VALUE_DOUBLE:
+      return snprintf(buf, buf_size, "%.*g", DBL_DIG, value->as.f64);
+    case FORENSICS_VALUE_POINTER:
+      return snprintf(buf, buf_size, "%p", value->as.ptr);
+    case FORENSICS_VALUE_BOOL:
+      return snprintf(buf, buf_size, "%s", value->as.b ? "true" : "false");
+  }
+  if (buf_size > 0) {
+    buf[0] = 0;
+  }
+  return 0;
 }
 
 void forensics_default_report_handler(const forensics_report_t* report) {
@@ -523,6 +4257,113 @@ void forensics_default_report_handler(const forensics_report_t* report) {
   }
 }
 
+// Hashes the names on the context stack that weren't hashed when they were pushed. The hashes are kept, so each name is
+// only hashed once however many reports it is in.
+static void report_hash_contexts(forensics_context_stack_t* stack) {
+  for (int index = 0; index < stack->count; ++index) {
+    if (stack->hashes[index] == 0) {
+      stack->hashes[index] = forensics_context_name_hash(stack->names[index]);
+    }
+  }
+}
+
+// Keeps the latest published attribute list from being reused while a report is built and handled.
+struct report_attribute_pin_t {
+  report_attribute_pin_t()
+      : version(attribute_version_pin()) {
+  }
+  ~report_attribute_pin_t() {
+    attribute_version_unpin();
+  }
+
+  const attribute_version_t* version;
+};
+
+// Collects the attributes set with `forensics_set_attribute()`, the registered attributes that have values, the numeric
+// attributes, the values from the attribute providers and the reporting thread's attributes into one list for the
+// report. A thread attribute takes the place of a process-wide one with the same key, and of any older thread attribute
+// with that key. Must be called with `s_report_mutex` held.
+static void report_gather_attributes(forensics_report_t* report, const attribute_version_t* version) {
+  int count = 0;
+  for (int index = 0; index < version->count; ++index) {
+    s_report_attribute_keys[count] = version->keys[index];
+    s_report_attribute_values[count] = version->values[index];
+    s_report_attribute_typed_values[count] = forensics_value_str(version->values[index]);
+    ++count;
+  }
+
+  char* values_buf = s_report_attribute_values_buf;
+  const unsigned int registered_count = s_registered_attribute_count.load(std::memory_order_acquire);
+  for (unsigned int index = 0; index < registered_count; ++index) {
+    registered_attribute_t* attribute = &s_registered_attributes[index];
+    if (!registered_attribute_copy(attribute, values_buf)) {
+      continue;
+    }
+    s_report_attribute_keys[count] = (char*)(attribute->block + 1);
+    s_report_attribute_values[count] = values_buf;
+    s_report_attribute_typed_values[count] = forensics_value_str(values_buf);
+    values_buf += attribute->value_size_bytes;
+    ++count;
+  }
+
+  // numbers are only formatted now
+  const unsigned int numeric_count = s_numeric_attribute_count.load(std::memory_order_acquire);
+  for (unsigned int index = 0; index < numeric_count; ++index) {
+    const numeric_attribute_t* attribute = &s_numeric_attributes[index];
+    char* value = s_report_numeric_values_buf + index * FORMATTED_VALUE_SIZE_BYTES;
+    s_report_attribute_typed_values[count] = numeric_attribute_value(attribute);
+    forensics_value_format(&s_report_attribute_typed_values[count], value, FORMATTED_VALUE_SIZE_BYTES);
+    s_report_attribute_keys[count] = (char*)attribute->key;
+    s_report_attribute_values[count] = value;
+    ++count;
+  }
+
+  const unsigned int provider_size_bytes = s_config.attribute_provider_value_size_bytes;
+  for (unsigned int index = 0; index < s_attribute_provider_count; ++index) {
+    const attribute_provider_t* provider = &s_attribute_providers[index];
+    char* value = s_report_attribute_provider_buf + index * provider_size_bytes;
+    value[0] = 0;
+    if (!provider->provider(value, provider_size_bytes, provider->user_data)) {
+      continue;
+    }
+    value[provider_size_bytes - 1] = 0;
+    s_report_attribute_keys[count] = (char*)provider->key;
+    s_report_attribute_values[count] = value;
+    s_report_attribute_typed_values[count] = forensics_value_str(value);
+    ++count;
+  }
+
+  const context_buffer_t* ctx_buf = &s_tls_context_buf;
+  const int process_count = count;
+  const int thread_count = ctx_buf->initialized ? ctx_buf->attribute_count : 0;
+  std::atomic_signal_fence(std::memory_order_acquire);
+  for (int index = thread_count - 1; index >= 0; --index) {
+    char* key = ctx_buf->attribute_keys[index];
+    bool shadowed = false;
+    for (int newer = index + 1; newer < thread_count && !shadowed; ++newer) {
+      shadowed = 0 == strcmp(key, ctx_buf->attribute_keys[newer]);
+    }
+    if (shadowed) {
+      continue;
+    }
+    int dest = 0;
+    while (dest < process_count && 0 != strcmp(key, s_report_attribute_keys[dest])) {
+      ++dest;
+    }
+    if (dest == process_count) {
+      dest = count++;
+    }
+    s_report_attribute_keys[dest] = key;
+    s_report_attribute_values[dest] = ctx_buf->attribute_values[index];
+    s_report_attribute_typed_values[dest] = forensics_value_str(ctx_buf->attribute_values[index]);
+  }
+
+  report->attribute_count = count;
+  report->attribute_keys = count > 0 ? s_report_attribute_keys : nullptr;
+  report->attribute_values = count > 0 ? s_report_attribute_values : nullptr;
+  report->attribute_typed_values = count > 0 ? s_report_attribute_typed_values : nullptr;
+}
+
 void forensics_report_crash(const char* message) {
   // grab the mutex so only one thread can crash at a time
   std::lock_guard<std::mutex> lock(s_report_mutex);
@@ -536,41 +4377,28 @@ void forensics_report_crash(const char* message) {
   report.format = message;
   report.formatted = message;
   report.fatal = true;
+  report.timestamp = forensics_private_clock_ns();
 
   // grab the context stack
-  context_buffer_t* ctx_buf = &s_tls_context_buf;
-  if (ctx_buf->count > 0) {
-    report.context_stack = ctx_buf->stack;
+  forensics_context_stack_t* ctx_stack = &forensics_private_context_stack;
+  if (ctx_stack->count > 0) {
+    report_hash_contexts(ctx_stack);
+    report.context_stack = ctx_stack->names;
+    report.context_hashes = ctx_stack->hashes;
   }
   else {
     report.context_stack = nullptr;
+    report.context_hashes = nullptr;
   }
-  report.context_count = ctx_buf->count;
+  report.context_count = ctx_stack->count;
 
   // gather the attributes
-  report.attribute_count = s_attribute_count;
-  if (s_attribute_count > 0) {
-    report.attribute_keys = s_attribute_keys;
-    report.attribute_values = s_attribute_values;
-  }
-  else {
-    report.attribute_keys = nullptr;
-    report.attribute_values = nullptr;
-  }
+  report_attribute_pin_t attribute_pin;
+  report_gather_attributes(&report, attribute_pin.version);
 
   // gather the breadcrumbs
-  report.breadcrumb_count = s_breadcrumbs_count;
-  if (s_breadcrumbs_count > 0) {
-    report.breadcrumbs = s_report_breadcrumbs;
-    for (unsigned int index = 0; index < s_breadcrumbs_count; ++index) {
-      const int src_index = (s_breadcrumbs_index_next + s_config.max_breadcrumb_count - s_breadcrumbs_count + index) %
-                            s_config.max_breadcrumb_count;
-      s_report_breadcrumbs[index] = s_breadcrumbs[src_index].crumb;
-    }
-  }
-  else {
-    report.breadcrumbs = nullptr;
-  }
+  report_breadcrumb_lock_t breadcrumb_lock;
+  report_gather_breadcrumbs(&report);
 
   // capture the backtrace
   report.backtrace_count = forensics_private_backtrace(s_backtrace_buf, s_config.max_backtrace_count);
@@ -592,6 +4420,7 @@ void forensics_report_crash(const char* message) {
 
   // halting?
   if (s_config.fatal_should_halt) {
+    store_set_state(STORE_STATE_REPORTED);
     panic();
   }
 }
@@ -616,41 +4445,28 @@ void forensics_report_assert_failure(const char* file, int line, const char* fun
   report.format = format;
   report.formatted = s_report_formatted_msg;
   report.fatal = fatal;
+  report.timestamp = forensics_private_clock_ns();
 
   // grab the context stack
-  context_buffer_t* ctx_buf = &s_tls_context_buf;
-  if (ctx_buf->count > 0) {
-    report.context_stack = ctx_buf->stack;
+  forensics_context_stack_t* ctx_stack = &forensics_private_context_stack;
+  if (ctx_stack->count > 0) {
+    report_hash_contexts(ctx_stack);
+    report.context_stack = ctx_stack->names;
+    report.context_hashes = ctx_stack->hashes;
   }
   else {
     report.context_stack = nullptr;
+    report.context_hashes = nullptr;
   }
-  report.context_count = ctx_buf->count;
+  report.context_count = ctx_stack->count;
 
   // gather the attributes
-  report.attribute_count = s_attribute_count;
-  if (s_attribute_count > 0) {
-    report.attribute_keys = s_attribute_keys;
-    report.attribute_values = s_attribute_values;
-  }
-  else {
-    report.attribute_keys = nullptr;
-    report.attribute_values = nullptr;
-  }
+  report_attribute_pin_t attribute_pin;
+  report_gather_attributes(&report, attribute_pin.version);
 
   // gather the breadcrumbs
-  report.breadcrumb_count = s_breadcrumbs_count;
-  if (s_breadcrumbs_count > 0) {
-    report.breadcrumbs = s_report_breadcrumbs;
-    for (unsigned int index = 0; index < s_breadcrumbs_count; ++index) {
-      const int src_index = (s_breadcrumbs_index_next + s_config.max_breadcrumb_count - s_breadcrumbs_count + index) %
-                            s_config.max_breadcrumb_count;
-      s_report_breadcrumbs[index] = s_breadcrumbs[src_index].crumb;
-    }
-  }
-  else {
-    report.breadcrumbs = nullptr;
-  }
+  report_breadcrumb_lock_t breadcrumb_lock;
+  report_gather_breadcrumbs(&report);
 
   // capture the backtrace
   report.backtrace_count = forensics_private_backtrace(s_backtrace_buf, s_config.max_backtrace_count);
@@ -682,6 +4498,7 @@ void forensics_report_assert_failure(const char* file, int line, const char* fun
 
   // halting?
   if (fatal && s_config.fatal_should_halt) {
+    store_set_state(STORE_STATE_REPORTED);
     panic();
   }
 }
@@ -1,20 +1,128 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// The type of a `forensics_value_t`.
+typedef enum forensics_value_type_t {
+  FORENSICS_VALUE_STRING,
+  FORENSICS_VALUE_INT64,
+  FORENSICS_VALUE_UINT64,
+  FORENSICS_VALUE_DOUBLE,
+  FORENSICS_VALUE_POINTER,
+  FORENSICS_VALUE_BOOL,
+} forensics_value_type_t;
+
+// A typed value that is stored as raw bytes and only formatted as a string when it is needed.
+typedef struct forensics_value_t {
+  forensics_value_type_t type;
+  union {
+    const char* str;
+    int64_t i64;
+    uint64_t u64;
+    double f64;
+    const void* ptr;
+    bool b;
+  } as;
+} forensics_value_t;
+
 // Contains information about a single breadcrumb in a report.
 typedef struct forensics_breadcrumb_t {
-  const char* name;         // the name of this breadcrumb
-  const char** meta_keys;   // array of metadata key strings
-  const char** meta_values; // array of metadata value strings
-  int meta_count;           // the number of metadata key/value pairs
-  int count;                // the number of times this breadcrumb occurred in a row
+  const char* name;                           // the name of this breadcrumb
+  const char** meta_keys;                     // array of metadata key strings
+  const char** meta_values;                   // array of metadata value strings
+  const forensics_value_t* meta_typed_values; // array of typed metadata values (NULL if the values were strings)
+  int meta_count;                             // the number of metadata key/value pairs
+  int count;                                  // the number of times this breadcrumb occurred in a row
+  int loop_length; // if not 0, this breadcrumb ends a block of this many breadcrumbs that was repeated `loop_count` times
+  int loop_count;  // the number of times the block ending with this breadcrumb occurred in a row
+  uint64_t first_timestamp; // when this breadcrumb was first left (monotonic nanoseconds, see `forensics_report_t`)
+  uint64_t last_timestamp;  // when this breadcrumb was most recently left, e.g. the end of a coalesced run
+  const char* channel;      // the channel this breadcrumb was left in (NULL for the default channel)
 } forensics_breadcrumb_t;
 
+// A run of breadcrumbs that are stored `stride_bytes` apart, oldest first. Reports describe their breadcrumbs with a few
+// of these so that handlers can walk them where they are stored rather than having them copied into an array first.
+typedef struct forensics_breadcrumb_span_t {
+  const forensics_breadcrumb_t* first; // the oldest breadcrumb in the span
+  int count;                           // the number of breadcrumbs in the span
+  int stride_bytes;                    // the distance in bytes from one breadcrumb to the next
+} forensics_breadcrumb_span_t;
+
+// The most spans a report uses for its breadcrumbs: copies of the oldest few if they claim to be part of a repeated
+// block that has been pushed out of the ring, the two segments of the ring buffer on either side of where it wraps
+// around, then any breadcrumbs from a partial pass through a repeated block.
+#define FORENSICS_MAX_BREADCRUMB_SPAN_COUNT 4
+
+// Returns the breadcrumb at the given index within a span.
+static inline const forensics_breadcrumb_t* forensics_breadcrumb_span_at(const forensics_breadcrumb_span_t* span,
+                                                                         int index) {
+  return (const forensics_breadcrumb_t*)((const char*)span->first + (ptrdiff_t)index * span->stride_bytes);
+}
+
+// Called with each archived breadcrumb by `forensics_report_archived_breadcrumbs()`.
+typedef void (*forensics_breadcrumb_visitor_t)(const forensics_breadcrumb_t* breadcrumb, void* user_data);
+
+// The breadcrumbs copied by `forensics_snapshot_breadcrumbs()`.
+typedef struct forensics_breadcrumb_snapshot_t {
+  const forensics_breadcrumb_t* breadcrumbs; // in order, oldest first
+  int breadcrumb_count;
+  int skipped_channel_count; // channels (or CPU rings) left out because they changed on every attempt to copy them
+} forensics_breadcrumb_snapshot_t;
+
+// A breadcrumb given to `forensics_add_breadcrumbs()`.
+typedef struct forensics_breadcrumb_entry_t {
+  const char* name;                           // the name of the breadcrumb
+  const char** meta_keys;                     // array of metadata key strings
+  const char** meta_values;                   // array of metadata value strings (ignored if there are typed values)
+  const forensics_value_t* meta_typed_values; // array of typed metadata values (NULL to use `meta_values`)
+  int meta_count;                             // the number of metadata key/value pairs
+} forensics_breadcrumb_entry_t;
+
+// A handle to a string registered with `forensics_intern_string()`.
+typedef uint32_t forensics_string_t;
+
+// The handle value that never refers to an interned string.
+#define FORENSICS_STRING_INVALID 0
+
+// A handle to an attribute registered with `forensics_attribute_register()`.
+typedef uint32_t forensics_attribute_t;
+
+// The handle value that never refers to a registered attribute.
+#define FORENSICS_ATTRIBUTE_INVALID 0
+
+// A handle to an attribute registered with `forensics_numeric_attribute_register()`.
+typedef uint32_t forensics_numeric_attribute_t;
+
+// The handle value that never refers to a numeric attribute.
+#define FORENSICS_NUMERIC_ATTRIBUTE_INVALID 0
+
+// Called while a report is built to fill in the value of an attribute registered with
+// `forensics_register_attribute_provider()`. Write a null terminated value of up to `buf_size_bytes` (including null
+// terminator) into `buf` and return true, or return false to leave the attribute out of the report.
+typedef bool (*forensics_attribute_provider_t)(char* buf, unsigned int buf_size_bytes, void* user_data);
+
+// A handle to a breadcrumb channel returned by `forensics_breadcrumb_channel()`.
+typedef uint32_t forensics_channel_t;
+
+// The handle of the default breadcrumb channel, which is configured by the top-level breadcrumb settings.
+#define FORENSICS_CHANNEL_DEFAULT 0
+
+// Breadcrumb levels used by the `FORENSICS_BREADCRUMB_*` macros, from the most verbose to the most important.
+#define FORENSICS_BREADCRUMB_LEVEL_TRACE 0
+#define FORENSICS_BREADCRUMB_LEVEL_DEBUG 1
+#define FORENSICS_BREADCRUMB_LEVEL_INFO 2
+#define FORENSICS_BREADCRUMB_LEVEL_WARN 3
+#define FORENSICS_BREADCRUMB_LEVEL_ERROR 4
+#define FORENSICS_BREADCRUMB_LEVEL_OFF 5
+
 // All the information available in an error report.
 typedef struct forensics_report_t {
   const char* id;         // A agrregation id (or fingerprint) for this report: "CONTEXT-FILE_BASENAME-FUNC-MSG_FORMAT_STRING"
@@ -25,21 +133,68 @@ typedef struct forensics_report_t {
   const char* format;     // The format string (i.e. the unformatted message).
   const char* formatted;  // The formatted message.
   bool fatal;             // Is this a fatal assertion?
+  uint64_t timestamp;     // When the report was generated, in nanoseconds on the same monotonic clock as breadcrumbs.
 
-  const forensics_breadcrumb_t* breadcrumbs; // Array of breadcrumbs that have been left, in order.
+  const forensics_breadcrumb_t* breadcrumbs; // Array of breadcrumbs that have been left, in order (see `flatten_report_breadcrumbs`).
   int breadcrumb_count;                      // The number of breadcrumbs.
 
+  forensics_breadcrumb_span_t breadcrumb_spans[FORENSICS_MAX_BREADCRUMB_SPAN_COUNT]; // The breadcrumbs where they are stored.
+  int breadcrumb_span_count;                                                       // The number of spans in use.
+  int archived_breadcrumb_count; // The number of older breadcrumbs in the archive, see `forensics_report_archived_breadcrumbs()`.
+
   const char* const* context_stack; // The stack of error contexts. The most recent (i.e. responsible one) is at the end.
+  const uint64_t* context_hashes;   // The hash of each context name, see `forensics_context_name_hash()`.
   int context_count;                // The number of contexts on the stack
 
-  const char* const* attribute_keys;   // Array of attribute key strings
-  const char* const* attribute_values; // Array of attribute value strings
-  int attribute_count;                 // The number of attributes
+  const char* const* attribute_keys;               // Array of attribute key strings
+  const char* const* attribute_values;             // Array of attribute value strings
+  const forensics_value_t* attribute_typed_values; // Array of typed attribute values (strings for most attributes)
+  int attribute_count;                             // The number of attributes
 
   const void* const* backtrace; // The code pointers that make up the backtrace at the point where the thread trigger the error report.
   int backtrace_count;          // The number of frames in the backtrace.
 } forensics_report_t;
 
+// How breadcrumbs are stored.
+typedef enum forensics_breadcrumb_mode_t {
+  // All threads share a single ring buffer guarded by a mutex. Reports list breadcrumbs in the exact order they were
+  // left.
+  FORENSICS_BREADCRUMB_MODE_GLOBAL,
+
+  // Each thread writes into its own ring buffer without taking any locks. Every breadcrumb is stamped with a monotonic
+  // timestamp and the rings are merged in time order when a report is generated. Breadcrumbs left while a report is
+  // being handled are dropped rather than waiting for the report to finish. A thread's breadcrumbs are discarded when
+  // the thread exits.
+  FORENSICS_BREADCRUMB_MODE_PER_THREAD,
+
+  // All threads share a single ring of fixed-size slots. Writers reserve a slot with an atomic increment and publish it
+  // with a sequence number, so they never take a lock and reports list breadcrumbs in a single global order. Slots that
+  // are still being written when a report is generated are left out. Each slot holds `breadcrumb_slot_size_bytes` of
+  // data; breadcrumbs too big for a slot lose metadata pairs from the end.
+  FORENSICS_BREADCRUMB_MODE_LOCK_FREE,
+
+  // Each CPU has its own ring buffer, which the threads running on it write to. The rings are merged in time order when
+  // a report is generated, like `FORENSICS_BREADCRUMB_MODE_PER_THREAD`, but memory grows with the number of CPUs
+  // rather than the number of threads. Each ring has a lock, which is only contended when a thread is moved to another
+  // CPU part way through leaving a breadcrumb. The current CPU is read from the restartable sequences area on Linux
+  // (falling back to `sched_getcpu()`) and from `GetCurrentProcessorNumberEx()` on Windows. Elsewhere there is a single
+  // ring.
+  FORENSICS_BREADCRUMB_MODE_PER_CPU,
+} forensics_breadcrumb_mode_t;
+
+// Configures an extra breadcrumb channel. Each channel has its own ring buffer and lock, so a busy channel can't push
+// the breadcrumbs out of another one and threads writing to different channels don't contend with each other.
+typedef struct forensics_breadcrumb_channel_config_t {
+  // The name of the channel, used to look it up with `forensics_breadcrumb_channel()`. The name is copied.
+  const char* name;
+
+  // The maximum number of breadcrumbs to keep in this channel.
+  unsigned int max_breadcrumb_count;
+
+  // The maximum byte size for all breadcrumb data in this channel.
+  unsigned int breadcrumb_buf_size_bytes;
+} forensics_breadcrumb_channel_config_t;
+
 typedef void (*forensics_report_handler_t)(const forensics_report_t* report);
 
 typedef void* (*forensics_alloc_t)(size_t size, void* user_data, const char* file, int line, const char* func);
@@ -65,25 +220,123 @@ typedef struct forensics_config_t {
   // The maximum number of attributes that can be set at once.
   unsigned int max_attribute_count;
 
-  // The maximum byte size for all attribute data.
+  // The maximum byte size for all attribute data. Each attribute's key and value are kept together in a block with an 8
+  // byte header, rounded up to a multiple of 16 bytes. Freed blocks are reused, split, and merged with free neighbors.
   unsigned int attribute_buf_size_bytes;
 
+  // The maximum number of attributes that can be registered with `forensics_attribute_register()`. Their blocks are
+  // taken from the attribute buffer when they are registered.
+  unsigned int max_registered_attribute_count;
+
+  // Set to true so `forensics_attribute_set_by_handle()` skips the lock shared with `forensics_set_attribute()`, which
+  // is handy for values that change constantly on many threads. Each registered attribute still has its own spinlock
+  // (its sequence counter), so threads setting the same attribute take turns while ones setting different attributes
+  // never wait on each other. When false (the default), setting a registered attribute takes the shared lock as well.
+  // Either way, reports don't lock registered attributes: they check the sequence counter to see they didn't read a
+  // value while it was being written, and a value that stays in the middle of being written is left out.
+  bool relaxed_attribute_handles;
+
+  // The maximum number of attributes that can be registered with `forensics_numeric_attribute_register()`.
+  unsigned int max_numeric_attribute_count;
+
+  // The maximum number of attributes that can be registered with `forensics_register_attribute_provider()`.
+  unsigned int max_attribute_provider_count;
+
+  // The room each attribute provider has to write its value into (including null terminator).
+  unsigned int attribute_provider_value_size_bytes;
+
+  // The maximum number of attributes each thread can have at once with `forensics_thread_attribute_begin()`.
+  unsigned int max_thread_attribute_count;
+
+  // The maximum byte size for each thread's attribute data.
+  unsigned int thread_attribute_buf_size_bytes;
+
   // The maximum number of stack frames for a backtrace.
   unsigned int max_backtrace_count;
 
-  // The maximum number of breadcrumbs to keep.
+  // The maximum number of breadcrumbs to keep. In `FORENSICS_BREADCRUMB_MODE_PER_THREAD` this is per thread and also
+  // caps the number of breadcrumbs in a report. In `FORENSICS_BREADCRUMB_MODE_PER_CPU` this is per CPU.
   unsigned int max_breadcrumb_count;
 
-  // The maximum byte size for all breadcrumb data.
+  // The maximum byte size for all breadcrumb data. In `FORENSICS_BREADCRUMB_MODE_PER_THREAD` this is per thread and in
+  // `FORENSICS_BREADCRUMB_MODE_PER_CPU` it is per CPU.
   unsigned int breadcrumb_buf_size_bytes;
 
+  // How breadcrumbs are stored. Defaults to `FORENSICS_BREADCRUMB_MODE_GLOBAL`.
+  forensics_breadcrumb_mode_t breadcrumb_mode;
+
+  // The byte size of each breadcrumb's slot in `FORENSICS_BREADCRUMB_MODE_LOCK_FREE`, which takes the place of
+  // `breadcrumb_buf_size_bytes` there. A slot holds a breadcrumb's name and metadata strings along with its metadata
+  // arrays. A breadcrumb that doesn't fit keeps as many metadata pairs as do, and its name is cut short if even that is
+  // too long. The slots take `max_breadcrumb_count * breadcrumb_slot_size_bytes` in all. Defaults to 256.
+  unsigned int breadcrumb_slot_size_bytes;
+
+  // The longest block of breadcrumbs that is recognized when it repeats. A block that is left again and again (e.g. the
+  // same few breadcrumbs on every pass through an event loop) is stored once along with a count, so it doesn't push
+  // older breadcrumbs out of the ring. Set to 0 or 1 to only coalesce single breadcrumbs. In
+  // `FORENSICS_BREADCRUMB_MODE_PER_THREAD` blocks are found within each thread and `loop_length` only counts that
+  // thread's breadcrumbs, which a report may interleave with other threads'. The same goes for each CPU in
+  // `FORENSICS_BREADCRUMB_MODE_PER_CPU`. Not supported in `FORENSICS_BREADCRUMB_MODE_LOCK_FREE`.
+  unsigned int max_breadcrumb_loop_length;
+
+  // Extra breadcrumb channels to create, on top of the default channel. Channels are always stored in a ring buffer
+  // guarded by a mutex of its own, whatever the `breadcrumb_mode`. Reports merge the breadcrumbs from every channel in
+  // time order; `loop_length` only counts breadcrumbs from the same channel. The array is copied. Defaults to none.
+  const forensics_breadcrumb_channel_config_t* breadcrumb_channels;
+  unsigned int breadcrumb_channel_count;
+
+  // The maximum byte size for a second, compressed tier of breadcrumb history. Breadcrumbs pushed out of the ring are
+  // packed into blocks of `breadcrumb_archive_block_size_bytes`, and each block is compressed into the archive once it
+  // fills up. The oldest blocks are dropped to make room. Reports only count the archived breadcrumbs; they are
+  // decompressed when `forensics_report_archived_breadcrumbs()` is called. Archived breadcrumbs keep up to 32 metadata
+  // pairs. Only the default channel in `FORENSICS_BREADCRUMB_MODE_GLOBAL` is archived. Defaults to 0 (no archive).
+  unsigned int breadcrumb_archive_size_bytes;
+
+  // The byte size of a block of archived breadcrumbs before it is compressed. Bigger blocks compress better but take
+  // longer to compress, which happens on the thread whose breadcrumb fills the block.
+  unsigned int breadcrumb_archive_block_size_bytes;
+
+  // The lowest level of breadcrumb left through the `FORENSICS_BREADCRUMB_*` macros that is kept. This can be changed
+  // later with `forensics_set_breadcrumb_level()`. Defaults to `FORENSICS_BREADCRUMB_LEVEL_TRACE` (keep everything).
+  int breadcrumb_level;
+
+  // Copy the breadcrumbs into `forensics_report_t::breadcrumbs` for every report. Turn this off if your report handler
+  // walks `breadcrumb_spans` instead, which saves unwrapping the whole ring on each report;
+  // `forensics_report_breadcrumbs()` still builds the array when it is needed. Only `FORENSICS_BREADCRUMB_MODE_GLOBAL`
+  // without any `breadcrumb_channels` reports breadcrumbs in place, and only while none of them has typed values to
+  // format; the others always merge them into the array and fill in `breadcrumbs` anyway.
+  // Defaults to true.
+  bool flatten_report_breadcrumbs;
+
+  // The maximum number of distinct strings that can be interned with `forensics_intern_string()`.
+  unsigned int max_interned_string_count;
+
+  // The maximum byte size for all interned string data.
+  unsigned int interned_string_buf_size_bytes;
+
+  // A file to keep the breadcrumbs and attributes in so that they survive the process being killed without a chance to
+  // report (e.g. by SIGKILL from the OOM killer). The file is mapped into memory, so leaving breadcrumbs and setting
+  // attributes are still plain memory writes and the OS takes care of writing them out. When `forensics_lib_init()` is
+  // next called with the same path, a report is built from whatever the previous run left in the file and passed to
+  // `previous_run_handler`, unless that run called `forensics_lib_shutdown()` or halted after a fatal report. Only the
+  // breadcrumbs in the default channel in `FORENSICS_BREADCRUMB_MODE_GLOBAL` are kept in the file. If the file can't be
+  // mapped, everything is kept in memory as usual. The path is only used during `forensics_lib_init()`. Defaults to
+  // NULL (no file).
+  const char* persistent_store_path;
+
+  // Called from `forensics_lib_init()` with the report for a previous run that ended without one (see
+  // `persistent_store_path`). The report only has the breadcrumbs and attributes, and its timestamp is that of the
+  // newest breadcrumb on the previous run's clock. Interned names and keys are shown as "<interned>". Defaults to NULL.
+  forensics_report_handler_t previous_run_handler;
+
   // The report handler to use for errors.
   forensics_report_handler_t report_handler;
 
   // Function used to allocate data needed by this library. Most of the allocation happens at initialization, but if you
-  // use contexts, there is an allocation for each thread the first time `forensics_context_begin()` is called on that
-  // thread. Thus if you use contexts, this allocation function must be thread-safe. The default allocator function is
-  // plain-old `malloc()`.
+  // use contexts or thread attributes, there is an allocation for each thread the first time `forensics_context_begin()`
+  // or `forensics_thread_attribute_begin()` is called on that thread. The same goes for the first breadcrumb left on
+  // each thread in `FORENSICS_BREADCRUMB_MODE_PER_THREAD`. Thus if you use either, this allocation function must be
+  // thread-safe. The default allocator function is plain-old `malloc()`.
   forensics_alloc_t alloc;
 
   // Function used to free memory allocated by `alloc()`. This has the same thread-safety requirements as `alloc`. The
@@ -99,7 +352,8 @@ void forensics_config_init(forensics_config_t* config);
 
 // Initializes this library with the given configuration. If NULL is given, then the default configuration will be used.
 // This will allocate the buffers required to do all error handling and reporting except for a context stack buffer that
-// is allocated for each thread that chooses to push on a context with `forensics_context_begin()`.
+// is allocated for each thread that chooses to push on a context with `forensics_context_begin()` (or an attribute with
+// `forensics_thread_attribute_begin()`).
 void forensics_lib_init(const forensics_config_t* config);
 
 // Tears down this library and frees all allocations.
@@ -113,12 +367,40 @@ void forensics_lib_shutdown();
 // common pattern is to assert on the arguments to a library's public API functions and then assume ownership of any
 // further errors by establishing itself as the current context.
 //
-// The name is copied into a thread-local buffer and does not need to live for the duration of the context.
+// Only a pointer to the name is kept, so it must stay valid until the context ends. String literals always do; use
+// `forensics_context_begin_copy()` for names that don't.
+//
+// `FORENSICS_CONTEXT` does the same push inline: a thread-local load, a compare and a store, with only the first push
+// on a thread (which allocates its stack), overflow and underflow calling into the library.
 void forensics_context_begin(const char* name);
 
+// The same as `forensics_context_begin()` except the name is interned with `forensics_intern_string()`, so it is copied
+// the first time it is seen and doesn't need to live for the duration of the context. Later pushes of the same name
+// find the copy without taking a lock, though they still hash the name. Each new name takes a lock and permanently uses
+// up room in the interned string table, so this is meant for a bounded set of names. Once the table is full, new names
+// are pushed as "<unknown>" without a report.
+void forensics_context_begin_copy(const char* name);
+
+// The same as `forensics_context_begin()` except the name is given as an interned string handle, which skips hashing
+// it.
+void forensics_context_begin_interned(forensics_string_t name);
+
 // Pops a context off the stack for the current thread.
 void forensics_context_end();
 
+// Pushes on an attribute for the current thread only. While it is there, reports from this thread have it in place of
+// any attribute with the same key set with `forensics_set_attribute()` or pushed on earlier. Use this for per-request
+// data such as a user id on a thread pool, where process-wide attributes would overwrite each other. It is expected
+// that `forensics_thread_attribute_end()` is called once the code leaves the scope the attribute applies to. The
+// thread attributes are only touched by their own thread, so this takes no lock.
+//
+// The key and value are copied into a thread-local buffer (allocated along with the context stack) and do not need to
+// persist once the call returns. Attributes that don't fit are left out.
+void forensics_thread_attribute_begin(const char* key, const char* value);
+
+// Pops an attribute off the stack for the current thread.
+void forensics_thread_attribute_end();
+
 // Adds a breadcrumb to the queue of breadcrumbs that have been left behind. This is basically a way to track
 // application evetns or state changes that have lead up to an error. Breadcrumbs are stored in a ring buffer, so you do
 // not need to worry about removing them.
@@ -127,16 +409,199 @@ void forensics_context_end();
 //
 // The name and metadata key/value pairs are copied into a buffer and do not need to persist once the call returns. If
 // the same breadcrumb is left sequentially, the subsequent breadcrumbs are coallesced into the first and do not take
-// any additional space.
+// any additional space. Likewise, a block of up to `max_breadcrumb_loop_length` breadcrumbs that is left over and over
+// again is only stored once and reported with `loop_length` and `loop_count` set on its last breadcrumb. Breadcrumbs
+// from a partial pass through the block are reported after it.
 void forensics_add_breadcrumb(const char* name, const char** meta_keys, const char** meta_values, int meta_count);
 
+// Adds several breadcrumbs at once, in order. This is the same as calling `forensics_add_breadcrumb()` (or
+// `forensics_add_breadcrumb_typed()`) for each of them except that the strings are all measured up front and the lock is
+// only taken once for up to 32 breadcrumbs. Breadcrumbs that are certain to be pushed out of the ring by the later ones
+// in the batch are skipped.
+void forensics_add_breadcrumbs(const forensics_breadcrumb_entry_t* breadcrumbs, int count);
+
+// Looks up the handle of a channel configured in `breadcrumb_channels`. Returns `FORENSICS_CHANNEL_DEFAULT` if there is
+// no channel with the given name, so breadcrumbs left with the handle still end up somewhere.
+forensics_channel_t forensics_breadcrumb_channel(const char* name);
+
+// The same as `forensics_add_breadcrumb()` except the breadcrumb is left in the given channel.
+void forensics_add_channel_breadcrumb(forensics_channel_t channel,
+                                      const char* name,
+                                      const char** meta_keys,
+                                      const char** meta_values,
+                                      int meta_count);
+
+// The same as `forensics_add_breadcrumb()` except the metadata values are typed. Values are copied into the breadcrumb
+// buffer as raw bytes (strings are copied as usual) and are only formatted when a report is generated, so there is no
+// need to format numbers on the hot path. Reports include both the formatted `meta_values` and the `meta_typed_values`.
+void forensics_add_breadcrumb_typed(const char* name,
+                                    const char** meta_keys,
+                                    const forensics_value_t* meta_values,
+                                    int meta_count);
+
+// The same as `forensics_add_breadcrumbs()` except the breadcrumbs are left in the given channel.
+void forensics_add_channel_breadcrumbs(forensics_channel_t channel,
+                                       const forensics_breadcrumb_entry_t* breadcrumbs,
+                                       int count);
+
+// The same as `forensics_add_breadcrumb_typed()` except the breadcrumb is left in the given channel.
+void forensics_add_channel_breadcrumb_typed(forensics_channel_t channel,
+                                            const char* name,
+                                            const char** meta_keys,
+                                            const forensics_value_t* meta_values,
+                                            int meta_count);
+
+// Registers a string (typically a breadcrumb name or metadata key) and returns a small handle for it. The string is
+// copied once into a buffer owned by this library, so it does not need to persist once the call returns. Interning the
+// same string again returns the same handle. Returns `FORENSICS_STRING_INVALID` if the interned string storage is full.
+//
+// Handles stay valid until `forensics_lib_shutdown()` is called. This is thread-safe but takes a lock, so intern your
+// strings once up front rather than on every use.
+forensics_string_t forensics_intern_string(const char* str);
+
+// Returns the string for a handle from `forensics_intern_string()` or NULL if the handle is not valid.
+const char* forensics_interned_string(forensics_string_t handle);
+
+// The same as `forensics_add_breadcrumb()` except the name and metadata keys are given as interned string handles. They
+// are stored by reference rather than copied, so only the metadata values take up space in the breadcrumb buffer.
+void forensics_add_breadcrumb_interned(forensics_string_t name,
+                                       const forensics_string_t* meta_keys,
+                                       const char** meta_values,
+                                       int meta_count);
+
+// The same as `forensics_add_breadcrumb_interned()` except the breadcrumb is left in the given channel.
+void forensics_add_channel_breadcrumb_interned(forensics_channel_t channel,
+                                               forensics_string_t name,
+                                               const forensics_string_t* meta_keys,
+                                               const char** meta_values,
+                                               int meta_count);
+
+// Sets the lowest level of breadcrumb left through the `FORENSICS_BREADCRUMB_*` macros that is kept. This is safe to call
+// from any thread at any time.
+void forensics_set_breadcrumb_level(int level);
+
+// Returns the lowest level of breadcrumb left through the `FORENSICS_BREADCRUMB_*` macros that is kept.
+int forensics_get_breadcrumb_level();
+
+// The current breadcrumb level. Use `forensics_set_breadcrumb_level()` to change it.
+extern int forensics_private_breadcrumb_level;
+
 // Sets an arbitrary attribute as a key/value pair that will be made available to error reports. Setting the value to
 // NULL will remove the attribute. You can use this to set arbitrary data that you feel would be useful like a build id,
 // platform name, runtime environment, etc.
 //
-// The key and value are copied into a buffer and do not need to persist once the call returns.
+// The key and value are copied into a buffer and do not need to persist once the call returns. Each call publishes a
+// new copy of the list of attributes, and reports read whichever copy was latest when they started, so this never
+// waits on a report handler.
 void forensics_set_attribute(const char* key, const char* value);
 
+// Sets several attributes at once, in order. This is the same as calling `forensics_set_attribute()` for each pair
+// except that the lock is only taken once and a single new list of attributes is published at the end, so a report sees
+// either none of the changes or all of them. A NULL value removes that attribute.
+void forensics_set_attributes(const char* const* keys, const char* const* values, int count);
+
+// Registers an attribute whose value will change often and returns a handle to set it with. Room for the key and a
+// value of up to `max_value_size_bytes` (including null terminator) is set aside now, so setting it later is just a
+// copy of the value. Registering the same key again returns the same handle (and keeps the original size). Don't also set
+// the key with `forensics_set_attribute()`. Returns `FORENSICS_ATTRIBUTE_INVALID` if there is no room for it.
+forensics_attribute_t forensics_attribute_register(const char* key, unsigned int max_value_size_bytes);
+
+// Registers an attribute whose value is only worked out when a report is built, by calling `provider` with a buffer of
+// `attribute_provider_value_size_bytes`. Use this for values that are expensive to keep up to date but only matter when
+// something goes wrong, like the resident set size or the number of open files. Registering the same key again
+// replaces its provider. The key is interned with `forensics_intern_string()`. Returns false if there is no room for
+// it.
+//
+// Providers are called with the report lock held, so they must not cause a report themselves. Since crash reports are
+// built in the signal handler, providers should stick to async-signal-safe calls.
+bool forensics_register_attribute_provider(const char* key, forensics_attribute_provider_t provider, void* user_data);
+
+// Sets the value of a registered attribute. Setting the value to NULL removes it from reports until it is set again.
+// Values that don't fit in the size given to `forensics_attribute_register()` are cut short. See
+// `relaxed_attribute_handles` for the locking.
+void forensics_attribute_set_by_handle(forensics_attribute_t attribute, const char* value);
+
+// Registers an attribute that holds a number, such as a counter or a gauge, and returns a handle to set it with. `type`
+// must be `FORENSICS_VALUE_INT64` or `FORENSICS_VALUE_DOUBLE`. The value starts at 0 and is kept as raw bits that are
+// only formatted when a report is built, where it is also in `attribute_typed_values` with its type. Registering the
+// same key again returns the same handle. The key is interned with `forensics_intern_string()`. Numeric attributes are
+// not kept in the persistent store. Returns `FORENSICS_NUMERIC_ATTRIBUTE_INVALID` if there is no room for it.
+forensics_numeric_attribute_t forensics_numeric_attribute_register(const char* key, forensics_value_type_t type);
+
+// Sets the value of a numeric attribute. These are a single relaxed atomic store (or add), so they can be called as
+// often as the value changes from any thread.
+void forensics_numeric_attribute_set_i64(forensics_numeric_attribute_t attribute, int64_t value);
+void forensics_numeric_attribute_add_i64(forensics_numeric_attribute_t attribute, int64_t delta);
+void forensics_numeric_attribute_set_f64(forensics_numeric_attribute_t attribute, double value);
+
+// Returns a report's breadcrumbs as a single array in order, copying them out of `breadcrumb_spans` if
+// `flatten_report_breadcrumbs` is off. This may only be called from within the report handler and the array is only
+// valid until it returns.
+const forensics_breadcrumb_t* forensics_report_breadcrumbs(const forensics_report_t* report);
+
+// Decompresses the breadcrumbs that were pushed out of the ring into the archive (see `breadcrumb_archive_size_bytes`)
+// and passes each one to `visitor`, oldest first. They are all older than the breadcrumbs in the report itself. The
+// breadcrumbs are only valid during the call to `visitor`. This may only be called from within the report handler.
+// Returns the number of breadcrumbs visited.
+int forensics_report_archived_breadcrumbs(const forensics_report_t* report,
+                                          forensics_breadcrumb_visitor_t visitor,
+                                          void* user_data);
+
+// Returns the size of the buffer `forensics_snapshot_breadcrumbs()` needs. This stays the same until the library is shut
+// down.
+size_t forensics_breadcrumb_snapshot_size();
+
+// Copies the current breadcrumbs into `buf` without blocking the threads that leave them, so it can be called from a
+// diagnostics thread as often as is useful. Each ring is copied while its writers keep going and the copy is retried if
+// a writer changed the ring part way through. A channel that changes on every attempt is left out and counted in
+// `skipped_channel_count`. The breadcrumbs point into `buf` and stay valid for as long as it does.
+//
+// Breadcrumbs in the default channel are not included in `FORENSICS_BREADCRUMB_MODE_PER_THREAD` since they are spread
+// over an unbounded number of thread rings. Returns false if `buf` is smaller than `forensics_breadcrumb_snapshot_size()`.
+bool forensics_snapshot_breadcrumbs(void* buf, size_t buf_size, forensics_breadcrumb_snapshot_t* snapshot);
+
+// Formats a typed value into `buf` the same way reports do. Returns the length of the full formatted string like
+// `snprintf()`.
+int forensics_value_format(const forensics_value_t* value, char* buf, size_t buf_size);
+
+// Helpers for building typed values.
+static inline forensics_value_t forensics_value_str(const char* value) {
+  forensics_value_t result;
+  result.type = FORENSICS_VALUE_STRING;
+  result.as.str = value;
+  return result;
+}
+static inline forensics_value_t forensics_value_i64(int64_t value) {
+  forensics_value_t result;
+  result.type = FORENSICS_VALUE_INT64;
+  result.as.i64 = value;
+  return result;
+}
+static inline forensics_value_t forensics_value_u64(uint64_t value) {
+  forensics_value_t result;
+  result.type = FORENSICS_VALUE_UINT64;
+  result.as.u64 = value;
+  return result;
+}
+static inline forensics_value_t forensics_value_f64(double value) {
+  forensics_value_t result;
+  result.type = FORENSICS_VALUE_DOUBLE;
+  result.as.f64 = value;
+  return result;
+}
+static inline forensics_value_t forensics_value_ptr(const void* value) {
+  forensics_value_t result;
+  result.type = FORENSICS_VALUE_POINTER;
+  result.as.ptr = value;
+  return result;
+}
+static inline forensics_value_t forensics_value_bool(bool value) {
+  forensics_value_t result;
+  result.type = FORENSICS_VALUE_BOOL;
+  result.as.b = value;
+  return result;
+}
+
 // The default report handler. It simply prints report information to stderr.
 void forensics_default_report_handler(const forensics_report_t* report);
 
@@ -178,23 +643,297 @@ void forensics_report_crash(const char* message);
 // Version of FORENSICS_ASSERT_DBG for asserting that a variable is not null.
 #define FORENSICS_ASSERT_IS_NOT_NULL_DBG(var) FORENSICS_ASSERT_DBGF((var) != NULL, #var " cannot be NULL")
 
+// The lowest level of breadcrumb macro that is compiled in. Define this before including this header (or on the command
+// line) to remove the more verbose breadcrumbs from a build entirely.
+#ifndef FORENSICS_BREADCRUMB_COMPILED_LEVEL
+#define FORENSICS_BREADCRUMB_COMPILED_LEVEL FORENSICS_BREADCRUMB_LEVEL_TRACE
+#endif
+
+#ifdef _MSC_VER
+#define FORENSICS_LOAD_RELAXED(var) (*(const volatile int*)&(var))
+#else
+#define FORENSICS_LOAD_RELAXED(var) __atomic_load_n(&(var), __ATOMIC_RELAXED)
+#endif
+
+// Checks if breadcrumbs of the given level are being kept at runtime. This is a single relaxed load, so it can guard code
+// that only exists to build up a breadcrumb.
+#define FORENSICS_BREADCRUMB_ENABLED(level) ((level) >= FORENSICS_LOAD_RELAXED(forensics_private_breadcrumb_level))
+
+#define FORENSICS_BREADCRUMB_EXPAND(x) x
+#define FORENSICS_BREADCRUMB_UNPAREN(...) __VA_ARGS__
+#define FORENSICS_BREADCRUMB_SELECT(_1, _2, _3, macro, ...) macro
+#define FORENSICS_BREADCRUMB_COUNT(array) (sizeof(array) / sizeof((array)[0]))
+
+// Fails to compile unless the metadata has exactly one value per key.
 #ifdef __cplusplus
+#define FORENSICS_BREADCRUMB_CHECK_META(keys, values)                                                                 \
+  static_assert(FORENSICS_BREADCRUMB_COUNT(keys) == FORENSICS_BREADCRUMB_COUNT(values),                               \
+                "breadcrumb metadata must have one value per key")
+#else
+#define FORENSICS_BREADCRUMB_CHECK_META(keys, values)                                                                 \
+  (void)sizeof(char[FORENSICS_BREADCRUMB_COUNT(keys) == FORENSICS_BREADCRUMB_COUNT(values) ? 1 : -1])
+#endif
+
+// Leaves a breadcrumb if its level is being kept. The name and the metadata are only evaluated if it is. The metadata is
+// given as a parenthesized list of keys and a parenthesized list of values, e.g.
+//
+//   FORENSICS_BREADCRUMB_AT(FORENSICS_BREADCRUMB_LEVEL_INFO, "connect", ("host", "port"), (host, port));
+#define FORENSICS_BREADCRUMB_AT(level, ...)                                                                           \
+  FORENSICS_BREADCRUMB_EXPAND(FORENSICS_BREADCRUMB_SELECT(                                                            \
+      __VA_ARGS__, FORENSICS_BREADCRUMB_AT_META, FORENSICS_BREADCRUMB_AT_INVALID, FORENSICS_BREADCRUMB_AT_NAME, )(    \
+      level, __VA_ARGS__))
+#define FORENSICS_BREADCRUMB_AT_NAME(level, name)                                                                     \
+  do {                                                                                                                \
+    if (FORENSICS_BREADCRUMB_ENABLED(level)) {                                                                        \
+      forensics_add_breadcrumb((name), NULL, NULL, 0);                                                                \
+    }                                                                                                                 \
+  } while (0)
+#define FORENSICS_BREADCRUMB_AT_META(level, name, meta_keys, meta_values)                                             \
+  do {                                                                                                                \
+    if (FORENSICS_BREADCRUMB_ENABLED(level)) {                                                                        \
+      const char* forensics_breadcrumb_keys__[] = {FORENSICS_BREADCRUMB_UNPAREN meta_keys};                           \
+      const char* forensics_breadcrumb_values__[] = {FORENSICS_BREADCRUMB_UNPAREN meta_values};                       \
+      FORENSICS_BREADCRUMB_CHECK_META(forensics_breadcrumb_keys__, forensics_breadcrumb_values__);                    \
+      forensics_add_breadcrumb((name),                                                                                \
+                               forensics_breadcrumb_keys__,                                                           \
+                               forensics_breadcrumb_values__,                                                         \
+                               (int)FORENSICS_BREADCRUMB_COUNT(forensics_breadcrumb_keys__));                         \
+    }                                                                                                                 \
+  } while (0)
+
+// The same as `FORENSICS_BREADCRUMB_AT()` except the metadata values are `forensics_value_t`s, which are only built if
+// the level is being kept.
+#define FORENSICS_BREADCRUMB_TYPED_AT(level, name, meta_keys, meta_values)                                            \
+  do {                                                                                                                \
+    if (FORENSICS_BREADCRUMB_ENABLED(level)) {                                                                        \
+      const char* forensics_breadcrumb_keys__[] = {FORENSICS_BREADCRUMB_UNPAREN meta_keys};                           \
+      const forensics_value_t forensics_breadcrumb_values__[] = {FORENSICS_BREADCRUMB_UNPAREN meta_values};           \
+      FORENSICS_BREADCRUMB_CHECK_META(forensics_breadcrumb_keys__, forensics_breadcrumb_values__);                    \
+      forensics_add_breadcrumb_typed((name),                                                                          \
+                                     forensics_breadcrumb_keys__,                                                     \
+                                     forensics_breadcrumb_values__,                                                   \
+                                     (int)FORENSICS_BREADCRUMB_COUNT(forensics_breadcrumb_keys__));                   \
+    }                                                                                                                 \
+  } while (0)
+
+// Leaves a breadcrumb of a given level. Each takes a name and optionally the metadata keys and values as parenthesized
+// lists (see `FORENSICS_BREADCRUMB_AT()`). Levels below `FORENSICS_BREADCRUMB_COMPILED_LEVEL` compile to nothing and
+// their arguments are never evaluated.
+#if FORENSICS_BREADCRUMB_COMPILED_LEVEL <= FORENSICS_BREADCRUMB_LEVEL_TRACE
+#define FORENSICS_BREADCRUMB_TRACE(...) FORENSICS_BREADCRUMB_AT(FORENSICS_BREADCRUMB_LEVEL_TRACE, __VA_ARGS__)
+#define FORENSICS_BREADCRUMB_TYPED_TRACE(...) FORENSICS_BREADCRUMB_TYPED_AT(FORENSICS_BREADCRUMB_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define FORENSICS_BREADCRUMB_TRACE(...) ((void)0)
+#define FORENSICS_BREADCRUMB_TYPED_TRACE(...) ((void)0)
+#endif
+#if FORENSICS_BREADCRUMB_COMPILED_LEVEL <= FORENSICS_BREADCRUMB_LEVEL_DEBUG
+#define FORENSICS_BREADCRUMB_DEBUG(...) FORENSICS_BREADCRUMB_AT(FORENSICS_BREADCRUMB_LEVEL_DEBUG, __VA_ARGS__)
+#define FORENSICS_BREADCRUMB_TYPED_DEBUG(...) FORENSICS_BREADCRUMB_TYPED_AT(FORENSICS_BREADCRUMB_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define FORENSICS_BREADCRUMB_DEBUG(...) ((void)0)
+#define FORENSICS_BREADCRUMB_TYPED_DEBUG(...) ((void)0)
+#endif
+#if FORENSICS_BREADCRUMB_COMPILED_LEVEL <= FORENSICS_BREADCRUMB_LEVEL_INFO
+#define FORENSICS_BREADCRUMB_INFO(...) FORENSICS_BREADCRUMB_AT(FORENSICS_BREADCRUMB_LEVEL_INFO, __VA_ARGS__)
+#define FORENSICS_BREADCRUMB_TYPED_INFO(...) FORENSICS_BREADCRUMB_TYPED_AT(FORENSICS_BREADCRUMB_LEVEL_INFO, __VA_ARGS__)
+#else
+#define FORENSICS_BREADCRUMB_INFO(...) ((void)0)
+#define FORENSICS_BREADCRUMB_TYPED_INFO(...) ((void)0)
+#endif
+#if FORENSICS_BREADCRUMB_COMPILED_LEVEL <= FORENSICS_BREADCRUMB_LEVEL_WARN
+#define FORENSICS_BREADCRUMB_WARN(...) FORENSICS_BREADCRUMB_AT(FORENSICS_BREADCRUMB_LEVEL_WARN, __VA_ARGS__)
+#define FORENSICS_BREADCRUMB_TYPED_WARN(...) FORENSICS_BREADCRUMB_TYPED_AT(FORENSICS_BREADCRUMB_LEVEL_WARN, __VA_ARGS__)
+#else
+#define FORENSICS_BREADCRUMB_WARN(...) ((void)0)
+#define FORENSICS_BREADCRUMB_TYPED_WARN(...) ((void)0)
+#endif
+#if FORENSICS_BREADCRUMB_COMPILED_LEVEL <= FORENSICS_BREADCRUMB_LEVEL_ERROR
+#define FORENSICS_BREADCRUMB_ERROR(...) FORENSICS_BREADCRUMB_AT(FORENSICS_BREADCRUMB_LEVEL_ERROR, __VA_ARGS__)
+#define FORENSICS_BREADCRUMB_TYPED_ERROR(...) FORENSICS_BREADCRUMB_TYPED_AT(FORENSICS_BREADCRUMB_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define FORENSICS_BREADCRUMB_ERROR(...) ((void)0)
+#define FORENSICS_BREADCRUMB_TYPED_ERROR(...) ((void)0)
+#endif
+
+#ifdef _MSC_VER
+#define FORENSICS_THREAD_LOCAL __declspec(thread)
+#define FORENSICS_SIGNAL_FENCE() _ReadWriteBarrier()
+#else
+#define FORENSICS_THREAD_LOCAL __thread
+#define FORENSICS_SIGNAL_FENCE() __atomic_signal_fence(__ATOMIC_SEQ_CST)
+#endif
+
+// The current thread's context stack. It is only here so that context pushes and pops can be inlined, so use
+// `forensics_context_begin()` and `forensics_context_end()` rather than changing it. `capacity` stays 0 until the stack
+// is allocated, which sends the first push on each thread down the slow path.
+typedef struct forensics_context_stack_t {
+  const char** names;
+  uint64_t* hashes; // 0 until the report needs it, unless the name was hashed up front
+  int count;
+  int capacity;
+  int overflow_count; // pushes that didn't fit, which their pops take back off first
+} forensics_context_stack_t;
+
+extern FORENSICS_THREAD_LOCAL forensics_context_stack_t forensics_private_context_stack;
+
+// The out of line parts of `forensics_private_context_push()` and `forensics_private_context_pop()`.
+void forensics_private_context_begin_slow(const char* name, uint64_t hash);
+void forensics_private_context_end_slow();
+
+// Pushes a context whose name has already been hashed with `forensics_context_name_hash()`, or 0 if it hasn't.
+static inline void forensics_private_context_push(const char* name, uint64_t hash) {
+  forensics_context_stack_t* stack = &forensics_private_context_stack;
+  const int count = stack->count;
+  if (count < stack->capacity) {
+    stack->names[count] = name;
+    stack->hashes[count] = hash;
+    // a crash report from a signal handler on this thread must not see the count before the name
+    FORENSICS_SIGNAL_FENCE();
+    stack->count = count + 1;
+    return;
+  }
+  forensics_private_context_begin_slow(name, hash);
+}
+
+// The inline `forensics_context_end()`.
+static inline void forensics_private_context_pop() {
+  forensics_context_stack_t* stack = &forensics_private_context_stack;
+  if (stack->overflow_count == 0 && stack->count > 0) {
+    --stack->count;
+    return;
+  }
+  forensics_private_context_end_slow();
+}
+
+#ifdef __cplusplus
+// templates can't have C linkage
+extern "C++" {
 
 #define FORENSICS_CONTEXT_CONCAT2(a, b) a##b
 #define FORENSICS_CONTEXT_CONCAT(a, b) FORENSICS_CONTEXT_CONCAT2(a, b)
 
-// A utility macro for C++ that creates a scoped context with the given name.
-#define FORENSICS_CONTEXT(name) forensics_context_t FORENSICS_CONTEXT_CONCAT(forensics_context__, __LINE__)(name)
+// The 64-bit FNV-1a hash of a context name, which reports give in `context_hashes`. It is constexpr so that string
+// literals can be hashed at compile time.
+#if __cplusplus >= 201402L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201402L)
+constexpr uint64_t forensics_context_name_hash(const char* name, uint64_t hash = 14695981039346656037ull) {
+  for (; *name != 0; ++name) {
+    hash = (hash ^ (uint8_t)*name) * 1099511628211ull;
+  }
+  return hash;
+}
+#else
+// C++11 constexpr functions can't loop, so this recurses once per character. Literals longer than the compiler's
+// constexpr depth limit (512 by default for GCC and Clang) need C++14 to be used with `FORENSICS_CONTEXT`.
+constexpr uint64_t forensics_context_name_hash(const char* name, uint64_t hash = 14695981039346656037ull) {
+  return *name == 0 ? hash : forensics_context_name_hash(name + 1, (hash ^ (uint8_t)*name) * 1099511628211ull);
+}
+#endif
+
+// Whether `FORENSICS_CONTEXT` was given a string literal. A literal is the only array whose `decltype` is a reference;
+// a named array (such as a const member) has its declared type and is treated like any other pointer.
+template <typename T>
+struct forensics_private_context_is_literal {
+  static constexpr bool value = false;
+};
+template <size_t N>
+struct forensics_private_context_is_literal<const char (&)[N]> {
+  static constexpr bool value = true;
+};
+
+// The hash `FORENSICS_CONTEXT` pushes along with a name, carried as a template argument so that the compiler has to
+// work it out. It is 0 for names that are only hashed if a report needs them.
+template <uint64_t Hash>
+struct forensics_private_context_hash_t {};
+
+constexpr uint64_t forensics_private_context_literal_hash(const char* name) {
+  return forensics_context_name_hash(name);
+}
+constexpr uint64_t forensics_private_context_literal_hash(forensics_string_t) {
+  return 0;
+}
+
+// A utility macro for C++ that creates a scoped context with the given name. Like `forensics_context_begin()`, only a
+// pointer to the name is kept. A string literal is pushed along with its hash, which is worked out at compile time, so
+// there is no work done on the string at runtime. A `forensics_string_t` is pushed with
+// `forensics_context_begin_interned()`.
+//
+// Any other name must stay unchanged until the scope ends; use `FORENSICS_CONTEXT_COPY` for names built in a buffer
+// or a temporary string. Debug builds (without NDEBUG) hash such a name when the context starts and assert if it hashes
+// differently when the context ends.
+#define FORENSICS_CONTEXT(name)                                                                                       \
+  forensics_context_t FORENSICS_CONTEXT_CONCAT(forensics_context__, __LINE__)(                                        \
+      name,                                                                                                           \
+      forensics_private_context_hash_t<forensics_private_context_is_literal<decltype(name)>::value                    \
+                                           ? forensics_private_context_literal_hash(name)                             \
+                                           : 0>())
+
+struct forensics_private_context_copy_t {};
+
+// The same as `FORENSICS_CONTEXT` except the name is copied with `forensics_context_begin_copy()`, for names that don't
+// live as long as the scope.
+#define FORENSICS_CONTEXT_COPY(name)                                                                                  \
+  forensics_context_t FORENSICS_CONTEXT_CONCAT(forensics_context__, __LINE__)(forensics_private_context_copy_t(), name)
 
 // C++ RAII implementation of an error context that will automatically end the context at the end of the current scope.
 typedef struct forensics_context_t {
   inline forensics_context_t(const char* name) {
-    forensics_context_begin(name);
+    forensics_private_context_push(name, 0);
+    debug_watch(name);
+  }
+  inline forensics_context_t(forensics_string_t name) {
+    forensics_context_begin_interned(name);
+  }
+  template <uint64_t Hash>
+  inline forensics_context_t(const char* name, forensics_private_context_hash_t<Hash>) {
+    forensics_private_context_push(name, Hash);
+    if (Hash == 0) {
+      debug_watch(name);
+    }
+  }
+  template <uint64_t Hash>
+  inline forensics_context_t(forensics_string_t name, forensics_private_context_hash_t<Hash>) {
+    forensics_context_begin_interned(name);
+  }
+  inline forensics_context_t(forensics_private_context_copy_t, const char* name) {
+    forensics_context_begin_copy(name);
   }
   inline ~forensics_context_t() {
-    forensics_context_end();
+    forensics_private_context_pop();
+#ifndef NDEBUG
+    FORENSICS_ASSERT_DBGF(debug_name == NULL || forensics_context_name_hash(debug_name) == debug_hash,
+                          "A context name changed before its scope ended. Use FORENSICS_CONTEXT_COPY for names that "
+                          "don't outlive the scope.");
+#endif
   }
+
+#ifdef NDEBUG
+  inline void debug_watch(const char*) {}
+#else
+  // A name that is only kept by pointer, which is checked to be unchanged when the context ends.
+  const char* debug_name = NULL;
+  uint64_t debug_hash = 0;
+
+  inline void debug_watch(const char* name) {
+    debug_name = name;
+    debug_hash = forensics_context_name_hash(name);
+  }
+#endif
 } forensics_context_t;
+
+// A utility macro for C++ that creates a scoped thread attribute with the given key and value.
+#define FORENSICS_THREAD_ATTRIBUTE(key, value)                                                                        \
+  forensics_thread_attribute_t FORENSICS_CONTEXT_CONCAT(forensics_thread_attribute__, __LINE__)(key, value)
+
+// C++ RAII implementation of a thread attribute that will automatically end at the end of the current scope.
+typedef struct forensics_thread_attribute_t {
+  inline forensics_thread_attribute_t(const char* key, const char* value) {
+    forensics_thread_attribute_begin(key, value);
+  }
+  inline ~forensics_thread_attribute_t() {
+    forensics_thread_attribute_end();
+  }
+} forensics_thread_attribute_t;
+} // extern "C++"
 #endif // __cplusplus
 
 #ifdef __cplusplus
@@ -0,0 +1,234 @@
+#include <cstdint>
+#include <cstring>
+#include "lz.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#define MIN_MATCH_SIZE 4
+#define MAX_OFFSET 65535
+
+// After this many misses in a row the search starts skipping ahead, so data that doesn't compress passes through
+// quickly. Every further 32 misses skips one more byte.
+#define SKIP_TRIGGER_SHIFT 5
+
+// A sequence's token holds 4 bits each for the literal and match lengths. Longer lengths continue in extra bytes.
+#define TOKEN_LENGTH_MAX 15
+
+static uint32_t read_u32(const char* ptr) {
+  uint32_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static uint64_t read_u64(const char* ptr) {
+  uint64_t value;
+  memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+static unsigned int count_trailing_zeros(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return (unsigned int)index;
+#else
+  return (unsigned int)__builtin_ctzll(value);
+#endif
+}
+
+// Returns how many bytes match at `a` and `b`, up to `limit`. Compares 8 bytes at a time where it can.
+static unsigned int match_size(const char* a, const char* b, unsigned int limit) {
+  unsigned int size = 0;
+  while (size + sizeof(uint64_t) <= limit) {
+    const uint64_t diff = read_u64(a + size) ^ read_u64(b + size);
+    if (diff != 0) {
+      // little endian: the first byte that differs is the lowest set byte
+      return size + count_trailing_zeros(diff) / 8;
+    }
+    size += sizeof(uint64_t);
+  }
+  while (size < limit && a[size] == b[size]) {
+    ++size;
+  }
+  return size;
+}
+
+static uint32_t hash_u32(uint32_t value) {
+  return (value * 2654435761u) >> (32 - 12);
+}
+
+// Writes the part of a length that doesn't fit in the token. Returns the new output position or nullptr if it overflows.
+static char* write_length(char* out, const char* out_end, unsigned int length) {
+  for (; length >= 255; length -= 255) {
+    if (out == out_end) {
+      return nullptr;
+    }
+    *out++ = (char)255;
+  }
+  if (out == out_end) {
+    return nullptr;
+  }
+  *out++ = (char)length;
+  return out;
+}
+
+// Writes a sequence: a run of literals followed by a match. The last sequence in a block has no match, which is
+// signalled by `match_size` being 0.
+static char* write_sequence(char* out,
+                            const char* out_end,
+                            const char* literals,
+                            unsigned int literal_size,
+                            unsigned int offset,
+                            unsigned int match_size) {
+  if (out == out_end) {
+    return nullptr;
+  }
+  const unsigned int match_extra = match_size > 0 ? match_size - MIN_MATCH_SIZE : 0;
+  char* token = out++;
+  *token = (char)(((literal_size < TOKEN_LENGTH_MAX ? literal_size : TOKEN_LENGTH_MAX) << 4) |
+                  (match_extra < TOKEN_LENGTH_MAX ? match_extra : TOKEN_LENGTH_MAX));
+  if (literal_size >= TOKEN_LENGTH_MAX) {
+    out = write_length(out, out_end, literal_size - TOKEN_LENGTH_MAX);
+    if (out == nullptr) {
+      return nullptr;
+    }
+  }
+  if ((unsigned int)(out_end - out) < literal_size) {
+    return nullptr;
+  }
+  memcpy(out, literals, literal_size);
+  out += literal_size;
+
+  if (match_size == 0) {
+    return out;
+  }
+  if (out_end - out < 2) {
+    return nullptr;
+  }
+  *out++ = (char)(offset & 0xff);
+  *out++ = (char)(offset >> 8);
+  if (match_extra >= TOKEN_LENGTH_MAX) {
+    out = write_length(out, out_end, match_extra - TOKEN_LENGTH_MAX);
+  }
+  return out;
+}
+
+void forensics_private_lz_table_init(forensics_lz_table_t* table) {
+  table->base = 0;
+  memset(table->positions, 0, sizeof(table->positions));
+}
+
+unsigned int forensics_private_lz_compress(const char* src,
+                                           unsigned int size,
+                                           char* dst,
+                                           unsigned int capacity,
+                                           forensics_lz_table_t* table) {
+  // positions are stored as `base + pos + 1`, so anything at or below `base` is left over from an earlier call
+  if (table->base > UINT32_MAX - size - 1) {
+    forensics_private_lz_table_init(table);
+  }
+  const uint32_t base = table->base;
+  table->base = base + size + 1;
+
+  char* out = dst;
+  const char* out_end = dst + capacity;
+  unsigned int anchor = 0;
+  unsigned int pos = 0;
+  unsigned int miss_count = 0;
+  while (pos + MIN_MATCH_SIZE <= size) {
+    const uint32_t sequence = read_u32(src + pos);
+    const uint32_t hash = hash_u32(sequence);
+    const uint32_t entry = table->positions[hash];
+    table->positions[hash] = base + pos + 1;
+    const unsigned int ref = entry - base - 1;
+    if (entry <= base || pos - ref > MAX_OFFSET || read_u32(src + ref) != sequence) {
+      pos += 1 + (miss_count++ >> SKIP_TRIGGER_SHIFT);
+      continue;
+    }
+    miss_count = 0;
+
+    const unsigned int size_bytes =
+        MIN_MATCH_SIZE + match_size(src + ref + MIN_MATCH_SIZE, src + pos + MIN_MATCH_SIZE, size - pos - MIN_MATCH_SIZE);
+    out = write_sequence(out, out_end, src + anchor, pos - anchor, pos - ref, size_bytes);
+    if (out == nullptr) {
+      return 0;
+    }
+    pos += size_bytes;
+    anchor = pos;
+  }
+
+  out = write_sequence(out, out_end, src + anchor, size - anchor, 0, 0);
+  if (out == nullptr) {
+    return 0;
+  }
+  return (unsigned int)(out - dst);
+}
+
+// Reads the part of a length that didn't fit in the token. Returns false if the input runs out.
+static bool read_length(const char** in, const char* in_end, unsigned int* length) {
+  for (;;) {
+    if (*in == in_end) {
+      return false;
+    }
+    const unsigned int byte = (uint8_t)*(*in)++;
+    *length += byte;
+    if (byte != 255) {
+      return true;
+    }
+  }
+}
+
+int forensics_private_lz_decompress(const char* src, unsigned int size, char* dst, unsigned int capacity) {
+  const char* in = src;
+  const char* in_end = src + size;
+  char* out = dst;
+  const char* out_end = dst + capacity;
+  while (in < in_end) {
+    const unsigned int token = (uint8_t)*in++;
+
+    unsigned int literal_size = token >> 4;
+    if (literal_size == TOKEN_LENGTH_MAX && !read_length(&in, in_end, &literal_size)) {
+      return -1;
+    }
+    if ((unsigned int)(in_end - in) < literal_size || (unsigned int)(out_end - out) < literal_size) {
+      return -1;
+    }
+    memcpy(out, in, literal_size);
+    in += literal_size;
+    out += literal_size;
+
+    // the last sequence is only literals
+    if (in == in_end) {
+      break;
+    }
+
+    if (in_end - in < 2) {
+      return -1;
+    }
+    const unsigned int offset = (uint8_t)in[0] | ((unsigned int)(uint8_t)in[1] << 8);
+    in += 2;
+    unsigned int match_size = token & TOKEN_LENGTH_MAX;
+    if (match_size == TOKEN_LENGTH_MAX && !read_length(&in, in_end, &match_size)) {
+      return -1;
+    }
+    match_size += MIN_MATCH_SIZE;
+    if (offset == 0 || offset > (unsigned int)(out - dst) || (unsigned int)(out_end - out) < match_size) {
+      return -1;
+    }
+
+    // the match may overlap the bytes it produces, so copy forwards a byte at a time when it does
+    const char* ref = out - offset;
+    if (offset >= match_size) {
+      memcpy(out, ref, match_size);
+      out += match_size;
+    }
+    else {
+      for (unsigned int index = 0; index < match_size; ++index) {
+        *out++ = ref[index];
+      }
+    }
+  }
+  return (int)(out - dst);
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include <stdint.h>
+
+// A small LZ77 block codec (the LZ4 block format) used to compress archived breadcrumbs. It favours speed over ratio
+// since blocks are compressed on the thread that leaves a breadcrumb.
+
+#define FORENSICS_LZ_TABLE_SIZE 4096
+
+// Scratch space for `forensics_private_lz_compress()` that remembers where it last saw each 4 byte sequence. Each call
+// only trusts the positions it wrote itself (those past `base`), so the table doesn't need to be cleared between blocks.
+typedef struct forensics_lz_table_t {
+  uint32_t base;
+  uint32_t positions[FORENSICS_LZ_TABLE_SIZE];
+} forensics_lz_table_t;
+
+// Prepares a table for its first use.
+void forensics_private_lz_table_init(forensics_lz_table_t* table);
+
+// Returns the most space compressing `size` bytes can take, for data that doesn't compress at all.
+static inline unsigned int forensics_private_lz_bound(unsigned int size) {
+  return size + size / 255 + 16;
+}
+
+// Compresses `size` bytes from `src` into `dst`. Returns the compressed size or 0 if it doesn't fit in `capacity` bytes.
+unsigned int forensics_private_lz_compress(const char* src,
+                                           unsigned int size,
+                                           char* dst,
+                                           unsigned int capacity,
+                                           forensics_lz_table_t* table);
+
+// Decompresses `size` bytes from `src` into `dst`. Returns the decompressed size or -1 if the data is corrupt or
+// doesn't fit in `capacity` bytes.
+int forensics_private_lz_decompress(const char* src, unsigned int size, char* dst, unsigned int capacity);
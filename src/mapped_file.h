@@ -0,0 +1,10 @@
+#pragma once
+#include <stddef.h>
+
+// Maps the file at `path` into memory for reading and writing, creating it if it doesn't exist and resizing it to
+// `size_bytes`. Stores to the memory are written back to the file by the OS, even if the process is killed. Returns
+// NULL if the file can't be mapped.
+void* forensics_private_map_file(const char* path, size_t size_bytes);
+
+// Unmaps a file mapped by `forensics_private_map_file()`.
+void forensics_private_unmap_file(void* address, size_t size_bytes);
@@ -0,0 +1,28 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include "mapped_file.h"
+
+void* forensics_private_map_file(const char* path, size_t size_bytes) {
+  const int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  void* address = nullptr;
+  if (ftruncate(fd, (off_t)size_bytes) == 0) {
+    address = mmap(nullptr, size_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+      address = nullptr;
+    }
+  }
+
+  // the mapping keeps the file open
+  close(fd);
+  return address;
+}
+
+void forensics_private_unmap_file(void* address, size_t size_bytes) {
+  munmap(address, size_bytes);
+}
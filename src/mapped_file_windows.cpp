@@ -0,0 +1,28 @@
+#include <windows.h>
+#include <stdint.h>
+#include "mapped_file.h"
+
+void* forensics_private_map_file(const char* path, size_t size_bytes) {
+  HANDLE file = CreateFileA(
+      path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+
+  // creating the mapping grows the file to its size if it is smaller
+  const uint64_t size = (uint64_t)size_bytes;
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, (DWORD)(size >> 32), (DWORD)size, nullptr);
+  void* address = nullptr;
+  if (mapping != nullptr) {
+    address = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size_bytes);
+    CloseHandle(mapping);
+  }
+
+  // the view keeps the file and the mapping open
+  CloseHandle(file);
+  return address;
+}
+
+void forensics_private_unmap_file(void* address, size_t size_bytes) {
+  UnmapViewOfFile(address);
+}
@@ -1,7 +1,7 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/errno.h>
+#include <errno.h>
 #include "backtrace.h"
 #include "forensics.h"
 